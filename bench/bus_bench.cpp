@@ -0,0 +1,360 @@
+// message bus benchmark
+// sends heap-allocated payloads between threads, through the old zmq PUB/SUB proxy and through BusNodes, and prints one JSON object per line, e.g.:
+//   {"bus":"bus_node","test":"throughput","producers":4,"messages":200000,"messages_per_sec":...,"p50_us":...,"p99_us":...}
+//
+// throughput: producers send as fast as they can, one consumer receives (latency = send to receive, so includes queueing)
+// ping_pong: one message in flight at a time (latency = half a round trip)
+// mesh_hop / chunk_hop: per-message overhead of a world -> mesher request / chunker -> world response, on one thread (send, receive, dispatch on topic)
+//
+// usage: bus_bench [--messages N] [--round-trips N] [--bus zmq|bus_node]
+
+#include "messaging.h"
+
+#include "zmq.hpp"
+#include "zmq_addon.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <numeric>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+	using bench_clock = std::chrono::high_resolution_clock;
+
+	// (the zmq bus sends topic names, like the game used to)
+	constexpr msg::Topic DATA_TOPIC = msg::MESH_GEN_RESPONSE;
+	constexpr msg::Topic PING_TOPIC = msg::MESH_GEN_REQUEST;
+	constexpr msg::Topic PONG_TOPIC = msg::MESH_GEN_RESPONSE;
+	constexpr msg::Topic STOP_TOPIC = msg::EXIT;
+
+	const std::string ZMQ_BUS_IN = "inproc://bench-bus-in";
+	const std::string ZMQ_BUS_OUT = "inproc://bench-bus-out";
+	const std::string ZMQ_BUS_CONTROL = "inproc://bench-bus-control";
+
+	// something like a request: heap-allocated, and owned by whoever receives it
+	struct BenchPayload
+	{
+		bench_clock::time_point sent;
+		uint64_t seq;
+	};
+
+	struct BenchResult
+	{
+		size_t messages = 0;
+		double total_s = 0;
+		std::vector<double> latencies_us;
+	};
+
+	double percentile(std::vector<double> values, const double p) {
+		if (values.empty()) {
+			return 0;
+		}
+		std::sort(values.begin(), values.end());
+		const size_t idx = std::min(values.size() - 1, static_cast<size_t>(p * values.size()));
+		return values[idx];
+	}
+
+	double us_since(const bench_clock::time_point& start) {
+		return std::chrono::duration<double, std::micro>(bench_clock::now() - start).count();
+	}
+
+	/* zmq: same setup the game used, a PUB/SUB proxy with topic names and pointers in frames */
+
+	class ZmqBus
+	{
+	public:
+		ZmqBus() : ctx(std::make_shared<zmq::context_t>(0)) {
+			proxy = std::thread([this]() {
+				zmq::socket_t publisher(*ctx, zmq::socket_type::pub);
+				publisher.setsockopt(ZMQ_SNDHWM, 1000 * 1000);
+				publisher.bind(ZMQ_BUS_OUT);
+
+				zmq::socket_t subscriber(*ctx, zmq::socket_type::sub);
+				subscriber.setsockopt(ZMQ_SUBSCRIBE, "", 0);
+				subscriber.setsockopt(ZMQ_RCVHWM, 1000 * 1000);
+				subscriber.bind(ZMQ_BUS_IN);
+
+				zmq::socket_t control(*ctx, zmq::socket_type::pair);
+				control.bind(ZMQ_BUS_CONTROL);
+				ready = true;
+
+				zmq::proxy_steerable(subscriber, publisher, nullptr, control);
+			});
+			while (!ready) {
+				std::this_thread::yield();
+			}
+		}
+
+		~ZmqBus() {
+			zmq::socket_t control(*ctx, zmq::socket_type::pair);
+			control.connect(ZMQ_BUS_CONTROL);
+			control.send(zmq::str_buffer("TERMINATE"));
+			proxy.join();
+		}
+
+		// sockets for one thread
+		struct Node
+		{
+			Node(zmq::context_t& ctx, const std::vector<msg::Topic>& topics) : in(ctx, zmq::socket_type::pub), out(ctx, zmq::socket_type::sub) {
+				in.setsockopt(ZMQ_SNDHWM, 1000 * 1000);
+				out.setsockopt(ZMQ_RCVHWM, 1000 * 1000);
+				in.connect(ZMQ_BUS_IN);
+				out.connect(ZMQ_BUS_OUT);
+				for (const auto& topic : topics) {
+					const std::string name = msg::topic_name(topic);
+					out.setsockopt(ZMQ_SUBSCRIBE, name.c_str(), name.size());
+				}
+			}
+
+			void send(const msg::Topic topic, BenchPayload* payload) {
+				const std::string name = msg::topic_name(topic);
+				std::vector<zmq::const_buffer> message({
+					zmq::buffer(name),
+					zmq::buffer(&payload, sizeof(payload))
+					});
+				auto ret = zmq::send_multipart(in, message, zmq::send_flags::dontwait);
+				assert(ret);
+			}
+
+			// returns topic, takes ownership of payload
+			// (compares the name against every topic, like the game's if/else chains did)
+			msg::Topic recv(std::unique_ptr<BenchPayload>& payload) {
+				std::vector<zmq::message_t> message;
+				auto ret = zmq::recv_multipart(out, std::back_inserter(message));
+				assert(ret);
+				payload.reset(message.size() > 1 ? *message[1].data<BenchPayload*>() : nullptr);
+				const std::string_view name = message[0].to_string_view();
+				for (int topic = 0; topic < msg::NUM_TOPICS; topic++) {
+					if (name == msg::topic_name(static_cast<msg::Topic>(topic))) {
+						return static_cast<msg::Topic>(topic);
+					}
+				}
+				return msg::NONE;
+			}
+
+			zmq::socket_t in;
+			zmq::socket_t out;
+		};
+
+		std::unique_ptr<Node> node(const std::vector<msg::Topic>& topics) {
+			return std::make_unique<Node>(*ctx, topics);
+		}
+
+	private:
+		std::shared_ptr<zmq::context_t> ctx;
+		std::thread proxy;
+		std::atomic<bool> ready = false;
+	};
+
+	/* bus nodes */
+
+	struct BusNodeBus
+	{
+		struct Node
+		{
+			Node(const std::vector<msg::Topic>& topics) {
+				bus.subscribe(topics);
+			}
+
+			void send(const msg::Topic topic, BenchPayload* payload) {
+				// full => wait for the receiver to catch up
+				Message message(topic, std::unique_ptr<BenchPayload>(payload));
+				while (!bus.send(std::move(message))) {
+					std::this_thread::yield();
+				}
+			}
+
+			msg::Topic recv(std::unique_ptr<BenchPayload>& payload) {
+				Message message;
+				auto ret = bus.recv(message, true);
+				assert(ret);
+				payload = message.has_data() ? message.take<BenchPayload>() : nullptr;
+				return message.topic;
+			}
+
+			BusNode bus;
+		};
+
+		std::unique_ptr<Node> node(const std::vector<msg::Topic>& topics) {
+			return std::make_unique<Node>(topics);
+		}
+	};
+
+	// zmq subscriptions take a moment to reach the proxy
+	void wait_for_subscriptions() {
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	}
+
+	template<typename Bus>
+	BenchResult run_throughput(Bus& bus, const int num_producers, const size_t num_messages) {
+		BenchResult result;
+		result.latencies_us.reserve(num_messages);
+
+		auto consumer = bus.node({ DATA_TOPIC });
+		std::vector<std::unique_ptr<typename Bus::Node>> producers;
+		for (int i = 0; i < num_producers; i++) {
+			producers.push_back(bus.node({}));
+		}
+		wait_for_subscriptions();
+
+		const auto start = bench_clock::now();
+		std::vector<std::thread> threads;
+		for (int i = 0; i < num_producers; i++) {
+			const size_t count = num_messages / num_producers + (i < static_cast<int>(num_messages % num_producers) ? 1 : 0);
+			threads.emplace_back([&, i, count]() {
+				for (size_t j = 0; j < count; j++) {
+					producers[i]->send(DATA_TOPIC, new BenchPayload{ bench_clock::now(), j });
+				}
+			});
+		}
+
+		std::unique_ptr<BenchPayload> payload;
+		for (size_t i = 0; i < num_messages; i++) {
+			consumer->recv(payload);
+			result.latencies_us.push_back(us_since(payload->sent));
+		}
+		result.total_s = std::chrono::duration<double>(bench_clock::now() - start).count();
+		result.messages = num_messages;
+
+		for (auto& thread : threads) {
+			thread.join();
+		}
+		return result;
+	}
+
+	template<typename Bus>
+	BenchResult run_ping_pong(Bus& bus, const size_t round_trips) {
+		BenchResult result;
+		result.latencies_us.reserve(round_trips);
+
+		auto ponger = bus.node({ PING_TOPIC, STOP_TOPIC });
+		auto pinger = bus.node({ PONG_TOPIC });
+		wait_for_subscriptions();
+
+		std::thread thread([&]() {
+			std::unique_ptr<BenchPayload> payload;
+			while (ponger->recv(payload) != STOP_TOPIC) {
+				ponger->send(PONG_TOPIC, payload.release());
+			}
+		});
+
+		const auto start = bench_clock::now();
+		std::unique_ptr<BenchPayload> payload;
+		for (size_t i = 0; i < round_trips; i++) {
+			pinger->send(PING_TOPIC, new BenchPayload{ bench_clock::now(), i });
+			pinger->recv(payload);
+			result.latencies_us.push_back(us_since(payload->sent) / 2);
+		}
+		result.total_s = std::chrono::duration<double>(bench_clock::now() - start).count();
+		result.messages = round_trips * 2;
+
+		pinger->send(STOP_TOPIC, nullptr);
+		thread.join();
+		return result;
+	}
+
+	// send, receive and dispatch *num_messages* messages with this topic, to a node with these subscriptions, all on one thread
+	template<typename Bus>
+	BenchResult run_hop(Bus& bus, const msg::Topic topic, std::span<const msg::Topic> incoming, const size_t num_messages) {
+		BenchResult result;
+		result.latencies_us.reserve(num_messages);
+
+		auto receiver = bus.node(std::vector<msg::Topic>(incoming.begin(), incoming.end()));
+		auto sender = bus.node({});
+		wait_for_subscriptions();
+
+		const auto start = bench_clock::now();
+		std::unique_ptr<BenchPayload> payload;
+		uint64_t handled = 0;
+		for (size_t i = 0; i < num_messages; i++) {
+			const auto sent = bench_clock::now();
+			sender->send(topic, new BenchPayload{ sent, i });
+
+			switch (receiver->recv(payload)) {
+			case msg::MESH_GEN_REQUEST:
+			case msg::CHUNK_GEN_RESPONSE:
+				handled += payload->seq;
+				break;
+			default:
+				assert(false);
+				break;
+			}
+			result.latencies_us.push_back(us_since(sent));
+		}
+		result.total_s = std::chrono::duration<double>(bench_clock::now() - start).count();
+		result.messages = num_messages;
+
+		assert(handled == num_messages * (num_messages - 1) / 2);
+		return result;
+	}
+
+	void print_result(const char* bus_name, const char* test, const int producers, const BenchResult& result) {
+		printf("{\"bus\":\"%s\",\"test\":\"%s\",\"producers\":%d,\"messages\":%zu,\"messages_per_sec\":%.0f,\"mean_us\":%.3f,\"p50_us\":%.3f,\"p99_us\":%.3f}\n",
+			bus_name, test, producers, result.messages, result.total_s > 0 ? result.messages / result.total_s : 0.0,
+			result.latencies_us.empty() ? 0.0 : std::accumulate(result.latencies_us.begin(), result.latencies_us.end(), 0.0) / result.latencies_us.size(),
+			percentile(result.latencies_us, 0.50), percentile(result.latencies_us, 0.99));
+		fflush(stdout);
+	}
+
+	template<typename Bus>
+	void run_all(Bus& bus, const char* bus_name, const size_t num_messages, const size_t round_trips) {
+		for (const int producers : { 1, 4 }) {
+			print_result(bus_name, "throughput", producers, run_throughput(bus, producers, num_messages));
+		}
+		print_result(bus_name, "ping_pong", 1, run_ping_pong(bus, round_trips));
+		print_result(bus_name, "mesh_hop", 1, run_hop(bus, msg::MESH_GEN_REQUEST, msg::meshing_thread_incoming, num_messages));
+		print_result(bus_name, "chunk_hop", 1, run_hop(bus, msg::CHUNK_GEN_RESPONSE, msg::world_thread_incoming, num_messages));
+	}
+
+	void print_usage() {
+		fprintf(stderr, "usage: bus_bench [--messages N] [--round-trips N] [--bus zmq|bus_node]\n");
+	}
+}
+
+int main(int argc, char* argv[]) {
+	// (stay under zmq's high water mark, or it starts dropping messages)
+	size_t num_messages = 200000;
+	size_t round_trips = 20000;
+	std::string only_bus;
+
+	for (int i = 1; i < argc; i++) {
+		const bool has_value = i + 1 < argc;
+		if (!strcmp(argv[i], "--messages") && has_value) {
+			num_messages = std::max(1, atoi(argv[++i]));
+		}
+		else if (!strcmp(argv[i], "--round-trips") && has_value) {
+			round_trips = std::max(1, atoi(argv[++i]));
+		}
+		else if (!strcmp(argv[i], "--bus") && has_value) {
+			only_bus = argv[++i];
+		}
+		else {
+			print_usage();
+			return 1;
+		}
+	}
+
+	if (only_bus.empty() || only_bus == "zmq") {
+		ZmqBus bus;
+		run_all(bus, "zmq", num_messages, round_trips);
+	}
+	if (only_bus.empty() || only_bus == "bus_node") {
+		BusNodeBus bus;
+		run_all(bus, "bus_node", num_messages, round_trips);
+	}
+
+	return 0;
+}
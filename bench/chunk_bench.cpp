@@ -0,0 +1,201 @@
+// chunk generation benchmark
+// runs a chunker thread, jumps the render distance from --from to --to, and acts like the world: handling messages once per 60 FPS frame
+// prints one JSON object per line (per config), e.g.:
+//   {"config":"batched","chunks":812,"messages":104,"messages_per_sec":...,"frame_p99_ms":...,"frame_max_ms":...}
+//
+// per_chunk: one request per chunk, and one response per chunk (how it used to work)
+// batched: one request for every chunk, and responses batched by the chunker
+//
+// usage: chunk_bench [--from R] [--to R]
+
+#include "chunker.h"
+
+#include "chunk.h"
+#include "messaging.h"
+#include "world_utils.h"
+
+#include "vmath.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+	using bench_clock = std::chrono::high_resolution_clock;
+
+	constexpr auto FRAME_TIME = std::chrono::microseconds(16667);
+
+	struct BenchConfig
+	{
+		const char* name;
+		bool batch_requests;
+		ChunkBatchOptions batch_options;
+	};
+
+	struct BenchResult
+	{
+		size_t chunks = 0;
+		uint64_t messages = 0;
+		double total_s = 0;
+
+		// time spent sending requests and handling responses, per frame
+		std::vector<double> frame_ms;
+	};
+
+	double percentile(std::vector<double> values, const double p) {
+		if (values.empty()) {
+			return 0;
+		}
+		std::sort(values.begin(), values.end());
+		const size_t idx = std::min(values.size() - 1, static_cast<size_t>(p * values.size()));
+		return values[idx];
+	}
+
+	// chunks that are in the new render distance, but weren't in the old one
+	std::vector<vmath::ivec2> chunks_to_load(const int from, const int to) {
+		std::vector<vmath::ivec2> result;
+		for (int x = -to; x <= to; x++) {
+			for (int z = -to; z <= to; z++) {
+				const float distance = vmath::distance(vmath::ivec2(x, z), vmath::ivec2(0, 0));
+				if (distance <= to && distance > from) {
+					result.push_back({ x, z });
+				}
+			}
+		}
+		return result;
+	}
+
+	BenchResult run_bench(const BenchConfig& config, const int from, const int to) {
+		BenchResult result;
+		const std::vector<vmath::ivec2> to_load = chunks_to_load(from, to);
+
+		// the world's end of the bus
+		BusNode bus;
+		bus.subscribe({ msg::CHUNK_GEN_RESPONSE, msg::CHUNK_GEN_CANCELLED });
+
+		// (chunker subscribes in its constructor, so wait for it before sending anything)
+		std::atomic<bool> ready = false;
+		std::thread thread([&]() {
+			Chunker chunker(config.batch_options);
+			chunker.run([&]() { ready = true; });
+		});
+		while (!ready) {
+			std::this_thread::yield();
+		}
+
+		bus.send(Message(msg::EVENT_RENDER_DISTANCE_CHANGED, to));
+
+		const uint64_t messages_before = chunk_gen_stats().messages;
+		const auto start = bench_clock::now();
+		auto next_frame = start;
+		std::unordered_map<vmath::ivec2, std::shared_ptr<Chunk>, vecN_hash> chunks;
+		bool sent = false;
+
+		while (chunks.size() < to_load.size()) {
+			const auto frame_start = bench_clock::now();
+
+			// request everything on the first frame
+			if (!sent) {
+				if (config.batch_requests) {
+					auto req = std::make_unique<ChunkGenRequest>();
+					req->coords = to_load;
+					chunk_gen_stats().messages++;
+					bus.send(Message(msg::CHUNK_GEN_REQUEST, std::move(req)));
+				}
+				else {
+					for (const auto& coords : to_load) {
+						auto req = std::make_unique<ChunkGenRequest>();
+						req->coords.push_back(coords);
+						chunk_gen_stats().messages++;
+						bus.send(Message(msg::CHUNK_GEN_REQUEST, std::move(req)));
+					}
+				}
+				sent = true;
+			}
+
+			// then take whatever's come back
+			Message message;
+			while (bus.recv(message)) {
+				if (message.topic == msg::CHUNK_GEN_RESPONSE) {
+					std::unique_ptr<ChunkGenResponse> response = message.take<ChunkGenResponse>();
+					for (auto& chunk : response->chunks) {
+						const vmath::ivec2 coords = chunk->coords;
+						chunks[coords] = std::move(chunk);
+					}
+				}
+			}
+
+			result.frame_ms.push_back(std::chrono::duration<double, std::milli>(bench_clock::now() - frame_start).count());
+
+			next_frame += FRAME_TIME;
+			std::this_thread::sleep_until(next_frame);
+		}
+
+		result.total_s = std::chrono::duration<double>(bench_clock::now() - start).count();
+		result.messages = chunk_gen_stats().messages - messages_before;
+		result.chunks = chunks.size();
+
+		bus.send(Message(msg::EXIT));
+		thread.join();
+		return result;
+	}
+
+	void print_result(const BenchConfig& config, const int from, const int to, const BenchResult& result) {
+		printf("{\"config\":\"%s\",\"from\":%d,\"to\":%d,\"max_chunks\":%zu,\"max_latency_ms\":%.1f,\"chunks\":%zu,\"messages\":%llu,\"seconds\":%.2f,\"messages_per_sec\":%.1f,"
+			"\"frames\":%zu,\"frame_p50_ms\":%.3f,\"frame_p99_ms\":%.3f,\"frame_max_ms\":%.3f}\n",
+			config.name, from, to, config.batch_options.max_chunks, config.batch_options.max_latency.count() / 1000.0, result.chunks, (unsigned long long)result.messages,
+			result.total_s, result.total_s > 0 ? result.messages / result.total_s : 0.0,
+			result.frame_ms.size(), percentile(result.frame_ms, 0.50), percentile(result.frame_ms, 0.99), percentile(result.frame_ms, 1.0));
+		fflush(stdout);
+	}
+
+	void print_usage() {
+		fprintf(stderr, "usage: chunk_bench [--from R] [--to R]\n");
+	}
+}
+
+int main(int argc, char* argv[]) {
+	int from = 4;
+	int to = 16;
+
+	for (int i = 1; i < argc; i++) {
+		const bool has_value = i + 1 < argc;
+		if (!strcmp(argv[i], "--from") && has_value) {
+			from = std::max(0, atoi(argv[++i]));
+		}
+		else if (!strcmp(argv[i], "--to") && has_value) {
+			to = std::max(1, atoi(argv[++i]));
+		}
+		else {
+			print_usage();
+			return 1;
+		}
+	}
+
+	if (to <= from) {
+		print_usage();
+		return 1;
+	}
+
+	const BenchConfig configs[] = {
+		{ "per_chunk", false, ChunkBatchOptions{ .max_chunks = 1 } },
+		{ "batched", true, ChunkBatchOptions{} },
+	};
+
+	for (const auto& config : configs) {
+		print_result(config, from, to, run_bench(config, from, to));
+	}
+
+	return 0;
+}
@@ -0,0 +1,311 @@
+#include "fixtures.h"
+
+#include "block.h"
+#include "chunkdata.h"
+#include "util.h"
+
+#include <cassert>
+#include <random>
+
+using namespace std;
+
+constexpr int OCEAN_FLOOR_HEIGHT = 40;
+constexpr int OCEAN_SURFACE_HEIGHT = 64;
+
+// convert coordinates to idx (same layout as Chunk::set_blocks)
+static int c2idx_fixture(const int x, const int y, const int z) {
+	return x + z * CHUNK_WIDTH + y * CHUNK_WIDTH * CHUNK_DEPTH;
+}
+
+static std::shared_ptr<Chunk> gen_checkerboard(const vmath::ivec2& coords) {
+	auto chunk = std::make_shared<Chunk>(coords);
+	chunk->init_minichunks();
+
+	std::vector<BlockType> blocks(CHUNK_SIZE, BlockType::Air);
+	for (int y = 0; y < CHUNK_HEIGHT; y++) {
+		for (int z = 0; z < CHUNK_DEPTH; z++) {
+			for (int x = 0; x < CHUNK_WIDTH; x++) {
+				if ((x + y + z) % 2 == 0) {
+					blocks[c2idx_fixture(x, y, z)] = BlockType::Stone;
+				}
+			}
+		}
+	}
+
+	chunk->set_blocks(blocks.data());
+	return chunk;
+}
+
+static std::shared_ptr<Chunk> gen_stone(const vmath::ivec2& coords) {
+	auto chunk = std::make_shared<Chunk>(coords);
+	chunk->init_minichunks();
+
+	std::vector<BlockType> blocks(CHUNK_SIZE, BlockType::Stone);
+	chunk->set_blocks(blocks.data());
+	return chunk;
+}
+
+static std::shared_ptr<Chunk> gen_ocean(const vmath::ivec2& coords) {
+	auto chunk = std::make_shared<Chunk>(coords);
+	chunk->init_minichunks();
+
+	std::vector<BlockType> blocks(CHUNK_SIZE, BlockType::Air);
+	for (int y = 0; y < OCEAN_SURFACE_HEIGHT; y++) {
+		for (int z = 0; z < CHUNK_DEPTH; z++) {
+			for (int x = 0; x < CHUNK_WIDTH; x++) {
+				if (y < OCEAN_FLOOR_HEIGHT) {
+					blocks[c2idx_fixture(x, y, z)] = BlockType::Stone;
+				}
+				else if (y < OCEAN_SURFACE_HEIGHT - 1) {
+					blocks[c2idx_fixture(x, y, z)] = BlockType::StillWater;
+				}
+				else {
+					blocks[c2idx_fixture(x, y, z)] = BlockType::FlowingWater;
+				}
+			}
+		}
+	}
+	chunk->set_blocks(blocks.data());
+
+	// ripple the top layer so that liquid heights vary
+	for (int z = 0; z < CHUNK_DEPTH; z++) {
+		for (int x = 0; x < CHUNK_WIDTH; x++) {
+			Metadata metadata;
+			metadata.set_liquid_level((x + z) % 8);
+			chunk->set_metadata(x, OCEAN_SURFACE_HEIGHT - 1, z, metadata);
+		}
+	}
+
+	return chunk;
+}
+
+static std::shared_ptr<Chunk> gen_noise(const vmath::ivec2& coords) {
+	auto chunk = std::make_shared<Chunk>(coords);
+	chunk->init_minichunks();
+
+	// seed by coords so that each chunk is different, but every run is the same
+	std::mt19937 rng(static_cast<uint32_t>(coords[0] * 73856093 ^ coords[1] * 19349663));
+	std::uniform_int_distribution<int> percent(0, 99);
+	std::uniform_int_distribution<int> liquid_level(0, 7);
+
+	std::vector<BlockType> blocks(CHUNK_SIZE, BlockType::Air);
+	std::vector<uint8_t> levels(CHUNK_SIZE, 0);
+	for (int i = 0; i < CHUNK_SIZE; i++) {
+		const int p = percent(rng);
+		if (p < 50) blocks[i] = BlockType::Air;
+		else if (p < 75) blocks[i] = BlockType::Stone;
+		else if (p < 85) blocks[i] = BlockType::Glass;
+		else if (p < 92) blocks[i] = BlockType::OakLeaves;
+		else if (p < 96) blocks[i] = BlockType::StillWater;
+		else {
+			blocks[i] = BlockType::FlowingWater;
+			levels[i] = static_cast<uint8_t>(liquid_level(rng));
+		}
+	}
+	chunk->set_blocks(blocks.data());
+
+	for (int y = 0; y < CHUNK_HEIGHT; y++) {
+		for (int z = 0; z < CHUNK_DEPTH; z++) {
+			for (int x = 0; x < CHUNK_WIDTH; x++) {
+				const uint8_t level = levels[c2idx_fixture(x, y, z)];
+				if (level != 0) {
+					Metadata metadata;
+					metadata.set_liquid_level(level);
+					chunk->set_metadata(x, y, z, metadata);
+				}
+			}
+		}
+	}
+
+	return chunk;
+}
+
+static std::shared_ptr<Chunk> gen_fixture_chunk(const FixtureType type, const vmath::ivec2& coords) {
+	switch (type) {
+	case FixtureType::Terrain: {
+		auto chunk = std::make_shared<Chunk>(coords);
+		chunk->generate();
+		return chunk;
+	}
+	case FixtureType::Checkerboard:
+		return gen_checkerboard(coords);
+	case FixtureType::Stone:
+		return gen_stone(coords);
+	case FixtureType::Ocean:
+		return gen_ocean(coords);
+	case FixtureType::Noise:
+		return gen_noise(coords);
+	default:
+		assert(false && "unknown fixture type");
+		return nullptr;
+	}
+}
+
+const std::vector<FixtureInfo>& all_fixtures() {
+	static const std::vector<FixtureInfo> fixtures = {
+		{ FixtureType::Terrain, "terrain" },
+		{ FixtureType::Checkerboard, "checkerboard" },
+		{ FixtureType::Stone, "stone" },
+		{ FixtureType::Ocean, "ocean" },
+		{ FixtureType::Noise, "noise" },
+	};
+	return fixtures;
+}
+
+static int fixture_min_block(const int radius) {
+	return -radius * CHUNK_WIDTH;
+}
+
+static int fixture_max_block(const int radius) {
+	return (radius + 1) * CHUNK_WIDTH - 1;
+}
+
+Fixture::Fixture(const FixtureType type, const int radius) : radius(radius) {
+	assert(radius >= 1 && "need at least one chunk with all neighbors");
+
+	for (int x = -radius; x <= radius; x++) {
+		for (int z = -radius; z <= radius; z++) {
+			const vmath::ivec2 coords = { x, z };
+			chunks[coords] = gen_fixture_chunk(type, coords);
+		}
+	}
+}
+
+Fixture::Fixture(const int radius, std::unordered_map<vmath::ivec2, std::shared_ptr<Chunk>, vecN_hash>&& chunks_) : radius(radius), chunks(std::move(chunks_)) {
+}
+
+int Fixture::min_block() const {
+	return fixture_min_block(radius);
+}
+
+int Fixture::max_block() const {
+	return fixture_max_block(radius);
+}
+
+std::shared_ptr<Chunk> Fixture::get_chunk(const vmath::ivec2& coords) const {
+	auto search = chunks.find(coords);
+	return search == chunks.end() ? nullptr : search->second;
+}
+
+std::shared_ptr<Chunk> Fixture::get_chunk_containing_block(const int x, const int z) const {
+	return get_chunk(get_chunk_coords(x, z));
+}
+
+MiniChunk* Fixture::get_mini(const vmath::ivec3& mini_coords) const {
+	std::shared_ptr<Chunk> chunk = get_chunk({ mini_coords[0], mini_coords[2] });
+	return chunk == nullptr ? nullptr : chunk->get_mini_with_y_level(mini_coords[1]);
+}
+
+std::shared_ptr<MeshGenRequest> Fixture::make_mesh_request(const vmath::ivec3& mini_coords) const {
+	auto req = std::make_shared<MeshGenRequest>();
+	req->coords = mini_coords;
+	req->data = std::make_shared<MeshGenRequestData>();
+	req->data->self = get_mini(mini_coords);
+	assert(req->data->self);
+
+	for (int dx = -1; dx <= 1; dx++) {
+		for (int dy = -1; dy <= 1; dy++) {
+			for (int dz = -1; dz <= 1; dz++) {
+				const vmath::ivec3 offset = { dx, dy, dz };
+				const int num_nonzero = (dx != 0) + (dy != 0) + (dz != 0);
+				MiniChunk* neighbor = get_mini(mini_coords + vmath::ivec3(dx, dy * MINICHUNK_HEIGHT, dz));
+
+				if (num_nonzero >= 2) {
+					req->data->edges_and_corners[dx + 1][dy + 1][dz + 1] = neighbor;
+				}
+				else if (offset == IEAST) req->data->east = neighbor;
+				else if (offset == IWEST) req->data->west = neighbor;
+				else if (offset == IUP) req->data->up = neighbor;
+				else if (offset == IDOWN) req->data->down = neighbor;
+				else if (offset == ISOUTH) req->data->south = neighbor;
+				else if (offset == INORTH) req->data->north = neighbor;
+			}
+		}
+	}
+
+	return req;
+}
+
+std::vector<vmath::ivec3> Fixture::inner_minis() const {
+	std::vector<vmath::ivec3> result;
+	for (int x = -radius + 1; x <= radius - 1; x++) {
+		for (int z = -radius + 1; z <= radius - 1; z++) {
+			for (int y = 0; y < CHUNK_HEIGHT; y += MINICHUNK_HEIGHT) {
+				result.push_back({ x, y, z });
+			}
+		}
+	}
+	return result;
+}
+
+FixtureBuilder::FixtureBuilder(const int radius) : radius(radius) {
+	assert(radius >= 1 && "need at least one chunk with all neighbors");
+
+	for (int x = -radius; x <= radius; x++) {
+		for (int z = -radius; z <= radius; z++) {
+			blocks[{ x, z }] = std::vector<BlockType>(CHUNK_SIZE, BlockType::Air);
+		}
+	}
+}
+
+int FixtureBuilder::min_block() const {
+	return fixture_min_block(radius);
+}
+
+int FixtureBuilder::max_block() const {
+	return fixture_max_block(radius);
+}
+
+void FixtureBuilder::set(const int x, const int y, const int z, const BlockType& block) {
+	const vmath::ivec3 rel = get_chunk_relative_coordinates(x, y, z);
+	blocks.at(get_chunk_coords(x, z))[c2idx_fixture(rel[0], rel[1], rel[2])] = block;
+}
+
+Fixture FixtureBuilder::build() {
+	std::unordered_map<vmath::ivec2, std::shared_ptr<Chunk>, vecN_hash> chunks;
+	for (auto& [coords, chunk_blocks] : blocks) {
+		auto chunk = std::make_shared<Chunk>(coords);
+		chunk->init_minichunks();
+		chunk->set_blocks(chunk_blocks.data());
+		chunks[coords] = chunk;
+	}
+	return Fixture(radius, std::move(chunks));
+}
+
+int stair_height(const FixtureBuilder& builder, const int x) {
+	return FIXTURE_FLOOR_HEIGHT + (builder.max_block() - x) / FIXTURE_STAIR_WIDTH;
+}
+
+void fill_floor(FixtureBuilder& builder, const bool stairs) {
+	for (int x = builder.min_block(); x <= builder.max_block(); x++) {
+		const int height = stairs ? stair_height(builder, x) : FIXTURE_FLOOR_HEIGHT;
+		for (int z = builder.min_block(); z <= builder.max_block(); z++) {
+			for (int y = 0; y < height; y++) {
+				builder.set(x, y, z, BlockType::Stone);
+			}
+		}
+	}
+}
+
+FixtureDam build_dam(FixtureBuilder& builder, const int depth) {
+	fill_floor(builder, true);
+
+	FixtureDam dam;
+	const int lo = builder.min_block(), hi = builder.max_block();
+	const int wall_x = lo + CHUNK_WIDTH;
+	dam.top = stair_height(builder, wall_x) + depth;
+
+	for (int z = lo; z <= hi; z++) {
+		for (int x = lo; x < wall_x; x++) {
+			for (int y = stair_height(builder, x); y < dam.top; y++) {
+				builder.set(x, y, z, BlockType::StillWater);
+			}
+		}
+		for (int y = stair_height(builder, wall_x); y < dam.top; y++) {
+			builder.set(wall_x, y, z, BlockType::Stone);
+			dam.wall.push_back({ wall_x, y, z });
+		}
+	}
+
+	return dam;
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "chunk.h"
+#include "world_utils.h"
+
+#include "vmath.h"
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// deterministic worlds to benchmark against, so that runs can be compared
+enum class FixtureType
+{
+	Terrain,      // what the game generates
+	Checkerboard, // stone/air alternating in every direction (worst case for meshing)
+	Stone,        // solid stone (best case, nothing visible)
+	Ocean,        // shallow sea floor under deep water, with flowing water near the top
+	Noise,        // random mix of solid, translucent and liquid blocks
+};
+
+struct FixtureInfo
+{
+	FixtureType type;
+	const char* name;
+};
+
+const std::vector<FixtureInfo>& all_fixtures();
+
+// a square of chunks (2*radius+1 across) centered on (0, 0)
+class Fixture
+{
+public:
+	Fixture(const FixtureType type, const int radius);
+
+	// (see FixtureBuilder)
+	Fixture(const int radius, std::unordered_map<vmath::ivec2, std::shared_ptr<Chunk>, vecN_hash>&& chunks_);
+
+	// range of block x and z coords in the fixture
+	int min_block() const;
+	int max_block() const;
+
+	std::shared_ptr<Chunk> get_chunk(const vmath::ivec2& coords) const;
+	std::shared_ptr<Chunk> get_chunk_containing_block(const int x, const int z) const;
+
+	// mini at these mini coords (x and z are chunk coords), or nullptr if not in the fixture
+	MiniChunk* get_mini(const vmath::ivec3& mini_coords) const;
+
+	// build a mesh request the same way the world does, with all 26 neighbors filled in
+	std::shared_ptr<MeshGenRequest> make_mesh_request(const vmath::ivec3& mini_coords) const;
+
+	// coords of every mini whose neighbors are all in the fixture
+	std::vector<vmath::ivec3> inner_minis() const;
+
+	const int radius;
+
+private:
+	std::unordered_map<vmath::ivec2, std::shared_ptr<Chunk>, vecN_hash> chunks;
+};
+
+// a fixture filled in block by block, for benchmarks that set up their own scenes (all air until something's set)
+class FixtureBuilder
+{
+public:
+	FixtureBuilder(const int radius);
+
+	int min_block() const;
+	int max_block() const;
+
+	void set(const int x, const int y, const int z, const BlockType& block);
+
+	// turn the blocks into chunks
+	Fixture build();
+
+	const int radius;
+
+private:
+	std::unordered_map<vmath::ivec2, std::vector<BlockType>, vecN_hash> blocks;
+};
+
+// floors for liquid scenes
+constexpr int FIXTURE_FLOOR_HEIGHT = 64;
+constexpr int FIXTURE_STAIR_WIDTH = 6;
+
+// floor height at this x, stepping down a block every FIXTURE_STAIR_WIDTH blocks to the east (to FIXTURE_FLOOR_HEIGHT at the east edge)
+int stair_height(const FixtureBuilder& builder, const int x);
+
+// stone up to the floor (stairs or flat at FIXTURE_FLOOR_HEIGHT) across the whole fixture
+void fill_floor(FixtureBuilder& builder, const bool stairs);
+
+// a reservoir in the west chunk column, held back by a stone wall, over a stair floor
+struct FixtureDam
+{
+	// the wall's blocks, for knocking down once the fixture's built
+	std::vector<vmath::ivec3> wall;
+
+	// y just above the water
+	int top;
+};
+
+FixtureDam build_dam(FixtureBuilder& builder, const int depth);
@@ -0,0 +1,249 @@
+// flight path benchmark
+// flies a player through a fresh world (chunker and mesher threads, world handling messages once per 60 FPS frame), and measures how quickly what's in front of them shows up
+// prints one JSON object per line (per config), e.g.:
+//   {"config":"view","first_visible_ms":...,"cone_90_ms":...,"cone_coverage":...,...}
+//
+// the path flies along +x for the first half, then turns and flies along +z (so both moving into new terrain and turning towards unbuilt terrain get measured)
+//
+// distance: chunks and minis are built closest-first (the player's look direction and velocity aren't sent)
+// view: chunks and minis in the view cone, and along the player's path, are built first
+//
+// first_visible_ms: until the first mesh in the view cone arrives
+// cone_90_ms: until 90% of the chunks in the view cone (within render distance) have a mesh
+// cone_coverage: fraction of the view cone with meshes, averaged over every frame
+// turn_coverage: fraction of the view cone with meshes right after turning (i.e. what was built to the side of the path)
+// turn_90_ms: like cone_90_ms, but starting from the turn (0 if it was already covered)
+//
+// usage: flight_bench [--render-distance R] [--speed CHUNKS_PER_SEC] [--seconds S]
+
+#include "chunker.h"
+#include "mesher.h"
+#include "messaging.h"
+#include "util.h"
+#include "world.h"
+#include "world_utils.h"
+
+#include "vmath.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+	using bench_clock = std::chrono::high_resolution_clock;
+
+	constexpr auto FRAME_TIME = std::chrono::microseconds(16667);
+
+	// the camera's horizontal field of view is 90 degrees
+	const float CAMERA_HALF_FOV_COS = cosf(vmath::radians(45.0f));
+
+	struct BenchConfig
+	{
+		const char* name;
+		bool send_view;
+	};
+
+	struct BenchOptions
+	{
+		int render_distance = 12;
+		float speed = 2.0f;
+		float seconds = 10.0f;
+	};
+
+	struct BenchResult
+	{
+		double first_visible_ms = -1;
+		double cone_90_ms = -1;
+		double turn_90_ms = -1;
+		double cone_coverage = 0;
+		double turn_coverage = 0;
+		uint64_t meshes = 0;
+		uint64_t wasted = 0;
+	};
+
+	// start every run with empty queues and counters
+	void reset_stats(RequestQueueStats& stats) {
+		stats.queued = 0;
+		stats.completed = 0;
+		stats.cancelled = 0;
+		stats.wasted = 0;
+		stats.messages = 0;
+		stats.in_flight = 0;
+		stats.held_back = 0;
+	}
+
+	// chunks within render distance that the camera can see
+	std::vector<vmath::ivec2> view_cone(const vmath::vec2& position, const vmath::vec2& look, const int render_distance) {
+		std::vector<vmath::ivec2> result;
+		const vmath::ivec2 center = { static_cast<int>(floorf(position[0])), static_cast<int>(floorf(position[1])) };
+		for (const auto& coords : gen_circle(render_distance, center)) {
+			const vmath::vec2 offset = vmath::vec2(coords[0] + 0.5f, coords[1] + 0.5f) - position;
+			const float offset_length = vmath::length(offset);
+			if (offset_length <= VIEW_NEAR_RADIUS || vmath::dot(offset, look) / offset_length >= CAMERA_HALF_FOV_COS) {
+				result.push_back(coords);
+			}
+		}
+		return result;
+	}
+
+	BenchResult run_bench(const BenchConfig& config, const BenchOptions& options) {
+		BenchResult result;
+		reset_stats(chunk_gen_stats());
+		reset_stats(mesh_gen_stats());
+
+		// the render thread's end of the bus
+		BusNode render(MESH_RESPONSE_CAPACITY);
+		render.subscribe(msg::render_thread_incoming);
+
+		// (workers subscribe in their constructors, so wait for them before sending anything)
+		std::atomic<int> ready = 0;
+		std::thread chunker_thread([&]() { ChunkGenThread2([&]() { ready++; }); });
+		std::thread mesher_thread([&]() { MeshingThread2([&]() { ready++; }); });
+		while (ready < 2) {
+			std::this_thread::yield();
+		}
+
+		auto data = std::make_unique<WorldDataPart>();
+		BusNode events;
+		events.send(Message(msg::EVENT_RENDER_DISTANCE_CHANGED, options.render_distance));
+
+		// chunks that have at least one mesh
+		std::unordered_set<vmath::ivec2, vecN_hash> meshed;
+
+		const int frames = static_cast<int>(options.seconds * 60);
+		const int turn_frame = frames / 2;
+		const float distance_per_frame = options.speed / 60.0f;
+		vmath::vec2 position = { 0.5f, 0.5f };
+		vmath::ivec2 last_chunk = { (std::numeric_limits<int>::max)(), 0 };
+		double coverage_sum = 0;
+
+		const auto start = bench_clock::now();
+		auto next_frame = start;
+		auto turn_time = start;
+		for (int frame = 0; frame < frames; frame++) {
+			const auto now = bench_clock::now();
+			const bool turned = frame >= turn_frame;
+			if (frame == turn_frame) {
+				turn_time = now;
+			}
+
+			// move
+			const vmath::vec2 direction = turned ? vmath::vec2(0.0f, 1.0f) : vmath::vec2(1.0f, 0.0f);
+			position += direction * distance_per_frame;
+
+			PlayerView view;
+			view.chunk_coords = { static_cast<int>(floorf(position[0])), static_cast<int>(floorf(position[1])) };
+			view.position = position;
+			if (config.send_view) {
+				view.look = direction;
+				view.velocity = direction * options.speed;
+			}
+
+			// act like World::tick
+			if (view.chunk_coords != last_chunk) {
+				last_chunk = view.chunk_coords;
+				data->gen_nearby_chunks(vmath::vec4(position[0] * CHUNK_WIDTH, 0.0f, position[1] * CHUNK_WIDTH, 1.0f), options.render_distance);
+			}
+			if (view_changed(data->player_view, view) && events.send(Message(msg::EVENT_PLAYER_VIEW_CHANGED, view))) {
+				data->player_view = view;
+			}
+			data->update_tick(static_cast<int>(frame / 3)); // 20 ticks per second
+			data->handle_messages();
+
+			// act like the render thread
+			Message message;
+			while (render.recv(message)) {
+				if (message.topic == msg::MESH_GEN_RESPONSE) {
+					std::unique_ptr<MeshGenResult> mesh = message.take<MeshGenResult>();
+					meshed.insert({ mesh->coords[0], mesh->coords[2] });
+					result.meshes++;
+				}
+			}
+
+			// how much of the view cone is there
+			const std::vector<vmath::ivec2> cone = view_cone(position, direction, options.render_distance);
+			const size_t visible = std::count_if(cone.begin(), cone.end(), [&](const vmath::ivec2& coords) { return meshed.contains(coords); });
+			const double coverage = cone.empty() ? 1.0 : static_cast<double>(visible) / cone.size();
+			coverage_sum += coverage;
+			if (frame == turn_frame) {
+				result.turn_coverage = coverage;
+			}
+
+			const double since_start_ms = std::chrono::duration<double, std::milli>(now - start).count();
+			if (result.first_visible_ms < 0 && visible > 0) {
+				result.first_visible_ms = since_start_ms;
+			}
+			if (result.cone_90_ms < 0 && coverage >= 0.9) {
+				result.cone_90_ms = since_start_ms;
+			}
+			if (turned && result.turn_90_ms < 0 && coverage >= 0.9) {
+				result.turn_90_ms = std::chrono::duration<double, std::milli>(now - turn_time).count();
+			}
+
+			next_frame += FRAME_TIME;
+			std::this_thread::sleep_until(next_frame);
+		}
+
+		result.cone_coverage = coverage_sum / frames;
+		result.wasted = chunk_gen_stats().wasted + mesh_gen_stats().wasted;
+
+		events.send(Message(msg::EXIT));
+		chunker_thread.join();
+		mesher_thread.join();
+		return result;
+	}
+
+	void print_result(const BenchConfig& config, const BenchOptions& options, const BenchResult& result) {
+		printf("{\"config\":\"%s\",\"render_distance\":%d,\"speed\":%.2f,\"seconds\":%.1f,\"first_visible_ms\":%.1f,\"cone_90_ms\":%.1f,\"turn_90_ms\":%.1f,\"cone_coverage\":%.3f,\"turn_coverage\":%.3f,\"meshes\":%llu,\"wasted\":%llu}\n",
+			config.name, options.render_distance, options.speed, options.seconds, result.first_visible_ms, result.cone_90_ms, result.turn_90_ms, result.cone_coverage, result.turn_coverage,
+			(unsigned long long)result.meshes, (unsigned long long)result.wasted);
+		fflush(stdout);
+	}
+
+	void print_usage() {
+		fprintf(stderr, "usage: flight_bench [--render-distance R] [--speed CHUNKS_PER_SEC] [--seconds S]\n");
+	}
+}
+
+int main(int argc, char* argv[]) {
+	BenchOptions options;
+
+	for (int i = 1; i < argc; i++) {
+		const bool has_value = i + 1 < argc;
+		if (!strcmp(argv[i], "--render-distance") && has_value) {
+			options.render_distance = std::max(1, atoi(argv[++i]));
+		}
+		else if (!strcmp(argv[i], "--speed") && has_value) {
+			options.speed = std::max(0.0f, static_cast<float>(atof(argv[++i])));
+		}
+		else if (!strcmp(argv[i], "--seconds") && has_value) {
+			options.seconds = std::max(1.0f, static_cast<float>(atof(argv[++i])));
+		}
+		else {
+			print_usage();
+			return 1;
+		}
+	}
+
+	const BenchConfig configs[] = {
+		{ "distance", false },
+		{ "view", true },
+	};
+
+	for (const auto& config : configs) {
+		print_result(config, options, run_bench(config, options));
+	}
+
+	return 0;
+}
@@ -0,0 +1,251 @@
+// headless liquid benchmark
+// builds a scripted flood in a flat world, runs the liquid sim until the water settles, and prints one JSON object per line (per scenario and mode), e.g.:
+//   {"scenario":"dam_break","mode":"parallel","workers":7,"chunks":81,"steps":...,"cells_per_sec":...,"checksum":"...","speedup":3.1,"matches_serial":true}
+//
+// each scenario's run one chunk at a time (serial), then with chunks stepped in parallel on a job system with --workers workers (plus this thread)
+// the parallel run has to end up with the same cells as the serial one (else it exits with 1)
+//
+// dam_break: a reservoir in the west chunk column, held back by a wall, above terrain that steps down every 6 blocks to the east; the wall's removed
+// sheet_drain: a layer of full flowing water (with nothing feeding it) over a flat floor, all of it woken up at once
+// springs: scattered water sources on stepped terrain
+//
+// usage: liquid_bench [--radius R] [--budget N] [--scenario NAME] [--workers N]
+
+#include "liquids.h"
+
+#include "fixtures.h"
+
+#include "change_journal.h"
+#include "chunk.h"
+#include "jobs.h"
+#include "util.h"
+#include "world_utils.h"
+
+#include "vmath.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+	constexpr int RESERVOIR_DEPTH = 6;
+	constexpr int NUM_SPRINGS = 64;
+
+	// stop if the water never settles
+	constexpr int MAX_TICKS = 100000;
+
+	enum class Scenario
+	{
+		DamBreak,
+		SheetDrain,
+		Springs,
+	};
+
+	struct ScenarioInfo
+	{
+		Scenario scenario;
+		const char* name;
+	};
+
+	const ScenarioInfo SCENARIOS[] = {
+		{ Scenario::DamBreak, "dam_break" },
+		{ Scenario::SheetDrain, "sheet_drain" },
+		{ Scenario::Springs, "springs" },
+	};
+
+	struct BenchResult
+	{
+		int ticks = 0;
+		uint64_t steps = 0;
+		uint64_t cells_updated = 0;
+		uint64_t cells_changed = 0;
+		size_t dirty_minis = 0;
+		size_t max_tick_work = 0;
+		size_t chunks = 0;
+		double total_s = 0;
+		double max_tick_ms = 0;
+		uint64_t checksum = 0;
+	};
+
+	// set up *scenario*, then tick the sim until the water settles
+	// (steps chunks in parallel on *jobs*, unless it's null)
+	BenchResult run_scenario(const Scenario scenario, const int radius, const size_t budget, JobSystem* jobs) {
+		FixtureBuilder builder(radius);
+		const int lo = builder.min_block(), hi = builder.max_block();
+
+		// blocks to tell the sim about once the world's built
+		std::vector<vmath::ivec3> changed;
+
+		switch (scenario) {
+		case Scenario::DamBreak:
+			changed = build_dam(builder, RESERVOIR_DEPTH).wall;
+			break;
+		case Scenario::SheetDrain:
+			fill_floor(builder, false);
+			for (int x = lo; x <= hi; x++) {
+				for (int z = lo; z <= hi; z++) {
+					builder.set(x, FIXTURE_FLOOR_HEIGHT, z, BlockType::FlowingWater);
+					changed.push_back({ x, FIXTURE_FLOOR_HEIGHT, z });
+				}
+			}
+			break;
+		case Scenario::Springs:
+		{
+			fill_floor(builder, true);
+			std::mt19937 rng(12345);
+			std::uniform_int_distribution<int> dist(lo, hi);
+			for (int i = 0; i < NUM_SPRINGS; i++) {
+				const int x = dist(rng), z = dist(rng);
+				builder.set(x, stair_height(builder, x), z, BlockType::StillWater);
+				changed.push_back({ x, stair_height(builder, x), z });
+			}
+			break;
+		}
+		}
+
+		const Fixture world = builder.build();
+
+		LiquidSim sim([&](const vmath::ivec2& coords) { return world.get_chunk(coords); }, jobs, budget);
+
+		// the dam's removed, the sheet's full (its metadata's set like the world would), the springs are placed
+		for (const auto& xyz : changed) {
+			std::shared_ptr<Chunk> chunk = world.get_chunk_containing_block(xyz[0], xyz[2]);
+			const vmath::ivec3 rel = get_chunk_relative_coordinates(xyz[0], xyz[1], xyz[2]);
+			if (scenario == Scenario::DamBreak) {
+				chunk->set_block(rel, BlockType::Air);
+			}
+			else if (scenario == Scenario::SheetDrain) {
+				Metadata metadata;
+				metadata.set_liquid_level(7);
+				chunk->set_metadata(rel, metadata);
+			}
+			sim.on_block_changed(xyz);
+		}
+
+		BenchResult result;
+		for (int tick = 1; tick <= MAX_TICKS && (sim.num_active() > 0 || sim.mid_step()); tick++) {
+			const auto start = std::chrono::high_resolution_clock::now();
+			sim.update(tick);
+			const auto end = std::chrono::high_resolution_clock::now();
+
+			// (minis the world would remesh for this tick's changes)
+			ChangeJournal journal;
+			for (const auto& xyz : sim.take_changed_blocks()) {
+				journal.record_block(xyz);
+			}
+			result.dirty_minis += journal.take_dirty_minis().size();
+
+			const double elapsed_s = std::chrono::duration<double>(end - start).count();
+			result.total_s += elapsed_s;
+			result.max_tick_ms = std::max(result.max_tick_ms, elapsed_s * 1e3);
+			result.max_tick_work = std::max(result.max_tick_work, sim.stats.last_update_work);
+			result.ticks = tick;
+		}
+
+		result.steps = sim.stats.steps;
+		result.cells_updated = sim.stats.cells_updated;
+		result.cells_changed = sim.stats.cells_changed;
+		result.chunks = sim.num_chunks();
+
+		// FNV-1a over every cell, so runs (and other ways of running the sim) can be compared
+		result.checksum = 14695981039346656037ull;
+		for (int y = 0; y < CHUNK_HEIGHT; y++) {
+			for (int z = lo; z <= hi; z++) {
+				for (int x = lo; x <= hi; x++) {
+					result.checksum = (result.checksum ^ sim.get_cell({ x, y, z })) * 1099511628211ull;
+				}
+			}
+		}
+
+		return result;
+	}
+
+	// (*serial* is the serial run's result, when this is the parallel one)
+	void print_result(const char* scenario_name, const int radius, const size_t budget, const size_t workers, const BenchResult& result, const BenchResult* serial) {
+		const double steps = static_cast<double>(std::max<uint64_t>(result.steps, 1));
+		printf("{\"scenario\":\"%s\",\"mode\":\"%s\",\"workers\":%zu,\"radius\":%d,\"budget\":%zu,\"chunks\":%zu,\"ticks\":%d,\"steps\":%llu,\"cells_updated\":%llu,\"cells_changed\":%llu,"
+			"\"seconds\":%.3f,\"cells_per_sec\":%.0f,\"changes_per_sec\":%.0f,\"remeshes_per_step\":%.1f,\"max_tick_work\":%zu,\"max_tick_ms\":%.2f,\"checksum\":\"%016llx\"",
+			scenario_name, serial == nullptr ? "serial" : "parallel", serial == nullptr ? 0 : workers, radius, budget, result.chunks, result.ticks, (unsigned long long)result.steps, (unsigned long long)result.cells_updated, (unsigned long long)result.cells_changed,
+			result.total_s, result.total_s > 0 ? result.cells_updated / result.total_s : 0.0, result.total_s > 0 ? result.cells_changed / result.total_s : 0.0,
+			result.dirty_minis / steps, result.max_tick_work, result.max_tick_ms, (unsigned long long)result.checksum);
+		if (serial != nullptr) {
+			printf(",\"speedup\":%.2f,\"matches_serial\":%s", result.total_s > 0 ? serial->total_s / result.total_s : 0.0, result.checksum == serial->checksum ? "true" : "false");
+		}
+		printf("}\n");
+		fflush(stdout);
+	}
+
+	void print_usage() {
+		fprintf(stderr, "usage: liquid_bench [--radius R] [--budget N] [--scenario NAME] [--workers N]\nscenarios:");
+		for (const auto& info : SCENARIOS) {
+			fprintf(stderr, " %s", info.name);
+		}
+		fprintf(stderr, "\n");
+	}
+}
+
+int main(int argc, char* argv[]) {
+	int radius = 4;
+	size_t budget = SIZE_MAX;
+	std::string only_scenario;
+
+	// (same as the game's job system)
+	size_t workers = std::max<size_t>(std::thread::hardware_concurrency(), 2) - 1;
+
+	for (int i = 1; i < argc; i++) {
+		const bool has_value = i + 1 < argc;
+		if (!strcmp(argv[i], "--radius") && has_value) {
+			radius = std::max(1, atoi(argv[++i]));
+		}
+		else if (!strcmp(argv[i], "--budget") && has_value) {
+			budget = std::max<size_t>(1, strtoull(argv[++i], nullptr, 10));
+		}
+		else if (!strcmp(argv[i], "--scenario") && has_value) {
+			only_scenario = argv[++i];
+		}
+		else if (!strcmp(argv[i], "--workers") && has_value) {
+			workers = std::max<size_t>(1, strtoull(argv[++i], nullptr, 10));
+		}
+		else {
+			print_usage();
+			return 1;
+		}
+	}
+
+	JobSystem jobs(workers);
+
+	bool found = only_scenario.empty();
+	bool all_match = true;
+	for (const auto& info : SCENARIOS) {
+		if (!only_scenario.empty() && only_scenario != info.name) {
+			continue;
+		}
+		found = true;
+
+		const BenchResult serial = run_scenario(info.scenario, radius, budget, nullptr);
+		print_result(info.name, radius, budget, workers, serial, nullptr);
+
+		const BenchResult parallel = run_scenario(info.scenario, radius, budget, &jobs);
+		print_result(info.name, radius, budget, workers, parallel, &serial);
+
+		all_match &= parallel.checksum == serial.checksum;
+	}
+
+	if (!found) {
+		print_usage();
+		return 1;
+	}
+
+	return all_match ? 0 : 1;
+}
@@ -0,0 +1,182 @@
+// headless meshing benchmark
+// meshes every inner mini of each fixture world, and prints one JSON object per line (per fixture and config), e.g.:
+//   {"fixture":"terrain","ambient_occlusion":true,"cache":false,"minis":144,...}
+//
+// usage: mesh_bench [--iterations N] [--radius R] [--fixture NAME]
+
+#include "fixtures.h"
+
+#include "mesh_cache.h"
+#include "render.h"
+#include "world_meshing.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+struct BenchConfig
+{
+	const char* name;
+	MeshingOptions options;
+	bool use_cache;
+};
+
+struct BenchResult
+{
+	size_t minis = 0;
+	size_t invisible_minis = 0;
+	uint64_t quads = 0;
+	uint64_t water_quads = 0;
+
+	// coarser levels of detail (water included), lod_quads[i] is level i + 1
+	uint64_t lod_quads[MESH_LOD_LEVELS - 1] = {};
+
+	double total_s = 0;
+
+	// latency of each mesh call, in microseconds
+	std::vector<double> latencies_us;
+};
+
+static double percentile(std::vector<double> values, const double p) {
+	if (values.empty()) {
+		return 0;
+	}
+	std::sort(values.begin(), values.end());
+	const size_t idx = std::min(values.size() - 1, static_cast<size_t>(p * values.size()));
+	return values[idx];
+}
+
+// mesh every request *iterations* times (after one warm-up pass)
+static BenchResult run_bench(const std::vector<std::shared_ptr<MeshGenRequest>>& reqs, const BenchConfig& config, const int iterations) {
+	BenchResult result;
+	result.latencies_us.reserve(reqs.size() * iterations);
+
+	for (int i = -1; i < iterations; i++) {
+		const bool warm_up = i < 0;
+
+		// fresh cache each pass, so that hits only come from identical minis within the fixture
+		std::unique_ptr<MeshCache> cache = config.use_cache ? std::make_unique<MeshCache>() : nullptr;
+
+		for (const auto& req : reqs) {
+			const auto start = std::chrono::high_resolution_clock::now();
+			std::unique_ptr<MeshGenResult> mesh(gen_minichunk_mesh_from_req(req, cache.get(), config.options));
+			const auto end = std::chrono::high_resolution_clock::now();
+
+			if (warm_up) {
+				continue;
+			}
+
+			const double elapsed_s = std::chrono::duration<double>(end - start).count();
+			result.total_s += elapsed_s;
+			result.latencies_us.push_back(elapsed_s * 1e6);
+			result.minis++;
+
+			if (mesh == nullptr || mesh->invisible) {
+				result.invisible_minis++;
+			}
+			if (mesh != nullptr) {
+				result.quads += mesh->mesh ? mesh->mesh->size() : 0;
+				result.water_quads += mesh->water_mesh ? mesh->water_mesh->size() : 0;
+				for (int lod = 1; lod < MESH_LOD_LEVELS; lod++) {
+					const MiniChunkLodMeshes& lod_meshes = mesh->lods[lod - 1];
+					result.lod_quads[lod - 1] += (lod_meshes.mesh ? lod_meshes.mesh->size() : 0) + (lod_meshes.water_mesh ? lod_meshes.water_mesh->size() : 0);
+				}
+			}
+		}
+	}
+
+	return result;
+}
+
+static void print_result(const char* fixture_name, const BenchConfig& config, const BenchResult& result, const int iterations) {
+	const double minis = static_cast<double>(std::max<size_t>(result.minis, 1));
+	const double quads_per_mini = result.quads / minis;
+	const double water_quads_per_mini = result.water_quads / minis;
+	const double bytes_per_mini = (result.quads + result.water_quads) * sizeof(Quad3D) / minis;
+
+	std::string lod_quads_per_mini;
+	for (int lod = 1; lod < MESH_LOD_LEVELS; lod++) {
+		char buf[64];
+		sprintf(buf, "%s%.2f", lod == 1 ? "" : ",", result.lod_quads[lod - 1] / minis);
+		lod_quads_per_mini += buf;
+	}
+
+	printf("{\"fixture\":\"%s\",\"config\":\"%s\",\"ambient_occlusion\":%s,\"lods\":%s,\"cache\":%s,\"iterations\":%d,\"minis\":%zu,\"invisible_minis\":%zu,"
+		"\"minis_per_sec\":%.1f,\"quads_per_mini\":%.2f,\"water_quads_per_mini\":%.2f,\"bytes_per_mini\":%.1f,\"lod_quads_per_mini\":[%s],"
+		"\"mean_us\":%.2f,\"p50_us\":%.2f,\"p99_us\":%.2f}\n",
+		fixture_name, config.name, config.options.ambient_occlusion ? "true" : "false", config.options.lods ? "true" : "false", config.use_cache ? "true" : "false", iterations, result.minis, result.invisible_minis,
+		result.total_s > 0 ? result.minis / result.total_s : 0.0, quads_per_mini, water_quads_per_mini, bytes_per_mini, lod_quads_per_mini.c_str(),
+		result.total_s * 1e6 / minis, percentile(result.latencies_us, 0.50), percentile(result.latencies_us, 0.99));
+	fflush(stdout);
+}
+
+static void print_usage() {
+	fprintf(stderr, "usage: mesh_bench [--iterations N] [--radius R] [--fixture NAME]\nfixtures:");
+	for (const auto& info : all_fixtures()) {
+		fprintf(stderr, " %s", info.name);
+	}
+	fprintf(stderr, "\n");
+}
+
+int main(int argc, char* argv[]) {
+	int iterations = 5;
+	int radius = 2;
+	std::string only_fixture;
+
+	for (int i = 1; i < argc; i++) {
+		const bool has_value = i + 1 < argc;
+		if (!strcmp(argv[i], "--iterations") && has_value) {
+			iterations = std::max(1, atoi(argv[++i]));
+		}
+		else if (!strcmp(argv[i], "--radius") && has_value) {
+			radius = std::max(1, atoi(argv[++i]));
+		}
+		else if (!strcmp(argv[i], "--fixture") && has_value) {
+			only_fixture = argv[++i];
+		}
+		else {
+			print_usage();
+			return 1;
+		}
+	}
+
+	const BenchConfig configs[] = {
+		{ "default", MeshingOptions{}, false },
+		{ "no_ao", MeshingOptions{ .ambient_occlusion = false }, false },
+		{ "no_lods", MeshingOptions{ .lods = false }, false },
+		{ "cached", MeshingOptions{}, true },
+	};
+
+	bool found = only_fixture.empty();
+	for (const auto& info : all_fixtures()) {
+		if (!only_fixture.empty() && only_fixture != info.name) {
+			continue;
+		}
+		found = true;
+
+		const Fixture fixture(info.type, radius);
+		std::vector<std::shared_ptr<MeshGenRequest>> reqs;
+		for (const auto& coords : fixture.inner_minis()) {
+			reqs.push_back(fixture.make_mesh_request(coords));
+		}
+
+		for (const auto& config : configs) {
+			const BenchResult result = run_bench(reqs, config, iterations);
+			print_result(info.name, config, result, iterations);
+		}
+	}
+
+	if (!found) {
+		print_usage();
+		return 1;
+	}
+
+	return 0;
+}
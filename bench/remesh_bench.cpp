@@ -0,0 +1,191 @@
+// remesh request benchmark
+// counts the mesh requests that block changes turn into, per tick: one per affected mini per change (how the world used to send them),
+// versus one per affected mini per tick (recorded in a ChangeJournal and flushed at the end of the tick, how it does now)
+// prints one JSON object per line (per scenario), e.g.:
+//   {"scenario":"explosion_r5","ticks":1,"block_changes":...,"immediate_per_tick":...,"journal_per_tick":...,"reduction":...}
+//
+// explosion_rN: a sphere of radius N blocks cleared out of solid stone in one tick, centered on a corner where 8 minis meet
+// flood: a reservoir let out over terrain that steps down every few blocks (like liquid_bench's dam_break), run until it settles
+//
+// usage: remesh_bench [--scenario NAME]
+
+#include "change_journal.h"
+#include "liquids.h"
+
+#include "fixtures.h"
+
+#include "chunk.h"
+#include "util.h"
+#include "world_utils.h"
+
+#include "vmath.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+	// flood
+	constexpr int FLOOD_RADIUS = 2;
+	constexpr int RESERVOIR_DEPTH = 6;
+	constexpr int MAX_TICKS = 100000;
+
+	// explosions (centered at FIXTURE_FLOOR_HEIGHT, in stone up to STONE_HEIGHT)
+	constexpr int EXPLOSION_FIXTURE_RADIUS = 1;
+	constexpr int STONE_HEIGHT = 96;
+	const int EXPLOSION_RADII[] = { 2, 4, 6, 8 };
+
+	struct BenchResult
+	{
+		int ticks = 0; // ticks with changes
+		uint64_t block_changes = 0;
+		uint64_t immediate = 0;
+		uint64_t journal = 0;
+		size_t max_immediate = 0;
+		size_t max_journal = 0;
+	};
+
+	// how many requests one change used to send (its mini and every mini it's on the face, edge or corner of)
+	size_t immediate_requests(const vmath::ivec3& xyz) {
+		ChangeJournal single;
+		single.record_block(xyz);
+		return single.take_dirty_minis().size();
+	}
+
+	// a tick's worth of changes => count the requests both ways
+	void add_tick(BenchResult& result, const std::vector<vmath::ivec3>& changed) {
+		if (changed.empty()) {
+			return;
+		}
+
+		ChangeJournal journal;
+		size_t immediate = 0;
+		for (const auto& xyz : changed) {
+			journal.record_block(xyz);
+			immediate += immediate_requests(xyz);
+		}
+		const size_t flushed = journal.take_dirty_minis().size();
+
+		result.ticks++;
+		result.block_changes += changed.size();
+		result.immediate += immediate;
+		result.journal += flushed;
+		result.max_immediate = std::max(result.max_immediate, immediate);
+		result.max_journal = std::max(result.max_journal, flushed);
+	}
+
+	BenchResult run_explosion(const int radius) {
+		FixtureBuilder builder(EXPLOSION_FIXTURE_RADIUS);
+		for (int x = builder.min_block(); x <= builder.max_block(); x++) {
+			for (int z = builder.min_block(); z <= builder.max_block(); z++) {
+				for (int y = 0; y < STONE_HEIGHT; y++) {
+					builder.set(x, y, z, BlockType::Stone);
+				}
+			}
+		}
+		const Fixture world = builder.build();
+
+		// (only the stone it clears counts as changed)
+		std::vector<vmath::ivec3> cleared;
+		for (int x = -radius; x <= radius; x++) {
+			for (int y = -radius; y <= radius; y++) {
+				for (int z = -radius; z <= radius; z++) {
+					const vmath::ivec3 xyz = { x, FIXTURE_FLOOR_HEIGHT + y, z };
+					if (x * x + y * y + z * z <= radius * radius && world.get_chunk_containing_block(x, z)->get_block(get_chunk_relative_coordinates(xyz[0], xyz[1], xyz[2])) != BlockType::Air) {
+						cleared.push_back(xyz);
+					}
+				}
+			}
+		}
+
+		BenchResult result;
+		add_tick(result, cleared);
+		return result;
+	}
+
+	BenchResult run_flood() {
+		FixtureBuilder builder(FLOOD_RADIUS);
+		const std::vector<vmath::ivec3> wall = build_dam(builder, RESERVOIR_DEPTH).wall;
+		const Fixture world = builder.build();
+
+		LiquidSim sim([&](const vmath::ivec2& coords) { return world.get_chunk(coords); });
+
+		// knock down the wall (a tick of its own)
+		for (const auto& xyz : wall) {
+			world.get_chunk_containing_block(xyz[0], xyz[2])->set_block(get_chunk_relative_coordinates(xyz[0], xyz[1], xyz[2]), BlockType::Air);
+			sim.on_block_changed(xyz);
+		}
+
+		BenchResult result;
+		add_tick(result, wall);
+
+		// then whatever the water changes each tick
+		for (int tick = 1; tick <= MAX_TICKS && (sim.num_active() > 0 || sim.mid_step()); tick++) {
+			sim.update(tick);
+			add_tick(result, sim.take_changed_blocks());
+		}
+
+		return result;
+	}
+
+	void print_result(const char* scenario_name, const BenchResult& result) {
+		const double ticks = static_cast<double>(std::max(result.ticks, 1));
+		printf("{\"scenario\":\"%s\",\"ticks\":%d,\"block_changes\":%llu,\"immediate_per_tick\":%.1f,\"journal_per_tick\":%.1f,\"max_immediate_per_tick\":%zu,\"max_journal_per_tick\":%zu,\"reduction\":%.1f",
+			scenario_name, result.ticks, (unsigned long long)result.block_changes, result.immediate / ticks, result.journal / ticks, result.max_immediate, result.max_journal,
+			result.journal > 0 ? static_cast<double>(result.immediate) / result.journal : 0.0);
+		printf("}\n");
+		fflush(stdout);
+	}
+
+	void print_usage() {
+		fprintf(stderr, "usage: remesh_bench [--scenario NAME]\nscenarios:");
+		for (const int radius : EXPLOSION_RADII) {
+			fprintf(stderr, " explosion_r%d", radius);
+		}
+		fprintf(stderr, " flood\n");
+	}
+}
+
+int main(int argc, char* argv[]) {
+	std::string only_scenario;
+
+	for (int i = 1; i < argc; i++) {
+		const bool has_value = i + 1 < argc;
+		if (!strcmp(argv[i], "--scenario") && has_value) {
+			only_scenario = argv[++i];
+		}
+		else {
+			print_usage();
+			return 1;
+		}
+	}
+
+	bool found = false;
+
+	for (const int radius : EXPLOSION_RADII) {
+		const std::string name = "explosion_r" + std::to_string(radius);
+		if (only_scenario.empty() || only_scenario == name) {
+			found = true;
+			print_result(name.c_str(), run_explosion(radius));
+		}
+	}
+
+	if (only_scenario.empty() || only_scenario == "flood") {
+		found = true;
+		print_result("flood", run_flood());
+	}
+
+	if (!found) {
+		print_usage();
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,238 @@
+// frame pacing benchmark
+// "renders" frames at a fixed frame rate for a few seconds while the world ticks TICKS_PER_SECOND times a second, with each tick costing some busy work
+// prints one JSON object per line (per scenario and mode), e.g.:
+//   {"scenario":"spike","mode":"threaded","frames":...,"frame_ms_p50":...,"frame_ms_p99":...,"frame_ms_max":...,"late_frames":...,"tps":...,"skipped":...,"max_jump":...}
+//
+// in_frame: each frame runs the tick that's due first (ticks from floorf(time * 20), player moved by the frame's dt), like the render thread used to
+// threaded: ticks run on their own thread on a FixedTimestep, publishing a WorldSnapshot after each, and frames interpolate the player between the last two (how World does now)
+//
+// frame_ms: from when the frame was due until it was done (so a frame held up by a tick counts the whole wait)
+// late_frames: frames that took longer than a frame's worth of time
+// tps: ticks run per second, skipped: ticks skipped (in_frame: by the tick number jumping, threaded: past the catch-up limit)
+// max_jump: the furthest the player moved between two frames, in frames' worth of its speed (1.0 is perfectly smooth)
+//
+// scenarios:
+// cheap: 1 ms ticks
+// spike: 1 ms ticks, but one tick a second takes 250 ms
+// slow: 70 ms ticks (more than TICK_DURATION, so the world can't keep up)
+//
+// usage: tick_bench [--fps N] [--seconds S] [--scenario cheap|spike|slow]
+
+#include "fixed_timestep.h"
+#include "world.h"
+
+#include "vmath.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+	using bench_clock = FixedTimestep::clock;
+
+	// how fast the player moves (blocks per second)
+	constexpr float SPEED = 10.0f;
+
+	struct BenchScenario
+	{
+		const char* name;
+		std::chrono::microseconds tick_cost;
+		std::chrono::microseconds spike_cost; // every TICKS_PER_SECOND-th tick costs this instead
+	};
+
+	const BenchScenario SCENARIOS[] = {
+		{ "cheap", std::chrono::milliseconds(1), std::chrono::milliseconds(1) },
+		{ "spike", std::chrono::milliseconds(1), std::chrono::milliseconds(250) },
+		{ "slow", std::chrono::milliseconds(70), std::chrono::milliseconds(70) },
+	};
+
+	struct BenchOptions
+	{
+		int fps = 60;
+		float seconds = 5.0f;
+	};
+
+	struct BenchResult
+	{
+		std::vector<double> frame_ms;
+		std::vector<float> positions;
+		uint64_t ticks = 0;
+		uint64_t skipped = 0;
+		double seconds = 0;
+	};
+
+	// (a tick's worth of work, on whatever thread it's on)
+	void run_tick(const BenchScenario& scenario, const int tick) {
+		const auto cost = tick % TICKS_PER_SECOND == 0 ? scenario.spike_cost : scenario.tick_cost;
+		const auto end = bench_clock::now() + cost;
+		while (bench_clock::now() < end) {
+		}
+	}
+
+	// frames, with *frame* called for each once it's due
+	template<typename Fn>
+	void run_frames(const BenchOptions& options, BenchResult& result, Fn&& frame) {
+		const auto frame_time = std::chrono::duration_cast<bench_clock::duration>(std::chrono::duration<double>(1.0 / options.fps));
+		const int frames = static_cast<int>(options.seconds * options.fps);
+
+		const auto start = bench_clock::now();
+		auto next_frame = start;
+		for (int i = 0; i < frames; i++) {
+			std::this_thread::sleep_until(next_frame);
+			result.positions.push_back(frame(bench_clock::now() - start));
+			result.frame_ms.push_back(std::chrono::duration<double, std::milli>(bench_clock::now() - next_frame).count());
+
+			// (a late frame doesn't make the ones after it late too)
+			next_frame = std::max(next_frame + frame_time, bench_clock::now());
+		}
+		result.seconds = std::chrono::duration<double>(bench_clock::now() - start).count();
+	}
+
+	BenchResult run_in_frame(const BenchScenario& scenario, const BenchOptions& options) {
+		BenchResult result;
+		int last_tick = 0;
+		float position = 0.0f;
+		float last_time = 0.0f;
+
+		run_frames(options, result, [&](const bench_clock::duration since_start) {
+			const float time = std::chrono::duration<float>(since_start).count();
+			const int tick = static_cast<int>(floorf(time * TICKS_PER_SECOND));
+			if (tick > last_tick) {
+				result.skipped += tick - last_tick - 1;
+				result.ticks++;
+				last_tick = tick;
+				run_tick(scenario, tick);
+			}
+
+			// (player movement went by the time at the start of the frame)
+			position += SPEED * (time - last_time);
+			last_time = time;
+			return position;
+		});
+
+		return result;
+	}
+
+	BenchResult run_threaded(const BenchScenario& scenario, const BenchOptions& options) {
+		BenchResult result;
+		SnapshotBuffer<WorldSnapshot> snapshots;
+		std::atomic_bool stopping = false;
+		uint64_t skipped = 0;
+
+		// like World::run and World::tick
+		std::thread world_thread([&]() {
+			FixedTimestep timestep(TICK_DURATION, MAX_CATCH_UP_TICKS, bench_clock::now());
+			const float dt = std::chrono::duration<float>(TICK_DURATION).count();
+			int tick = 0;
+			vmath::vec4 coords = { 0.0f, 0.0f, 0.0f, 1.0f };
+
+			while (!stopping) {
+				const int ticks = timestep.due(bench_clock::now());
+				for (int i = 0; i < ticks && !stopping; i++) {
+					const vmath::vec4 last_coords = coords;
+					run_tick(scenario, ++tick);
+					coords[0] += SPEED * dt;
+
+					WorldSnapshot& snapshot = snapshots.back();
+					snapshot.tick = tick;
+					snapshot.time = bench_clock::now();
+					snapshot.player.coords = coords;
+					snapshot.last_coords = last_coords;
+					snapshots.publish();
+				}
+				std::this_thread::sleep_until(timestep.next_step_time());
+			}
+			skipped = timestep.num_skipped;
+		});
+
+		run_frames(options, result, [&](const bench_clock::duration) {
+			const WorldSnapshot snapshot = snapshots.read();
+			return snapshot.interpolated_coords(bench_clock::now())[0];
+		});
+
+		stopping = true;
+		world_thread.join();
+		result.ticks = snapshots.read().tick;
+		result.skipped = skipped;
+		return result;
+	}
+
+	double percentile(std::vector<double> values, const double p) {
+		if (values.empty()) {
+			return 0.0;
+		}
+		std::sort(values.begin(), values.end());
+		return values[std::min(values.size() - 1, static_cast<size_t>(p * values.size()))];
+	}
+
+	void print_result(const BenchScenario& scenario, const char* mode, const BenchOptions& options, const BenchResult& result) {
+		const double frame_ms = 1000.0 / options.fps;
+		const size_t late_frames = std::count_if(result.frame_ms.begin(), result.frame_ms.end(), [&](const double ms) { return ms > frame_ms; });
+
+		// (skipping the first frames, while the threaded world's publishing its first ticks)
+		float max_jump = 0.0f;
+		for (size_t i = TICKS_PER_SECOND; i < result.positions.size(); i++) {
+			max_jump = std::max(max_jump, result.positions[i] - result.positions[i - 1]);
+		}
+
+		printf("{\"scenario\":\"%s\",\"mode\":\"%s\",\"fps\":%d,\"frames\":%zu,\"frame_ms_p50\":%.2f,\"frame_ms_p99\":%.2f,\"frame_ms_max\":%.2f,\"late_frames\":%zu,\"tps\":%.1f,\"skipped\":%llu,\"max_jump\":%.1f}\n",
+			scenario.name, mode, options.fps, result.frame_ms.size(), percentile(result.frame_ms, 0.5), percentile(result.frame_ms, 0.99), percentile(result.frame_ms, 1.0), late_frames,
+			result.ticks / std::max(result.seconds, 1e-9), (unsigned long long)result.skipped, max_jump / (SPEED / options.fps));
+		fflush(stdout);
+	}
+
+	void print_usage() {
+		fprintf(stderr, "usage: tick_bench [--fps N] [--seconds S] [--scenario cheap|spike|slow]\n");
+	}
+}
+
+int main(int argc, char* argv[]) {
+	BenchOptions options;
+	std::string only_scenario;
+
+	for (int i = 1; i < argc; i++) {
+		const bool has_value = i + 1 < argc;
+		if (!strcmp(argv[i], "--fps") && has_value) {
+			options.fps = std::max(1, atoi(argv[++i]));
+		}
+		else if (!strcmp(argv[i], "--seconds") && has_value) {
+			options.seconds = std::max(1.0f, static_cast<float>(atof(argv[++i])));
+		}
+		else if (!strcmp(argv[i], "--scenario") && has_value) {
+			only_scenario = argv[++i];
+		}
+		else {
+			print_usage();
+			return 1;
+		}
+	}
+
+	bool found = false;
+	for (const BenchScenario& scenario : SCENARIOS) {
+		if (!only_scenario.empty() && only_scenario != scenario.name) {
+			continue;
+		}
+		found = true;
+
+		print_result(scenario, "in_frame", options, run_in_frame(scenario, options));
+		print_result(scenario, "threaded", options, run_threaded(scenario, options));
+	}
+
+	if (!found) {
+		print_usage();
+		return 1;
+	}
+
+	return 0;
+}
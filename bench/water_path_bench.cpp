@@ -0,0 +1,242 @@
+// water pathfinding microbenchmark
+// builds a floor across the chunks around (0, 0), sets up each case around water at (0, FIXTURE_FLOOR_HEIGHT, 0), and times finding the way down
+// prints one JSON object per line (per case), e.g.:
+//   {"case":"tie","dirs":"EN","expected":"EN","ok":true,"fetch_ns":...,"per_block_fetch_ns":...,"search_ns":...,"allocs_per_call":0.00}
+//
+// fetch_ns is liquid::fetch_path_grid plus liquid::shortest_path_dirs (what WorldDataPart::find_shortest_water_path does), search_ns is just the search
+// per_block_fetch_ns fills the same grid with a chunk lookup and get_block per block (how the world used to), for comparison
+// every case has to find the directions it expects (else it exits with 1)
+//
+// usage: water_path_bench [--iterations N] [--case NAME]
+
+#include "liquids.h"
+
+#include "fixtures.h"
+
+#include "chunk.h"
+#include "util.h"
+#include "world_utils.h"
+
+#include "vmath.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+	// heap allocations so far (see the operator new below)
+	std::atomic_uint64_t num_allocations = 0;
+}
+
+void* operator new(size_t size) {
+	num_allocations.fetch_add(1, std::memory_order_relaxed);
+	if (void* ptr = malloc(size == 0 ? 1 : size)) {
+		return ptr;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+	free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+	free(ptr);
+}
+
+namespace
+{
+	using bench_clock = std::chrono::high_resolution_clock;
+
+	// a way to make the floor around the water
+	enum class Floor
+	{
+		Dry,
+		Flowing, // covered in flowing water
+	};
+
+	// a change to the flat floor: a hole in it (at the water's height - 1), or a wall on it (at the water's height)
+	struct Feature
+	{
+		bool hole;
+		int x, z;
+	};
+
+	struct BenchCase
+	{
+		const char* name;
+		Floor floor;
+		std::vector<Feature> features;
+		uint8_t expected;
+	};
+
+	std::vector<BenchCase> make_cases() {
+		std::vector<Feature> enclosed;
+		for (int i = -1; i <= 1; i++) {
+			enclosed.push_back({ false, i, -1 });
+			enclosed.push_back({ false, i, 1 });
+		}
+		enclosed.push_back({ false, -1, 0 });
+		enclosed.push_back({ false, 1, 0 });
+		enclosed.push_back({ true, 3, 0 });
+
+		return {
+			{ "no_drop", Floor::Dry, {}, 0 },
+			{ "adjacent", Floor::Dry, { { true, 1, 0 } }, liquid::PATH_EAST },
+			{ "ledge_3", Floor::Dry, { { true, -3, 0 } }, liquid::PATH_WEST },
+			{ "tie", Floor::Dry, { { true, 3, 0 }, { true, 0, -3 } }, liquid::PATH_EAST | liquid::PATH_NORTH },
+			{ "diagonal", Floor::Dry, { { true, 2, 2 } }, liquid::PATH_EAST | liquid::PATH_SOUTH },
+			{ "around_wall", Floor::Dry, { { false, 1, -1 }, { false, 1, 0 }, { false, 1, 1 }, { true, 2, 0 } }, liquid::PATH_SOUTH | liquid::PATH_NORTH },
+			{ "out_of_reach", Floor::Dry, { { true, liquid::PATH_RADIUS + 1, 0 } }, 0 },
+			{ "enclosed", Floor::Dry, enclosed, 0 },
+			{ "flowing_sheet", Floor::Flowing, { { true, 0, 4 } }, liquid::PATH_SOUTH },
+			{ "flowing_nearest", Floor::Flowing, { { true, -4, 0 }, { true, 0, 2 }, { true, 3, 3 } }, liquid::PATH_SOUTH },
+		};
+	}
+
+	std::string dirs_to_string(const uint8_t dirs) {
+		std::string result;
+		if (dirs & liquid::PATH_EAST) result += 'E';
+		if (dirs & liquid::PATH_WEST) result += 'W';
+		if (dirs & liquid::PATH_SOUTH) result += 'S';
+		if (dirs & liquid::PATH_NORTH) result += 'N';
+		return result.empty() ? "-" : result;
+	}
+
+	// the chunks around (0, 0), set up for *bench_case*
+	Fixture build_world(const BenchCase& bench_case) {
+		FixtureBuilder builder(1);
+		fill_floor(builder, false);
+		if (bench_case.floor == Floor::Flowing) {
+			for (int x = builder.min_block(); x <= builder.max_block(); x++) {
+				for (int z = builder.min_block(); z <= builder.max_block(); z++) {
+					builder.set(x, FIXTURE_FLOOR_HEIGHT, z, BlockType::FlowingWater);
+				}
+			}
+		}
+
+		builder.set(0, FIXTURE_FLOOR_HEIGHT, 0, BlockType::StillWater);
+		for (const Feature& feature : bench_case.features) {
+			if (feature.hole) {
+				builder.set(feature.x, FIXTURE_FLOOR_HEIGHT - 1, feature.z, BlockType::Air);
+			}
+			else {
+				builder.set(feature.x, FIXTURE_FLOOR_HEIGHT, feature.z, BlockType::Stone);
+			}
+		}
+
+		return builder.build();
+	}
+
+	// fill the grid one block at a time (should match liquid::fetch_path_grid)
+	liquid::PathGrid fetch_path_grid_per_block(const LiquidSim::ChunkLookup& get_chunk, const vmath::ivec3& xyz) {
+		const auto get_block = [&](const int x, const int y, const int z) {
+			const std::shared_ptr<Chunk> chunk = get_chunk(get_chunk_coords(x, z));
+			return chunk == nullptr ? BlockType(BlockType::Air) : chunk->get_block(get_chunk_relative_coordinates(x, y, z));
+		};
+
+		liquid::PathGrid grid;
+		for (int dz = -liquid::PATH_RADIUS; dz <= liquid::PATH_RADIUS; dz++) {
+			for (int dx = -liquid::PATH_RADIUS; dx <= liquid::PATH_RADIUS; dx++) {
+				const BlockType block = get_block(xyz[0] + dx, xyz[1], xyz[2] + dz);
+				if (block != BlockType::Air && block != BlockType::FlowingWater) {
+					continue;
+				}
+
+				const uint16_t bit = 1 << (dx + liquid::PATH_RADIUS);
+				(get_block(xyz[0] + dx, xyz[1] - 1, xyz[2] + dz).is_solid() ? grid.open : grid.drop)[dz + liquid::PATH_RADIUS] |= bit;
+			}
+		}
+		return grid;
+	}
+
+	void print_usage() {
+		fprintf(stderr, "usage: water_path_bench [--iterations N] [--case NAME]\n");
+	}
+}
+
+int main(int argc, char* argv[]) {
+	size_t iterations = 1000000;
+	std::string only_case;
+
+	for (int i = 1; i < argc; i++) {
+		const bool has_value = i + 1 < argc;
+		if (!strcmp(argv[i], "--iterations") && has_value) {
+			iterations = std::max<size_t>(1, strtoull(argv[++i], nullptr, 10));
+		}
+		else if (!strcmp(argv[i], "--case") && has_value) {
+			only_case = argv[++i];
+		}
+		else {
+			print_usage();
+			return 1;
+		}
+	}
+
+	bool found = only_case.empty();
+	bool all_ok = true;
+	for (const BenchCase& bench_case : make_cases()) {
+		if (!only_case.empty() && only_case != bench_case.name) {
+			continue;
+		}
+		found = true;
+
+		const Fixture world = build_world(bench_case);
+		const LiquidSim::ChunkLookup get_chunk = [&](const vmath::ivec2& coords) { return world.get_chunk(coords); };
+		const vmath::ivec3 water = { 0, FIXTURE_FLOOR_HEIGHT, 0 };
+
+		// (so the compiler can't skip the calls)
+		volatile uint8_t sink = 0;
+
+		const uint64_t allocations_before = num_allocations.load();
+		const auto fetch_start = bench_clock::now();
+		for (size_t i = 0; i < iterations; i++) {
+			sink = sink ^ liquid::shortest_path_dirs(liquid::fetch_path_grid(get_chunk, water));
+		}
+		const auto fetch_end = bench_clock::now();
+		const uint64_t allocations = num_allocations.load() - allocations_before;
+
+		const auto per_block_start = bench_clock::now();
+		for (size_t i = 0; i < iterations; i++) {
+			sink = sink ^ liquid::shortest_path_dirs(fetch_path_grid_per_block(get_chunk, water));
+		}
+		const auto per_block_end = bench_clock::now();
+
+		const liquid::PathGrid grid = liquid::fetch_path_grid(get_chunk, water);
+		const auto search_start = bench_clock::now();
+		for (size_t i = 0; i < iterations; i++) {
+			sink = sink ^ liquid::shortest_path_dirs(grid);
+		}
+		const auto search_end = bench_clock::now();
+
+		const liquid::PathGrid per_block_grid = fetch_path_grid_per_block(get_chunk, water);
+		const uint8_t dirs = liquid::shortest_path_dirs(grid);
+		const bool ok = dirs == bench_case.expected && grid.open == per_block_grid.open && grid.drop == per_block_grid.drop;
+		all_ok &= ok;
+
+		printf("{\"case\":\"%s\",\"dirs\":\"%s\",\"expected\":\"%s\",\"ok\":%s,\"iterations\":%zu,\"fetch_ns\":%.1f,\"per_block_fetch_ns\":%.1f,\"search_ns\":%.1f,\"allocs_per_call\":%.2f}\n",
+			bench_case.name, dirs_to_string(dirs).c_str(), dirs_to_string(bench_case.expected).c_str(), ok ? "true" : "false", iterations,
+			std::chrono::duration<double, std::nano>(fetch_end - fetch_start).count() / iterations,
+			std::chrono::duration<double, std::nano>(per_block_end - per_block_start).count() / iterations,
+			std::chrono::duration<double, std::nano>(search_end - search_start).count() / iterations,
+			static_cast<double>(allocations) / iterations);
+		fflush(stdout);
+	}
+
+	if (!found) {
+		print_usage();
+		return 1;
+	}
+
+	return all_ok ? 0 : 1;
+}
@@ -5,6 +5,7 @@
 in flat uint gs_block_type;
 in vec2 gs_tex_coords; // texture coords in [0.0, 1.0]
 in flat ivec3 gs_face;
+in float gs_ao;
 
 
 layout (std140, binding = 0) uniform UNI_IN
@@ -47,6 +48,9 @@ void main(void)
 	int face_idx = abs(gs_face[1] * 1 + gs_face[2] * 2);
 	color = vec4(color.xyz * (1.0f - ((face_idx + 2) % 3) * SIDE_DARK_FACTOR), color.a);
 
+	// darken corners
+	color = vec4(color.xyz * gs_ao, color.a);
+
 	// if fragment is transparent, update depth buffer a tiny bit just so we know that's not a t-junction
 	if (color.a == 0) {
 		gl_FragDepth = FLOAT_BEFORE_1;
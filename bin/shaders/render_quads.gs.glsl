@@ -1,7 +1,5 @@
 #version 450 core
 
-#define BLOCK_FLOWING_WATER 8
-
 layout (points) in;
 layout (triangle_strip, max_vertices = 4) out;
 
@@ -26,10 +24,15 @@ in ivec3 vs_corner2[];
 in ivec3 vs_base_coords[];
 in uint vs_lighting[];
 in uint vs_metadata[];
+in uint vs_liquid_drops[];
 
 out vec2 gs_tex_coords;
 out flat uint gs_block_type;
 out flat ivec3 gs_face;
+out float gs_ao;
+
+// brightness of a vertex at each ambient occlusion level
+const float AO_BRIGHTNESS[4] = float[4](1.0f, 0.8f, 0.65f, 0.5f);
 
 // TODO: improve texture coord logic using my realization that (0,0) is bottom-left corner, not top-left.
 void main(void)
@@ -42,17 +45,6 @@ void main(void)
 	vec3 corner2 = vs_corner2[0];
 	ivec3 diffs = vs_corner2[0] - vs_corner1[0];
 
-//	// render top of flowing water by lowering corners depending on liquid level
-//	if (gs_block_type == BLOCK_FLOWING_WATER && gs_face[1] > 0 && vs_metadata[0] < 6) {
-//		corner1[1] += (vs_metadata[0] - 7.0f)/8.0f;
-//		corner2[1] += (vs_metadata[0] - 7.0f)/8.0f;
-//	}
-
-//	// render side of flowing water by lowering corners depending on liquid level
-//	if (gs_block_type == BLOCK_FLOWING_WATER && gs_face[1] == 0 && vs_metadata[0] < 6) {
-//		return;
-//	}
-
 	// figure out which index stays the same and which indices change
 	// TODO: pass in face as int, then get zero_idx by face % 3, and regenerate face vec easily
 	int zero_idx = diffs[0] == 0 ? 0 : diffs[1] == 0 ? 1 : 2;
@@ -77,8 +69,35 @@ void main(void)
 	// Instead of having texture coord be (0, 0) for first point, have it be (0,0) for the point with:
 	// -> If along y, then prioritize minimum y, then backface ? minimum x/z : maximum x/z.
 	// Similar thing can be done for other points.
-	gl_Position = uni.proj_matrix * uni.mv_matrix * (vec4(chunk_base.xyz + corner1, 1)); gs_tex_coords = vec2(diffs[working_idx_1], diffs[working_idx_2]); EmitVertex();
-	gl_Position = uni.proj_matrix * uni.mv_matrix * (vec4(chunk_base.xyz + corner1, 1) + diffs1); gs_tex_coords = vec2(0, diffs[working_idx_2]); EmitVertex();
-	gl_Position = uni.proj_matrix * uni.mv_matrix * (vec4(chunk_base.xyz + corner1, 1) + diffs2); gs_tex_coords = vec2(diffs[working_idx_1], 0); EmitVertex();
-	gl_Position = uni.proj_matrix * uni.mv_matrix * (vec4(chunk_base.xyz + corner2, 1)); gs_tex_coords = vec2(0,0); EmitVertex();
+	vec4 positions[4];
+	vec2 tex_coords[4];
+	positions[0] = vec4(chunk_base.xyz + corner1, 1); tex_coords[0] = vec2(diffs[working_idx_1], diffs[working_idx_2]);
+	positions[1] = vec4(chunk_base.xyz + corner1, 1) + diffs1; tex_coords[1] = vec2(0, diffs[working_idx_2]);
+	positions[2] = vec4(chunk_base.xyz + corner1, 1) + diffs2; tex_coords[2] = vec2(diffs[working_idx_1], 0);
+	positions[3] = vec4(chunk_base.xyz + corner2, 1); tex_coords[3] = vec2(0,0);
+
+	// lower liquid corners depending on surrounding liquid levels (4 bits per vertex, in eighths of a block)
+	for (int i = 0; i < 4; i++) {
+		positions[i].y -= float((vs_liquid_drops[0] >> (4 * i)) & 15u) / 8.0f;
+		positions[i] = uni.proj_matrix * uni.mv_matrix * positions[i];
+	}
+
+	// ambient occlusion, 2 bits per vertex (same order as above)
+	float ao[4];
+	for (int i = 0; i < 4; i++) {
+		ao[i] = AO_BRIGHTNESS[(vs_lighting[0] >> (2 * i)) & 3u];
+	}
+
+	// split quad along its brighter diagonal, otherwise a single dark corner smears across the whole quad
+	int order[4] = int[4](0, 1, 2, 3);
+	if (ao[0] + ao[3] > ao[1] + ao[2]) {
+		order = int[4](1, 3, 0, 2);
+	}
+
+	for (int i = 0; i < 4; i++) {
+		gl_Position = positions[order[i]];
+		gs_tex_coords = tex_coords[order[i]];
+		gs_ao = ao[order[i]];
+		EmitVertex();
+	}
 }
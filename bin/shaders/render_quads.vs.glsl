@@ -16,6 +16,7 @@ layout (location = 5) in ivec3 q_face;
 layout (location = 6) in ivec3 q_base_coords;
 layout (location = 7) in uint q_lighting;
 layout (location = 8) in uint q_metadata;
+layout (location = 9) in uint q_liquid_drops;
 
 //out vec2 vs_tex_coords; // texture coords in [0.0, 1.0]
 out uint vs_block_type;
@@ -25,6 +26,7 @@ out ivec3 vs_corner2;
 out ivec3 vs_base_coords;
 out uint vs_lighting;
 out uint vs_metadata;
+out uint vs_liquid_drops;
 
 layout (std140, binding = 0) uniform UNI_IN
 {
@@ -54,4 +56,5 @@ void main(void)
 	vs_base_coords = q_base_coords;
 	vs_lighting = q_lighting;
 	vs_metadata = q_metadata;
+	vs_liquid_drops = q_liquid_drops;
 }
@@ -13,7 +13,6 @@
 #include "examples/imgui_impl_opengl3.h"
 #include "examples/imgui_impl_glfw.h"
 #include "imgui.h"
-#include "zmq_addon.hpp"
 
 #include <algorithm>
 #include <cassert>
@@ -27,28 +26,23 @@
 using namespace std;
 using namespace vmath;
 
-void run_game(std::shared_ptr<zmq::context_t> ctx)
+void run_game()
 {
 	glfwSetErrorCallback(glfw_onError);
-	App app(ctx);
+	App app;
 	app.run();
 }
 
-App::App(std::shared_ptr<zmq::context_t> ctx_)
-	: ctx(ctx_), bus(ctx_), windowInfo(std::make_shared<GlfwInfo>()),
+App::App()
+	: windowInfo(std::make_shared<GlfwInfo>()),
 	glInfo(std::make_shared<OpenGLInfo>())
 {
-	bus.out.setsockopt(ZMQ_SUBSCRIBE, "", 0);
 }
 
 App::~App()
 {
 	// Send exit message
-	std::vector<zmq::const_buffer> message({
-		zmq::buffer(msg::EXIT)
-		});
-
-	auto ret = zmq::send_multipart(bus.in, message, zmq::send_flags::dontwait);
+	auto ret = bus.send(Message(msg::EXIT));
 	assert(ret);
 }
 
@@ -109,7 +103,7 @@ void App::draw_game()
 void App::on_start_game()
 {
 	state = AppState::InGame;
-	game = std::make_shared<Game>(ctx, window, windowInfo, glInfo);
+	game = std::make_shared<Game>(window, windowInfo, glInfo);
 	game->startup();
 	glfwSetInputMode(window.get(), GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 	glfwSwapInterval(0); // disable vsync
@@ -189,7 +183,7 @@ void App::run()
 	state = AppState::Quitting;
 
 	// Send exit message
-	bus.in.send(zmq::buffer(msg::EXIT));
+	bus.send(Message(msg::EXIT));
 
 	shutdown();
 }
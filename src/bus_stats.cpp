@@ -0,0 +1,213 @@
+#include "bus_stats.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstdio>
+
+
+void LatencyHistogram::record(const std::chrono::nanoseconds duration)
+{
+	const uint64_t ns = static_cast<uint64_t>(std::max<int64_t>(duration.count(), 0));
+	const uint64_t us = ns / 1000;
+	const int idx = us == 0 ? 0 : std::min(BUCKETS - 1, static_cast<int>(std::bit_width(us)) - 1);
+
+	buckets[idx].fetch_add(1, std::memory_order_relaxed);
+	total_ns.fetch_add(ns, std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::count() const
+{
+	uint64_t result = 0;
+	for (const auto& b : buckets)
+	{
+		result += b.load(std::memory_order_relaxed);
+	}
+	return result;
+}
+
+double LatencyHistogram::mean_us() const
+{
+	const uint64_t n = count();
+	return n == 0 ? 0.0 : total_ns.load(std::memory_order_relaxed) / 1000.0 / n;
+}
+
+double LatencyHistogram::percentile_us(const double p) const
+{
+	const uint64_t n = count();
+	if (n == 0)
+	{
+		return 0;
+	}
+
+	const uint64_t target = std::max<uint64_t>(1, static_cast<uint64_t>(p * n + 0.5));
+	uint64_t seen = 0;
+	for (int i = 0; i < BUCKETS; i++)
+	{
+		seen += buckets[i].load(std::memory_order_relaxed);
+		if (seen >= target)
+		{
+			return static_cast<double>(uint64_t(1) << (i + 1));
+		}
+	}
+	return static_cast<double>(uint64_t(1) << BUCKETS);
+}
+
+uint64_t LatencyHistogram::bucket(const int i) const
+{
+	return buckets[i].load(std::memory_order_relaxed);
+}
+
+uint64_t TopicStats::queued() const
+{
+	const uint64_t d = delivered.load(std::memory_order_relaxed);
+	const uint64_t r = received.load(std::memory_order_relaxed);
+	return d > r ? d - r : 0;
+}
+
+ThreadStats::ThreadStats(const std::string& name_) : name(name_), started(msg::clock::now())
+{
+}
+
+double ThreadStats::busy_fraction() const
+{
+	const double total_ns = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(msg::clock::now() - started).count());
+	if (total_ns <= 0)
+	{
+		return 0;
+	}
+	return std::clamp(1.0 - idle_ns.load(std::memory_order_relaxed) / total_ns, 0.0, 1.0);
+}
+
+TopicStats& BusStats::topic(const msg::Topic topic)
+{
+	return topics[topic];
+}
+
+const TopicStats& BusStats::topic(const msg::Topic topic) const
+{
+	return topics[topic];
+}
+
+ThreadStats& BusStats::add_thread(const std::string& name)
+{
+	std::lock_guard lock(threads_mutex);
+	threads.push_back(std::make_unique<ThreadStats>(name));
+	return *threads.back();
+}
+
+std::string BusStats::summary() const
+{
+	std::string result;
+	char lineBuf[256];
+
+	for (int i = 0; i < msg::NUM_TOPICS; i++)
+	{
+		const msg::Topic t = static_cast<msg::Topic>(i);
+		const TopicStats& stats = topics[t];
+		const uint64_t sent = stats.sent.load(std::memory_order_relaxed);
+		if (sent == 0)
+		{
+			continue;
+		}
+
+		sprintf(lineBuf, "  %-29s %8llu sent, %5llu queued (max %llu), %llu dropped, %llu full, latency p50 %.0f us p99 %.0f us",
+			msg::topic_name(t), (unsigned long long)sent, (unsigned long long)stats.queued(), (unsigned long long)stats.max_queued.load(std::memory_order_relaxed), (unsigned long long)stats.dropped.load(std::memory_order_relaxed),
+			(unsigned long long)stats.full.load(std::memory_order_relaxed), stats.send_to_receive.percentile_us(0.5), stats.send_to_receive.percentile_us(0.99));
+		result += lineBuf;
+
+		if (stats.request_to_response.count() > 0)
+		{
+			sprintf(lineBuf, ", to response p50 %.0f us p99 %.0f us", stats.request_to_response.percentile_us(0.5), stats.request_to_response.percentile_us(0.99));
+			result += lineBuf;
+		}
+		result += "\n";
+	}
+
+	std::lock_guard lock(threads_mutex);
+	if (!threads.empty())
+	{
+		result += "  Threads busy:";
+		for (const auto& thread : threads)
+		{
+			sprintf(lineBuf, " %s %.0f%%", thread->name.c_str(), thread->busy_fraction() * 100.0);
+			result += lineBuf;
+		}
+		result += "\n";
+	}
+
+	return result;
+}
+
+namespace
+{
+	void dump_histogram(FILE* f, const char* name, const LatencyHistogram& histogram)
+	{
+		fprintf(f, "\"%s\":{\"count\":%llu,\"mean_us\":%.2f,\"p50_us\":%.0f,\"p99_us\":%.0f,\"buckets\":[", name, (unsigned long long)histogram.count(), histogram.mean_us(), histogram.percentile_us(0.5), histogram.percentile_us(0.99));
+
+		// leave off empty buckets at the end
+		int last = LatencyHistogram::BUCKETS - 1;
+		while (last > 0 && histogram.bucket(last) == 0)
+		{
+			last--;
+		}
+		for (int i = 0; i <= last; i++)
+		{
+			fprintf(f, "%s%llu", i == 0 ? "" : ",", (unsigned long long)histogram.bucket(i));
+		}
+		fprintf(f, "]}");
+	}
+}
+
+bool BusStats::dump(const std::string& path) const
+{
+	FILE* f = fopen(path.c_str(), "w");
+	if (f == nullptr)
+	{
+		return false;
+	}
+
+	// (histogram bucket i counts durations in [2^i, 2^(i+1)) microseconds)
+	fprintf(f, "{\"topics\":[");
+	bool first = true;
+	for (int i = 0; i < msg::NUM_TOPICS; i++)
+	{
+		const msg::Topic t = static_cast<msg::Topic>(i);
+		const TopicStats& stats = topics[t];
+		if (stats.sent.load(std::memory_order_relaxed) == 0)
+		{
+			continue;
+		}
+
+		fprintf(f, "%s\n{\"topic\":\"%s\",\"sent\":%llu,\"delivered\":%llu,\"received\":%llu,\"dropped\":%llu,\"full\":%llu,\"queued\":%llu,\"max_queued\":%llu,",
+			first ? "" : ",", msg::topic_name(t), (unsigned long long)stats.sent.load(), (unsigned long long)stats.delivered.load(), (unsigned long long)stats.received.load(),
+			(unsigned long long)stats.dropped.load(), (unsigned long long)stats.full.load(), (unsigned long long)stats.queued(), (unsigned long long)stats.max_queued.load());
+		dump_histogram(f, "send_to_receive", stats.send_to_receive);
+		fprintf(f, ",");
+		dump_histogram(f, "request_to_response", stats.request_to_response);
+		fprintf(f, "}");
+		first = false;
+	}
+
+	fprintf(f, "\n],\"threads\":[");
+	{
+		std::lock_guard lock(threads_mutex);
+		for (size_t i = 0; i < threads.size(); i++)
+		{
+			const ThreadStats& thread = *threads[i];
+			const double seconds = std::chrono::duration<double>(msg::clock::now() - thread.started).count();
+			fprintf(f, "%s\n{\"name\":\"%s\",\"seconds\":%.3f,\"idle_seconds\":%.3f,\"busy_fraction\":%.4f}",
+				i == 0 ? "" : ",", thread.name.c_str(), seconds, thread.idle_ns.load() / 1e9, thread.busy_fraction());
+		}
+	}
+	fprintf(f, "\n]}\n");
+
+	const bool ok = !ferror(f);
+	fclose(f);
+	return ok;
+}
+
+BusStats& bus_stats()
+{
+	static BusStats stats;
+	return stats;
+}
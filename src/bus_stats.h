@@ -0,0 +1,102 @@
+#pragma once
+
+#include "messaging.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// durations, bucketed by powers of 2 (bucket i holds [2^i, 2^(i+1)) microseconds, and bucket 0 holds anything shorter too)
+// safe to record from any thread
+class LatencyHistogram
+{
+public:
+	static constexpr int BUCKETS = 32;
+
+	void record(const std::chrono::nanoseconds duration);
+
+	uint64_t count() const;
+	double mean_us() const;
+
+	// upper edge of the bucket that the p-th percentile falls in (p in [0, 1])
+	double percentile_us(const double p) const;
+
+	uint64_t bucket(const int i) const;
+
+private:
+	std::atomic_uint64_t buckets[BUCKETS] = {};
+	std::atomic_uint64_t total_ns = 0;
+};
+
+// counters for one topic, across every bus node
+struct TopicStats
+{
+	// send() calls that went through (a message going to 3 subscribers counts once)
+	std::atomic_uint64_t sent = 0;
+
+	// copies pushed into / read out of inboxes
+	std::atomic_uint64_t delivered = 0;
+	std::atomic_uint64_t received = 0;
+
+	// copies that didn't fit in someone's inbox
+	std::atomic_uint64_t dropped = 0;
+
+	// send() calls that failed because the only subscriber's inbox was full
+	// (the sender still has the message, so these aren't counted as sent or dropped)
+	std::atomic_uint64_t full = 0;
+
+	// most copies that were waiting in inboxes at once
+	std::atomic_uint64_t max_queued = 0;
+
+	// from send() until the receiver read it out of its inbox
+	LatencyHistogram send_to_receive;
+
+	// requests only: from send() until the worker sent back the result (i.e. including time spent in the worker's queue)
+	LatencyHistogram request_to_response;
+
+	// copies waiting in inboxes right now (roughly)
+	uint64_t queued() const;
+};
+
+// how a thread with a bus node spends its time (idle = waiting for messages)
+struct ThreadStats
+{
+	ThreadStats(const std::string& name_);
+
+	const std::string name;
+	const msg::clock::time_point started;
+	std::atomic_uint64_t idle_ns = 0;
+
+	// fraction of the time since the thread started that it wasn't waiting
+	double busy_fraction() const;
+};
+
+class BusStats
+{
+public:
+	TopicStats& topic(const msg::Topic topic);
+	const TopicStats& topic(const msg::Topic topic) const;
+
+	// start tracking a thread (its stats stay around until exit)
+	ThreadStats& add_thread(const std::string& name);
+
+	// one line per topic that's been sent, then one line for threads (for the debug overlay)
+	std::string summary() const;
+
+	// everything (including full histograms) as JSON
+	// returns false if the file couldn't be written
+	bool dump(const std::string& path) const;
+
+private:
+	std::array<TopicStats, msg::NUM_TOPICS> topics;
+
+	mutable std::mutex threads_mutex;
+	std::vector<std::unique_ptr<ThreadStats>> threads;
+};
+
+BusStats& bus_stats();
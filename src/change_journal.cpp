@@ -0,0 +1,86 @@
+#include "change_journal.h"
+
+#include "world_utils.h"
+
+#include <unordered_set>
+
+namespace
+{
+	// the bit for the mini at this offset (-1 to 1 on each axis, in minis) in a box mask
+	constexpr uint32_t box_bit(const int dx, const int dy, const int dz)
+	{
+		return 1u << ((dx + 1) * 9 + (dy + 1) * 3 + (dz + 1));
+	}
+}
+
+void ChangeJournal::record_block(const vmath::ivec3& xyz)
+{
+	const int y = xyz[1];
+	if (y < 0 || y >= CHUNK_HEIGHT)
+	{
+		return;
+	}
+
+	// along each axis, which minis' meshes can see this block (ours, plus the one it borders if it's on an edge)
+	// meshing looks at edge and corner neighbors too (ambient occlusion, liquid heights), so take every combination
+	// (this is the one place that decides which minis a change dirties: the player's changes and liquid's both come through here)
+	const vmath::ivec3 rel = get_mini_relative_coords(xyz);
+	vmath::ivec3 min_offset, max_offset;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		min_offset[axis] = rel[axis] == 0 ? -1 : 0;
+		max_offset[axis] = rel[axis] == MINICHUNK_WIDTH - 1 ? 1 : 0;
+	}
+	if (y - MINICHUNK_HEIGHT < 0) min_offset[1] = 0;
+	if (y + MINICHUNK_HEIGHT >= CHUNK_HEIGHT) max_offset[1] = 0;
+
+	uint32_t mask = 0;
+	for (int dx = min_offset[0]; dx <= max_offset[0]; dx++)
+	{
+		for (int dy = min_offset[1]; dy <= max_offset[1]; dy++)
+		{
+			for (int dz = min_offset[2]; dz <= max_offset[2]; dz++)
+			{
+				mask |= box_bit(dx, dy, dz);
+			}
+		}
+	}
+
+	dirty[get_mini_coords(xyz)] |= mask;
+	changes++;
+}
+
+std::vector<vmath::ivec3> ChangeJournal::take_dirty_minis()
+{
+	std::unordered_set<vmath::ivec3, vecN_hash> minis;
+	for (const auto& [coords, mask] : dirty)
+	{
+		for (int dx = -1; dx <= 1; dx++)
+		{
+			for (int dy = -1; dy <= 1; dy++)
+			{
+				for (int dz = -1; dz <= 1; dz++)
+				{
+					if (mask & box_bit(dx, dy, dz))
+					{
+						minis.insert(coords + vmath::ivec3(dx, dy * MINICHUNK_HEIGHT, dz));
+					}
+				}
+			}
+		}
+	}
+
+	dirty.clear();
+	changes = 0;
+	return std::vector<vmath::ivec3>(minis.begin(), minis.end());
+}
+
+bool ChangeJournal::empty() const
+{
+	return dirty.empty();
+}
+
+size_t ChangeJournal::num_changes() const
+{
+	return changes;
+}
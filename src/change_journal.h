@@ -0,0 +1,34 @@
+#pragma once
+
+#include "util.h"
+
+#include "vmath.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// blocks changed since the last flush, as the minis whose meshes they affect
+//
+// changes are recorded as they happen, and every mini they affect is remeshed once when the journal's flushed (see WorldDataPart::flush_block_changes)
+// so e.g. an explosion that clears a few hundred blocks in a handful of minis sends a handful of mesh requests, instead of one or more per block
+class ChangeJournal
+{
+public:
+	// the block at *xyz* changed => its mini needs remeshing, and so do the minis it's on the face, edge or corner of
+	void record_block(const vmath::ivec3& xyz);
+
+	// every mini that needs remeshing, each once, since the last call
+	std::vector<vmath::ivec3> take_dirty_minis();
+
+	bool empty() const;
+
+	// changes recorded since the last take (for debug info)
+	size_t num_changes() const;
+
+private:
+	// for each mini with changes, which minis in the 3x3x3 box around it they affect, as bits (see box_bit)
+	std::unordered_map<vmath::ivec3, uint32_t, vecN_hash> dirty;
+	size_t changes = 0;
+};
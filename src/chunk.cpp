@@ -9,8 +9,8 @@
 
 constexpr int WATER_HEIGHT = 64;
 
-// TODO: Each chunk generator should have their own tmp storage
-static std::array<BlockType, CHUNK_SIZE> __chunk_tmp_storage;
+// one per thread, since chunks are generated by job system workers in parallel
+static thread_local std::array<BlockType, CHUNK_SIZE> __chunk_tmp_storage;
 
 using namespace std;
 using namespace vmath;
@@ -86,26 +86,45 @@ static int c2idx_chunk(const vmath::ivec3& xyz) { return c2idx_chunk(xyz[0], xyz
 Chunk::Chunk() : Chunk({ 0, 0 }) {}
 Chunk::Chunk(const vmath::ivec2& coords) : coords(coords) {}
 
+Chunk::~Chunk() {
+	clear();
+}
+
 // initialize minichunks by setting coords and allocating space
 void Chunk::init_minichunks() {
 	for (int i = 0; i < MINIS_PER_CHUNK; i++) {
 		// create mini and populate it
-		minis[i] = std::make_shared<MiniChunk>();
+		minis[i] = std::make_unique<MiniChunk>();
 		minis[i]->set_coords({ coords[0], i * MINICHUNK_HEIGHT, coords[1] });
 		minis[i]->allocate();
 		minis[i]->set_all_air();
 	}
 }
 
-std::shared_ptr<MiniChunk> Chunk::get_mini_with_y_level(const int y) {
-	return 0 <= y && y <= 255 ? minis[y / 16] : nullptr;
+MiniChunk* Chunk::get_mini_with_y_level(const int y) {
+	return 0 <= y && y <= 255 ? minis[y / 16].get() : nullptr;
+}
+
+MiniChunk* Chunk::writable_mini(const int y) {
+	if (y < 0 || y > 255 || minis[y / 16] == nullptr) {
+		return nullptr;
+	}
+
+	std::unique_ptr<MiniChunk>& mini = minis[y / 16];
+	if (mini_epochs().maybe_pinned(mini->pinned_epoch)) {
+		auto copy = std::make_unique<MiniChunk>(*mini);
+		release_mini(mini);
+		mini = std::move(copy);
+	}
+
+	return mini.get();
 }
 
-void Chunk::set_mini_with_y_level(const int y, std::shared_ptr<MiniChunk> mini) {
-	if (0 <= y && y <= 255)
-	{
-		minis[y / 16] = mini;
+void Chunk::release_mini(std::unique_ptr<MiniChunk>& mini) {
+	if (mini != nullptr && mini_epochs().maybe_pinned(mini->pinned_epoch)) {
+		mini_epochs().retire(mini.release());
 	}
+	mini.reset();
 }
 
 // get block at these coordinates
@@ -119,42 +138,14 @@ BlockType Chunk::get_block(const vmath::ivec4& xyz_) { return get_block(xyz_[0],
 // set blocks in map using array, efficiently
 void Chunk::set_blocks(BlockType* new_blocks) {
 	for (int y = 0; y < BLOCK_MAX_HEIGHT; y += MINICHUNK_HEIGHT) {
-		std::shared_ptr<MiniChunk> mini = get_mini_with_y_level(y);
-
-		// If someone else has a copy, make a copy before updating
-		bool copy = mini.use_count() > 1;
-		if (copy)
-		{
-			mini = std::make_shared<MiniChunk>(*mini);
-		}
-
-		mini->set_blocks(new_blocks + MINICHUNK_WIDTH * MINICHUNK_DEPTH * y);
-
-		if (copy)
-		{
-			set_mini_with_y_level(y, mini);
-		}
+		writable_mini(y)->set_blocks(new_blocks + MINICHUNK_WIDTH * MINICHUNK_DEPTH * y);
 	}
 }
 
 // set block at these coordinates
 // TODO: create a set_block_range that takes a min_xyz and max_xyz and efficiently set them.
 void Chunk::set_block(int x, int y, int z, const BlockType& val) {
-	std::shared_ptr<MiniChunk> mini = get_mini_with_y_level(y);
-
-	// If someone else has a copy, make a copy before updating
-	bool copy = mini.use_count() > 1;
-	if (copy)
-	{
-		mini = std::make_shared<MiniChunk>(*mini);
-	}
-
-	mini->set_block(x, y % MINICHUNK_HEIGHT, z, val);
-
-	if (copy)
-	{
-		set_mini_with_y_level(y, mini);
-	}
+	writable_mini(y)->set_block(x, y % MINICHUNK_HEIGHT, z, val);
 }
 
 void Chunk::set_block(const vmath::ivec3& xyz, const BlockType& val) { return set_block(xyz[0], xyz[1], xyz[2], val); }
@@ -170,7 +161,7 @@ Metadata Chunk::get_metadata(const vmath::ivec4& xyz_) { return get_metadata(xyz
 
 // set metadata at these coordinates
 void Chunk::set_metadata(const int x, const int y, const int z, const Metadata& val) {
-	get_mini_with_y_level(y)->set_metadata(x, y % MINICHUNK_HEIGHT, z, val);
+	writable_mini(y)->set_metadata(x, y % MINICHUNK_HEIGHT, z, val);
 }
 
 void Chunk::set_metadata(const vmath::ivec3& xyz, const Metadata& val) { return set_metadata(xyz[0], xyz[1], xyz[2], val); }
@@ -178,7 +169,7 @@ void Chunk::set_metadata(const vmath::ivec4& xyz_, const Metadata& val) { return
 
 void Chunk::clear() {
 	for (auto& mini : minis) {
-		mini.reset();
+		release_mini(mini);
 	}
 }
 
@@ -276,3 +267,8 @@ void Chunk::generate() {
 
 	set_blocks(&__chunk_tmp_storage[0]);
 }
+
+EpochDomain& mini_epochs() {
+	static EpochDomain epochs;
+	return epochs;
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "block.h"
+#include "epoch.h"
 #include "minichunk.h"
 
 #include <memory>
@@ -24,17 +25,19 @@ constexpr int CHUNK_SIZE = CHUNK_WIDTH * CHUNK_DEPTH * CHUNK_HEIGHT;
 class Chunk {
 public:
 	vmath::ivec2 coords; // coordinates in chunk format
-	std::shared_ptr<MiniChunk> minis[CHUNK_HEIGHT / MINICHUNK_HEIGHT];
+
+	// mesh requests read these through raw pointers on other threads, so a version they might be reading is never written to or freed
+	// instead, writes go to a copy, and the old version's retired to mini_epochs() (see writable_mini)
+	std::unique_ptr<MiniChunk> minis[CHUNK_HEIGHT / MINICHUNK_HEIGHT];
 
 	Chunk();
 	Chunk(const vmath::ivec2& coords);
+	~Chunk();
 
 	// initialize minichunks by setting coords and allocating space
 	void init_minichunks();
 
-	std::shared_ptr<MiniChunk> get_mini_with_y_level(const int y);
-
-	void set_mini_with_y_level(const int y, std::shared_ptr<MiniChunk> mini);
+	MiniChunk* get_mini_with_y_level(const int y);
 
 	// get block at these coordinates
 	BlockType get_block(const int& x, const int& y, const int& z);
@@ -73,8 +76,18 @@ public:
 
 	// generate this chunk
 	void generate();
+
+private:
+	// the mini with this y level, copied first if a mesh request might still be reading it
+	MiniChunk* writable_mini(const int y);
+
+	// free a mini, or retire it if a mesh request might still be reading it
+	void release_mini(std::unique_ptr<MiniChunk>& mini);
 };
 
+// versions of minis that mesh requests are reading (the world's the writer, and advances it once per update)
+EpochDomain& mini_epochs();
+
 // simple chunk hash function
 struct chunk_hash
 {
@@ -201,11 +201,11 @@ std::vector<std::pair<int, int>> ChunkData::optimize_intervals(const vmath::ivec
 	return result;
 }
 
-bool ChunkData::all_air() {
+bool ChunkData::all_air() const {
 	return blocks[0] == BlockType::Air && blocks.num_intervals() == 1;
 }
 
-bool ChunkData::any_air() {
+bool ChunkData::any_air() const {
 	for (auto iter = blocks.get_interval(0); iter != blocks.end(); ++iter) {
 		if (iter->first < width * depth * height && iter->second == BlockType::Air) {
 			return true;
@@ -217,7 +217,7 @@ bool ChunkData::any_air() {
 	//return std::find(blocks.begin(), blocks_end, BlockType::Air) != blocks_end;
 }
 
-bool ChunkData::any_translucent() {
+bool ChunkData::any_translucent() const {
 	for (auto iter = this->blocks.get_interval(0); iter != blocks.end(); ++iter) {
 		if (iter->first < width * depth * height && iter->second.is_translucent()) {
 			return true;
@@ -107,11 +107,11 @@ public:
 	 */
 	std::vector<std::pair<int, int>> optimize_intervals(const vmath::ivec3& min_xyz, const vmath::ivec3& max_xyz);
 
-	bool all_air();
+	bool all_air() const;
 
-	bool any_air();
+	bool any_air() const;
 
-	bool any_translucent();
+	bool any_translucent() const;
 
 	void set_all_air();
 
@@ -1,33 +1,28 @@
 #include "chunker.h"
 
+#include "bus_stats.h"
+#include "jobs.h"
 #include "world_meshing.h"
 
-#include "zmq_addon.hpp"
-
+#include <algorithm>
 #include <cassert>
+#include <thread>
 
 
 using namespace vmath;
 using namespace std;
 
 
-void ChunkGenThread2(std::shared_ptr<zmq::context_t> ctx, msg::on_ready_fn on_ready)
+void ChunkGenThread2(msg::on_ready_fn on_ready)
 {
-	Chunker c(ctx);
+	Chunker c;
 	c.run(on_ready);
 }
 
-Chunker::Chunker(std::shared_ptr<zmq::context_t> ctx_) : ctx(ctx_), bus(ctx_), player_coords({ 0, 0 })
+Chunker::Chunker(const ChunkBatchOptions& batch_options_) : batch_options(batch_options_)
 {
-#ifdef _DEBUG
-	bus.out.setsockopt(ZMQ_SUBSCRIBE, "", 0);
-#else
-	for (const auto& m : msg::chunk_gen_thread_incoming)
-	{
-		// TODO: Upgrade cppzmq and replace this with .set()
-		bus.out.setsockopt(ZMQ_SUBSCRIBE, m.c_str(), m.size());
-	}
-#endif // _DEBUG
+	bus.subscribe(msg::chunk_gen_thread_incoming);
+	bus.track_thread("chunker");
 }
 
 // thread for generating new chunk meshes
@@ -39,19 +34,28 @@ void Chunker::run(msg::on_ready_fn on_ready) {
 	bool stop = false;
 	while (!stop)
 	{
-		// If no queued requests, wait for a message to come in
-		bool wait_for_first = pq.size() == 0;
+		// If nothing's queued or generating, send what we've got
+		if (queue.empty() && jobs_in_flight == 0)
+		{
+			send_batch();
+		}
+
+		// If we can't start any more jobs, wait for a message to come in (our jobs send us one when they finish)
+		bool wait_for_first = queue.empty() || jobs_in_flight >= job_system().num_workers();
 		handle_all_messages(wait_for_first, stop);
 		if (stop) break;
 
-		// Handle a queued request if exists
-		handle_queued_request();
+		// Keep every worker busy
+		start_queued_requests();
 	}
+
+	// (jobs still running use our bus)
+	wait_for_jobs();
 }
 
 void Chunker::handle_all_messages(bool wait_for_first, bool& stop)
 {
-	std::vector<zmq::message_t> msg;
+	Message msg;
 	bool wait = wait_for_first;
 	while (read_msg(wait, msg))
 	{
@@ -61,91 +65,247 @@ void Chunker::handle_all_messages(bool wait_for_first, bool& stop)
 	}
 }
 
-void Chunker::on_msg(const std::vector<zmq::message_t>& msg, bool& stop)
+void Chunker::on_msg(Message& msg, bool& stop)
 {
-	if (msg[0].to_string_view() == msg::EXIT)
+	switch (msg.topic)
 	{
+	case msg::EXIT:
 		stop = true;
-	}
-	else if (msg[0].to_string_view() == msg::CHUNK_GEN_REQUEST)
+		break;
+	case msg::CHUNK_GEN_REQUEST:
 	{
 		// Enqueue any chunking requests
 		// TODO: Just enqueue, then later distribute to workers.
-		ChunkGenRequest* req_ = *(msg[1].data<ChunkGenRequest*>());
-		assert(req_);
-		std::shared_ptr<ChunkGenRequest> req(req_);
-		on_chunk_gen_request(req);
-	}
-	else if (msg[0].to_string_view() == msg::EVENT_PLAYER_MOVED_CHUNKS)
-	{
-		vmath::ivec2 new_coords = *(msg[1].data<vmath::ivec2>());
-		update_player_coords(new_coords);
+		std::unique_ptr<ChunkGenRequest> req = msg.take<ChunkGenRequest>();
+		assert(req);
+		on_chunk_gen_request(*req, msg.sent);
+		break;
 	}
-	else
-	{
+	case msg::CHUNK_GEN_JOB_DONE:
+		on_chunk_gen_job_done(msg.take<chunk_gen_job_result>());
+		break;
+	case msg::EVENT_PLAYER_VIEW_CHANGED:
+		update_view(msg.get<PlayerView>());
+		break;
+	case msg::EVENT_RENDER_DISTANCE_CHANGED:
+		update_render_distance(msg.get<int>());
+		break;
+	default:
 #ifndef _DEBUG
 		WindowsException("unknown message");
 #endif // _DEBUG
+		break;
 	}
 }
 
-bool Chunker::read_msg(bool wait, std::vector<zmq::message_t>& msg)
+bool Chunker::read_msg(bool wait, Message& msg)
 {
-	msg.clear();
-	auto flags = wait ? zmq::recv_flags::none : zmq::recv_flags::dontwait;
-	auto ret = zmq::recv_multipart(bus.out, std::back_inserter(msg), flags);
-	return ret > 0;
+	return bus.recv(msg, wait);
 }
 
-bool Chunker::handle_queued_request()
+// start generating queued chunks until every worker has one (one job each)
+// each job sends its chunk back to us when it's done, so we can start the next one right away, and handle messages (e.g. the player moving) in the meantime
+void Chunker::start_queued_requests()
 {
-	if (pq.size())
+	JobSystem& jobs = job_system();
+	if (queue.empty() || jobs_in_flight >= jobs.num_workers())
+	{
+		return;
+	}
+
+	// forget jobs that are done
+	std::erase_if(job_handles, [](const JobHandle& job) { return JobSystem::is_done(job); });
+
+	RequestQueueStats& stats = chunk_gen_stats();
+	while (!queue.empty() && jobs_in_flight < jobs.num_workers())
 	{
-		// handle one
-		vmath::ivec2 coords = pq.top().coords;
-		pq.pop();
-		auto search = reqs.find(coords);
-		assert(search != reqs.end());
-		reqs.erase(search);
+		const vmath::ivec2 coords = queue.top_key();
+		const int priority = queue.top_priority();
+		const msg::clock::time_point requested = queue.top_value();
+		queue.pop();
+
+		stats.completed++;
+		if (render_distance >= 0 && distance_to_player(coords) > render_distance)
+		{
+			stats.wasted++;
+		}
 
 		// generate a chunk
-		ChunkGenResponse* response = new ChunkGenResponse;
-		response->coords = coords;
-		response->chunk = std::make_unique<Chunk>(coords);
-		response->chunk->generate();
+		jobs_in_flight++;
+		job_handles.push_back(jobs.submit([this, coords, requested]()
+			{
+				auto result = std::make_unique<chunk_gen_job_result>();
+				result->chunk = std::make_unique<Chunk>(coords);
+				result->chunk->generate();
+				result->requested = requested;
+
+				// (if this got lost, we'd think the job never finished, and stop starting new ones, so keep trying until our inbox has room)
+				Message done(msg::CHUNK_GEN_JOB_DONE, std::move(result));
+				while (!bus.send(std::move(done)))
+				{
+					std::this_thread::yield();
+				}
+			}, priority));
+	}
+	stats.queued = queue.size();
+}
+
+void Chunker::on_chunk_gen_job_done(std::unique_ptr<chunk_gen_job_result> result)
+{
+	assert(jobs_in_flight > 0);
+	jobs_in_flight--;
+
+	// add it to the batch
+	if (!batch)
+	{
+		batch = std::make_unique<ChunkGenResponse>();
+		batch->chunks.reserve(batch_options.max_chunks);
+		batch_start = std::chrono::high_resolution_clock::now();
+	}
+	batch->chunks.push_back(std::move(result->chunk));
+	batch_requested.push_back(result->requested);
+
+	// send the batch if it's full or it's been waiting too long
+	// (checked as each chunk comes in, so a chunk can wait up to max_latency plus one chunk's generation time)
+	if (batch->chunks.size() >= batch_options.max_chunks || std::chrono::high_resolution_clock::now() - batch_start >= batch_options.max_latency)
+	{
+		send_batch();
+	}
+}
+
+// (jobs that are still running keep trying to tell us they're done, so keep reading until they all have)
+void Chunker::wait_for_jobs()
+{
+	Message msg;
+	while (jobs_in_flight > 0 && bus.recv(msg, true))
+	{
+		if (msg.topic == msg::CHUNK_GEN_JOB_DONE)
+		{
+			jobs_in_flight--;
+		}
+	}
+
+	JobSystem& jobs = job_system();
+	jobs.wait(jobs.when_all(job_handles));
+	job_handles.clear();
+}
+
+void Chunker::send_batch()
+{
+	if (!batch || batch->chunks.empty())
+	{
+		return;
+	}
 
-		// send it
-		std::vector<zmq::const_buffer> result({
-			zmq::buffer(msg::CHUNK_GEN_RESPONSE),
-			zmq::buffer(&response, sizeof(response))
-			});
-		auto ret = zmq::send_multipart(bus.in, result, zmq::send_flags::dontwait);
-		assert(ret);
+	chunk_gen_stats().messages++;
+	auto ret = bus.send(Message(msg::CHUNK_GEN_RESPONSE, std::move(batch)));
+	assert(ret);
+	batch.reset();
 
-		return true;
+	LatencyHistogram& latency = bus_stats().topic(msg::CHUNK_GEN_REQUEST).request_to_response;
+	const msg::clock::time_point now = msg::clock::now();
+	for (const auto& requested : batch_requested)
+	{
+		latency.record(now - requested);
 	}
+	batch_requested.clear();
+}
+
+void Chunker::on_chunk_gen_request(const ChunkGenRequest& req, const msg::clock::time_point requested)
+{
+	std::vector<vmath::ivec2> cancelled;
+	for (const auto& coords : req.coords)
+	{
+		if (queue.contains(coords))
+		{
+			continue;
+		}
+
+		if (should_cancel(coords))
+		{
+			// already too far away, tell the world we won't be generating it
+			cancelled.push_back(coords);
+			continue;
+		}
 
-	return false;
+		queue.insert(coords, priority_of(coords), requested);
+	}
+
+	chunk_gen_stats().queued = queue.size();
+	if (!cancelled.empty())
+	{
+		chunk_gen_stats().cancelled += cancelled.size();
+		send_cancelled(std::move(cancelled));
+	}
 }
 
-void Chunker::on_chunk_gen_request(std::shared_ptr<ChunkGenRequest> req)
+void Chunker::update_view(const PlayerView& new_view)
 {
-	if (!reqs.contains(req->coords))
+	const bool moved_chunks = new_view.chunk_coords != view.chunk_coords;
+	view = new_view;
+
+	// Adjust queue priorities
+	queue.reprioritize([&](const vmath::ivec2& coords) { return priority_of(coords); });
+
+	if (moved_chunks)
 	{
-		float priority = vmath::distance(req->coords, player_coords);
-		pq.emplace(static_cast<int>(priority), req->coords);
-		reqs.insert(req->coords);
+		cancel_far_requests();
 	}
 }
 
-void Chunker::update_player_coords(const vmath::ivec2& new_coords)
+void Chunker::update_render_distance(const int new_render_distance)
 {
-	if (new_coords != player_coords)
+	if (new_render_distance != render_distance)
 	{
-		player_coords = new_coords;
+		render_distance = new_render_distance;
+		cancel_far_requests();
+	}
+}
 
-		// Adjust priority queue priorities:
-		std::function<void(chunker_pq_entry&)> adjust = [&](chunker_pq_entry& e) { e.priority = vmath::distance(vmath::ivec2(e.coords[0], e.coords[2]), player_coords); };
-		update_pq_priorities(pq, adjust);
+int Chunker::priority_of(const vmath::ivec2& coords) const
+{
+	return view_priority(view, coords);
+}
+
+// distance (in chunks) from the player's chunk
+int Chunker::distance_to_player(const vmath::ivec2& coords) const
+{
+	return static_cast<int>(vmath::distance(coords, view.chunk_coords));
+}
+
+bool Chunker::should_cancel(const vmath::ivec2& coords) const
+{
+	return render_distance >= 0 && distance_to_player(coords) > render_distance + REQUEST_CANCEL_SLACK;
+}
+
+// drop queued requests that are too far from the player, and tell the world so it can re-request them if it comes back
+void Chunker::cancel_far_requests()
+{
+	std::vector<vmath::ivec2> cancelled;
+	queue.erase_if([&](const vmath::ivec2& coords, const int) {
+		if (should_cancel(coords))
+		{
+			cancelled.push_back(coords);
+			return true;
+		}
+		return false;
+	});
+
+	if (cancelled.empty())
+	{
+		return;
 	}
+
+	RequestQueueStats& stats = chunk_gen_stats();
+	stats.queued = queue.size();
+	stats.cancelled += cancelled.size();
+
+	send_cancelled(std::move(cancelled));
+}
+
+void Chunker::send_cancelled(std::vector<vmath::ivec2>&& cancelled)
+{
+	chunk_gen_stats().messages++;
+	auto ret = bus.send(Message(msg::CHUNK_GEN_CANCELLED, std::make_unique<std::vector<vmath::ivec2>>(std::move(cancelled))));
+	assert(ret);
 }
@@ -1,62 +1,80 @@
 #pragma once
 
+#include "indexed_heap.h"
+#include "jobs.h"
 #include "messaging.h"
 #include "world_utils.h"
 
 #include "vmath.h"
-#include "zmq.hpp"
 
+#include <chrono>
 #include <memory>
-#include <queue>
-#include <unordered_set>
 #include <vector>
 
-void ChunkGenThread2(std::shared_ptr<zmq::context_t> ctx, msg::on_ready_fn on_ready);
+void ChunkGenThread2(msg::on_ready_fn on_ready);
 
-struct chunker_pq_entry
+// generated chunks are sent back in batches, so the world handles fewer messages
+// a batch is sent once it's full, once its oldest chunk has waited long enough, or once the queue's empty
+struct ChunkBatchOptions
 {
-	chunker_pq_entry(int priority_, const vmath::ivec2& coords_) : priority(priority_), coords(coords_)
-	{
-	}
-
-	friend bool operator<(const chunker_pq_entry& lhs, const chunker_pq_entry& rhs)
-	{
-		return lhs.priority < rhs.priority;
-	}
-
-	friend bool operator>(const chunker_pq_entry& lhs, const chunker_pq_entry& rhs)
-	{
-		return lhs.priority > rhs.priority;
-	}
-
-	int priority;
-	vmath::ivec2 coords;
+	size_t max_chunks = 8;
+	std::chrono::microseconds max_latency = std::chrono::milliseconds(8);
+};
+
+// a chunk one of our jobs finished generating (the job sends it back to us, see Chunker::start_queued_requests)
+struct chunk_gen_job_result
+{
+	std::unique_ptr<Chunk> chunk;
+	msg::clock::time_point requested;
 };
 
 class Chunker
 {
 public:
-	Chunker(std::shared_ptr<zmq::context_t> ctx_);
+	Chunker(const ChunkBatchOptions& batch_options_ = ChunkBatchOptions{});
 	~Chunker() = default;
 
 	void run(msg::on_ready_fn on_ready);
 
 private:
-	bool read_msg(bool wait, std::vector<zmq::message_t>& msg);
+	bool read_msg(bool wait, Message& msg);
 	void handle_all_messages(bool wait_for_first, bool& stop);
-	void on_msg(const std::vector<zmq::message_t>& msg, bool& stop);
-	bool handle_queued_request();
-	void on_chunk_gen_request(std::shared_ptr<ChunkGenRequest> req);
-	void update_player_coords(const vmath::ivec2& new_cords);
+	void on_msg(Message& msg, bool& stop);
+	void start_queued_requests();
+	void on_chunk_gen_job_done(std::unique_ptr<chunk_gen_job_result> result);
+	void wait_for_jobs();
+	void on_chunk_gen_request(const ChunkGenRequest& req, const msg::clock::time_point requested);
+	void send_batch();
+	void update_view(const PlayerView& new_view);
+	void update_render_distance(const int new_render_distance);
+	int priority_of(const vmath::ivec2& coords) const;
+	int distance_to_player(const vmath::ivec2& coords) const;
+	bool should_cancel(const vmath::ivec2& coords) const;
+	void cancel_far_requests();
+	void send_cancelled(std::vector<vmath::ivec2>&& cancelled);
 
 private:
-	std::shared_ptr<zmq::context_t> ctx;
 	BusNode bus;
 
-	// Player's last-known coords (so we always generate meshes closest to here)
-	vmath::ivec2 player_coords;
+	// generated chunks we haven't sent yet, and when the first one was added
+	const ChunkBatchOptions batch_options;
+	std::unique_ptr<ChunkGenResponse> batch;
+	std::chrono::high_resolution_clock::time_point batch_start;
+
+	// when each chunk in the batch was requested (for bus stats)
+	std::vector<msg::clock::time_point> batch_requested;
+
+	// Player's last-known position, look direction and velocity (so we always generate what they'll see soonest first)
+	PlayerView view;
+
+	// Player's last-known render distance (-1 = unknown, never cancel requests)
+	int render_distance = -1;
+
+	// Keep queue of incoming requests (closest to player first), and when each one was requested
+	indexed_heap<vmath::ivec2, msg::clock::time_point, int, vecN_hash> queue;
 
-	// Keep queue of incoming requests (based on distance to player)
-	std::priority_queue<chunker_pq_entry, std::vector<chunker_pq_entry>, std::greater<chunker_pq_entry>> pq;
-	std::unordered_set<vmath::ivec2, vecN_hash> reqs;
+	// jobs we've started that haven't sent their chunk back yet
+	// (the count goes down when we get the chunk, the handles are only for waiting on them when we stop, and get cleared out as we go)
+	size_t jobs_in_flight = 0;
+	std::vector<JobHandle> job_handles;
 };
@@ -0,0 +1,127 @@
+#include "epoch.h"
+
+#include <cassert>
+#include <utility>
+
+
+/* EpochDomain::Pin */
+
+
+EpochDomain::Pin::Pin(EpochDomain* domain_, const uint64_t epoch_) : domain(domain_), epoch_(epoch_)
+{
+}
+
+EpochDomain::Pin::Pin(Pin&& other) noexcept : domain(std::exchange(other.domain, nullptr)), epoch_(other.epoch_)
+{
+}
+
+EpochDomain::Pin& EpochDomain::Pin::operator=(Pin&& other) noexcept
+{
+	if (this != &other)
+	{
+		reset();
+		domain = std::exchange(other.domain, nullptr);
+		epoch_ = other.epoch_;
+	}
+	return *this;
+}
+
+EpochDomain::Pin::~Pin()
+{
+	reset();
+}
+
+void EpochDomain::Pin::reset()
+{
+	if (domain != nullptr)
+	{
+		domain->release(epoch_);
+		domain = nullptr;
+	}
+}
+
+uint64_t EpochDomain::Pin::epoch() const
+{
+	return epoch_;
+}
+
+
+/* EpochDomain */
+
+
+EpochDomain::~EpochDomain()
+{
+	for (auto& entry : retired)
+	{
+		entry.deleter(entry.ptr);
+	}
+}
+
+uint64_t EpochDomain::current() const
+{
+	return epoch;
+}
+
+EpochDomain::Pin EpochDomain::pin()
+{
+	pins[epoch % WINDOW].fetch_add(1, std::memory_order_relaxed);
+	return Pin(this, epoch);
+}
+
+bool EpochDomain::maybe_pinned(const uint64_t pinned_epoch) const
+{
+	return pinned_epoch != 0 && pinned_epoch >= oldest_pinned.load(std::memory_order_relaxed);
+}
+
+void EpochDomain::retire(void* ptr, void (*deleter)(void*))
+{
+	assert(ptr != nullptr);
+	std::lock_guard lock(retired_mutex);
+	retired.push_back({ epoch, ptr, deleter });
+}
+
+size_t EpochDomain::advance()
+{
+	// find the oldest epoch that still has pins (acquire => readers are done reading whatever they released)
+	const uint64_t first = epoch >= WINDOW ? epoch - WINDOW + 1 : 1;
+	uint64_t oldest = epoch + 1;
+	for (uint64_t e = first; e <= epoch; e++)
+	{
+		if (pins[e % WINDOW].load(std::memory_order_acquire) != 0)
+		{
+			oldest = e;
+			break;
+		}
+	}
+	oldest_pinned.store(oldest, std::memory_order_relaxed);
+
+	// free everything retired before then
+	std::lock_guard lock(retired_mutex);
+	size_t freed = 0;
+	while (freed < retired.size() && retired[freed].epoch < oldest)
+	{
+		retired[freed].deleter(retired[freed].ptr);
+		freed++;
+	}
+	retired.erase(retired.begin(), retired.begin() + freed);
+
+	// the next epoch reuses the pin counter of the one a window back, so only move on once that one's released
+	if (epoch + 1 < WINDOW || oldest > epoch + 1 - WINDOW)
+	{
+		epoch++;
+	}
+
+	return freed;
+}
+
+size_t EpochDomain::num_retired() const
+{
+	std::lock_guard lock(retired_mutex);
+	return retired.size();
+}
+
+void EpochDomain::release(const uint64_t pinned_epoch)
+{
+	const uint64_t prev = pins[pinned_epoch % WINDOW].fetch_sub(1, std::memory_order_release);
+	assert(prev > 0);
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// epoch-based reclamation, for data that one writer thread shares with readers on other threads without refcounting every pointer
+//
+// the writer never changes a version a reader might be looking at: it writes to a copy, swaps the copy in, and retires the old version
+// a reader pins the current epoch before it's handed raw pointers, and releases the pin once it's done with them
+// a retired version is freed once every pin that could have seen it (i.e. from its epoch or earlier) has been released
+//
+// everything but releasing a pin is for the writer thread only (or, for retire, jobs that it's waiting on)
+class EpochDomain
+{
+public:
+	// how many epochs a pin can fall behind before the writer stops advancing (retired versions just pile up in the current epoch until it's released)
+	static constexpr size_t WINDOW = 256;
+
+	// a reader's claim on an epoch (released when destroyed, on whatever thread that is)
+	class Pin
+	{
+	public:
+		Pin() = default;
+		Pin(Pin&& other) noexcept;
+		Pin& operator=(Pin&& other) noexcept;
+		~Pin();
+
+		Pin(const Pin&) = delete;
+		Pin& operator=(const Pin&) = delete;
+
+		void reset();
+
+		uint64_t epoch() const;
+
+	private:
+		friend class EpochDomain;
+		Pin(EpochDomain* domain_, const uint64_t epoch_);
+
+		EpochDomain* domain = nullptr;
+		uint64_t epoch_ = 0;
+	};
+
+	EpochDomain() = default;
+
+	// frees everything that's still retired (nobody can be reading by now)
+	~EpochDomain();
+
+	EpochDomain(const EpochDomain&) = delete;
+	EpochDomain& operator=(const EpochDomain&) = delete;
+
+	uint64_t current() const;
+
+	Pin pin();
+
+	// could a reader still be looking at a version that was last pinned in *epoch*? (0 = never pinned)
+	// conservative: it's as of the last advance, and pins are only ever released in between
+	bool maybe_pinned(const uint64_t epoch) const;
+
+	// free *ptr* once no reader can be looking at it
+	template<class T>
+	void retire(T* ptr)
+	{
+		retire(ptr, [](void* p) { delete static_cast<T*>(p); });
+	}
+
+	void retire(void* ptr, void (*deleter)(void*));
+
+	// free whatever no reader can be looking at anymore, then move on to the next epoch (unless the oldest pin is a whole window behind)
+	// returns how many versions were freed
+	size_t advance();
+
+	// versions waiting to be freed (for debug info)
+	size_t num_retired() const;
+
+private:
+	struct retired_entry
+	{
+		uint64_t epoch;
+		void* ptr;
+		void (*deleter)(void*);
+	};
+
+	void release(const uint64_t epoch);
+
+	// pins held in each epoch of the window, indexed by epoch % WINDOW
+	std::array<std::atomic_uint64_t, WINDOW> pins{};
+
+	uint64_t epoch = 1;
+
+	// as of the last advance, every pin from before this epoch has been released
+	std::atomic_uint64_t oldest_pinned = 1;
+
+	// oldest first
+	// (guarded by retired_mutex, since jobs can retire versions while the writer waits on them)
+	std::vector<retired_entry> retired;
+	mutable std::mutex retired_mutex;
+};
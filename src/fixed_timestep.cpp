@@ -0,0 +1,34 @@
+#include "fixed_timestep.h"
+
+#include <algorithm>
+
+FixedTimestep::FixedTimestep(const clock::duration step_, const int max_catch_up_, const clock::time_point start) : step(step_), max_catch_up(max_catch_up_), next_step(start)
+{
+}
+
+int FixedTimestep::due(const clock::time_point now)
+{
+	if (now < next_step)
+	{
+		return 0;
+	}
+
+	// every step due by now, of which we run as many as we're allowed, and skip the rest
+	const int64_t behind = (now - next_step) / step + 1;
+	const int steps = static_cast<int>(std::min<int64_t>(behind, max_catch_up));
+	next_step += behind * step;
+
+	num_steps += steps;
+	num_skipped += behind - steps;
+	return steps;
+}
+
+FixedTimestep::clock::time_point FixedTimestep::next_step_time() const
+{
+	return next_step;
+}
+
+void FixedTimestep::reset(const clock::time_point now)
+{
+	next_step = now;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+// when to run something that should happen a fixed number of times per second (e.g. world ticks), however long each run takes
+//
+// steps are due every *step* from when we started, so one that runs late doesn't push back the ones after it
+// if we fall behind, the steps we missed run back to back to catch up, but at most *max_catch_up* at a time, and anything past that is skipped
+// (so a world that can't keep up slows down, instead of spending longer and longer catching up)
+class FixedTimestep
+{
+public:
+	using clock = std::chrono::steady_clock;
+
+	FixedTimestep(const clock::duration step_, const int max_catch_up_, const clock::time_point start);
+
+	// how many steps to run now (counted as run, so call it once per batch)
+	int due(const clock::time_point now);
+
+	// when the next step's due
+	clock::time_point next_step_time() const;
+
+	// start over from *now*, forgetting any steps we missed (e.g. after being paused)
+	void reset(const clock::time_point now);
+
+	const clock::duration step;
+	const int max_catch_up;
+
+	uint64_t num_steps = 0;
+	uint64_t num_skipped = 0;
+
+private:
+	clock::time_point next_step;
+};
+
+// the latest copy of something that one thread keeps updating (e.g. the world's state after each tick), for other threads to read
+//
+// double-buffered: the writer fills in the back copy without a lock, and only takes the lock to swap it to the front
+// so a reader's copy is always from one whole update, and readers never wait while the writer's filling one in
+template<typename T>
+class SnapshotBuffer
+{
+public:
+	// the copy to fill in for the next publish (writer only, and it's whatever was published two publishes ago)
+	T& back()
+	{
+		return buffers[1 - front];
+	}
+
+	// make the back copy the one readers get (writer only)
+	void publish()
+	{
+		std::lock_guard lock(mutex);
+		front = 1 - front;
+	}
+
+	// the last published copy (any thread)
+	T read() const
+	{
+		std::lock_guard lock(mutex);
+		return buffers[front];
+	}
+
+private:
+	mutable std::mutex mutex;
+	std::array<T, 2> buffers{};
+	int front = 0;
+};
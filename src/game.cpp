@@ -1,7 +1,10 @@
 #include "game.h"
 
+#include "bus_stats.h"
 #include "chunk.h"
 #include "chunkdata.h"
+#include "jobs.h"
+#include "mesh_cache.h"
 #include "messaging.h"
 #include "render.h"
 #include "shapes.h"
@@ -14,7 +17,6 @@
 #include "examples/imgui_impl_opengl3.h"
 #include "examples/imgui_impl_glfw.h"
 #include "imgui.h"
-#include "zmq_addon.hpp"
 
 #include <algorithm>
 #include <cassert>
@@ -28,21 +30,22 @@
 using namespace std;
 using namespace vmath;
 
-Game::Game(std::shared_ptr<zmq::context_t> ctx_, std::shared_ptr<GLFWwindow> window_, std::shared_ptr<GlfwInfo> windowInfo_, std::shared_ptr<OpenGLInfo> glInfo_)
-	: ctx(ctx_), bus(ctx_), window(window_), windowInfo(windowInfo_), glInfo(glInfo_)
+Game::Game(std::shared_ptr<GLFWwindow> window_, std::shared_ptr<GlfwInfo> windowInfo_, std::shared_ptr<OpenGLInfo> glInfo_)
+	: window(window_), windowInfo(windowInfo_), glInfo(glInfo_)
 {
 	std::fill(held_keys.begin(), held_keys.end(), false);
-	bus.out.setsockopt(ZMQ_SUBSCRIBE, "", 0);
 }
 
 Game::~Game()
 {
-	// Send exit message
-	std::vector<zmq::const_buffer> message({
-		zmq::buffer(msg::EXIT)
-		});
+	// Stop the world first, so it isn't ticking while everything else exits
+	if (world)
+	{
+		world->stop();
+	}
 
-	auto ret = zmq::send_multipart(bus.in, message, zmq::send_flags::dontwait);
+	// Send exit message
+	auto ret = bus.send(Message(msg::EXIT));
 	assert(ret);
 }
 
@@ -52,26 +55,37 @@ void Game::startup()
 
 	// set vars
 	std::fill(held_keys.begin(), held_keys.end(), false);
-	world = std::make_unique<World>(ctx);
-	world_render = std::make_unique<WorldRenderPart>(ctx);
+	world = std::make_unique<World>();
+	world_render = std::make_unique<WorldRenderPart>();
 	glfwGetCursorPos(window.get(), &last_mouse_x, &last_mouse_y); // reset mouse position
 
+	// Start ticking
+	world->start();
+
 	running = true;
 }
 
 void Game::shutdown()
 {
 	running = false;
+	world->stop();
 }
 
 void Game::render_frame(bool& quit)
 {
 	float time = static_cast<float>(glfwGetTime());
+
+	// finish off any background jobs that need the main thread
+	job_system().run_main_thread_continuations();
+
+	// the world only ticks while we're in game
+	world->set_paused(state != GameState::InGame);
+
 	switch (state)
 	{
 	case GameState::InGame:
 		update_player_actions();
-		world->update_world(time);
+		update_snapshot();
 		render(time);
 		break;
 	case GameState::InEscMenu:
@@ -169,7 +183,7 @@ void Game::render(float time)
 
 	// Draw ALL our chunks!
 	world_render->handle_messages();
-	world_render->render(glInfo.get(), windowInfo.get(), planes, get_player().staring_at);
+	world_render->render(glInfo.get(), windowInfo.get(), planes, get_player().staring_at, get_player().coords);
 
 	// get polygon mode
 	GLint polygon_mode;
@@ -231,6 +245,49 @@ void Game::render_debug_info(float dt)
 	sprintf(lineBuf, "Held block: %d (%s)\n", static_cast<int>(get_player().held_block), get_player().held_block.side_texture().c_str());
 	debugInfo += lineBuf;
 
+	sprintf(lineBuf, "World tick %d: %.1f ms (slowest %.1f ms), %llu skipped\n", snapshot.tick, snapshot.update_ms, snapshot.slowest_update_ms, (unsigned long long)snapshot.num_skipped_ticks);
+	debugInfo += lineBuf;
+
+	sprintf(lineBuf, "Mesh requests: %.1f per chunk (%llu/%llu), %zu chunks waiting\n", snapshot.num_chunks_loaded == 0 ? 0.0f : static_cast<float>(snapshot.num_mesh_requests) / snapshot.num_chunks_loaded, (unsigned long long)snapshot.num_mesh_requests, (unsigned long long)snapshot.num_chunks_loaded, snapshot.num_deferred_meshes);
+	debugInfo += lineBuf;
+
+	sprintf(lineBuf, "Liquids: %zu active cells in %zu chunks, %zu updated last tick (budget %zu), %llu steps\n", snapshot.num_active_liquid, snapshot.num_liquid_chunks, snapshot.liquid_stats.last_update_work, snapshot.liquid_budget, (unsigned long long)snapshot.liquid_stats.steps);
+	debugInfo += lineBuf;
+
+	sprintf(lineBuf, "Block changes: %zu last tick, remeshing %zu minis\n", snapshot.num_block_changes, snapshot.num_remeshes);
+	debugInfo += lineBuf;
+
+	const WorldRenderStats& render_stats = world_render->stats;
+	int total_quads = 0;
+	std::string minis_per_lod;
+	for (int lod = 0; lod < MESH_LOD_LEVELS; lod++) {
+		total_quads += render_stats.quads[lod];
+		minis_per_lod += (lod == 0 ? "" : "/") + std::to_string(render_stats.minis[lod]);
+	}
+	sprintf(lineBuf, "Quads: %d (%d drawn, face culling %s), LOD %s (minis per level: %s)\n", total_quads, render_stats.drawn_quads, world_render->face_culling_enabled ? "on" : "off", world_render->lod_enabled ? "on" : "off", minis_per_lod.c_str());
+	debugInfo += lineBuf;
+
+	const RequestQueueStats& chunk_stats = chunk_gen_stats();
+	sprintf(lineBuf, "Chunk queue: %llu queued, %llu done, %llu cancelled, %llu wasted, %llu messages, %llu/%zu in flight, %llu held back\n", (unsigned long long)chunk_stats.queued, (unsigned long long)chunk_stats.completed, (unsigned long long)chunk_stats.cancelled, (unsigned long long)chunk_stats.wasted, (unsigned long long)chunk_stats.messages, (unsigned long long)chunk_stats.in_flight, CHUNK_GEN_CAPACITY, (unsigned long long)chunk_stats.held_back);
+	debugInfo += lineBuf;
+
+	const RequestQueueStats& mesh_stats = mesh_gen_stats();
+	sprintf(lineBuf, "Mesh queue: %llu queued, %llu done, %llu cancelled, %llu wasted, %llu messages, %llu/%zu in flight, %llu held back\n", (unsigned long long)mesh_stats.queued, (unsigned long long)mesh_stats.completed, (unsigned long long)mesh_stats.cancelled, (unsigned long long)mesh_stats.wasted, (unsigned long long)mesh_stats.messages, (unsigned long long)mesh_stats.in_flight, MESH_GEN_CAPACITY, (unsigned long long)mesh_stats.held_back);
+	debugInfo += lineBuf;
+
+	const MeshCacheStats& cache_stats = mesh_cache_stats();
+	sprintf(lineBuf, "Mesh cache: %.1f%% hits (%llu/%llu), saved %lld ms\n", cache_stats.hit_rate() * 100.0f, (unsigned long long)cache_stats.hits, (unsigned long long)(cache_stats.hits + cache_stats.misses), (long long)(cache_stats.net_saved_ns() / 1000000));
+	debugInfo += lineBuf;
+
+	const JobStats& jobs = job_stats();
+	sprintf(lineBuf, "Jobs: %zu workers, %llu ready, %llu blocked, %llu running, %llu done\n", job_system().num_workers(), (unsigned long long)jobs.ready, (unsigned long long)jobs.blocked, (unsigned long long)jobs.running, (unsigned long long)jobs.completed);
+	debugInfo += lineBuf;
+
+	if (show_bus_stats)
+	{
+		debugInfo += "Bus:\n" + bus_stats().summary();
+	}
+
 	// Show debug info
 	const float DISTANCE = 10.0f;
 	static int corner = 0;
@@ -251,18 +308,40 @@ void Game::render_debug_info(float dt)
 
 void Game::update_player_actions()
 {
-	get_player().actions.forwards = held_keys[GLFW_KEY_W];
-	get_player().actions.backwards = held_keys[GLFW_KEY_S];
-	get_player().actions.left = held_keys[GLFW_KEY_A];
-	get_player().actions.right = held_keys[GLFW_KEY_D];
-	get_player().actions.jumping = held_keys[GLFW_KEY_SPACE];
-	get_player().actions.shifting = held_keys[GLFW_KEY_LEFT_SHIFT];
+	input.actions.forwards = held_keys[GLFW_KEY_W];
+	input.actions.backwards = held_keys[GLFW_KEY_S];
+	input.actions.left = held_keys[GLFW_KEY_A];
+	input.actions.right = held_keys[GLFW_KEY_D];
+	input.actions.jumping = held_keys[GLFW_KEY_SPACE];
+	input.actions.shifting = held_keys[GLFW_KEY_LEFT_SHIFT];
 	// TODO: Mining
+
+	send_input();
+}
+
+void Game::send_input()
+{
+	// (if the world's inbox is full, we'll try again next frame)
+	if (input != last_sent_input && bus.send(Message(msg::PLAYER_INPUT, input)))
+	{
+		last_sent_input = input;
+	}
+}
+
+void Game::update_snapshot()
+{
+	snapshot = world->get_snapshot();
+
+	// the world's player, where it was part way between the last two ticks (so it moves smoothly however far apart ticks are), looking where the mouse says right now
+	player = snapshot.player;
+	player.coords = snapshot.interpolated_coords(FixedTimestep::clock::now());
+	player.pitch = input.pitch;
+	player.yaw = input.yaw;
 }
 
 Player& Game::get_player()
 {
-	return world->player;
+	return player;
 }
 
 void Game::onKey(GLFWwindow* window, int key, int scancode, int action, int mods)
@@ -278,7 +357,7 @@ void Game::onKey(GLFWwindow* window, int key, int scancode, int action, int mods
 
 		// N = toggle noclip
 		if (key == GLFW_KEY_N) {
-			get_player().noclip = !get_player().noclip;
+			input.noclip = !input.noclip;
 		}
 
 		// P = cycle poylgon mode
@@ -314,6 +393,22 @@ void Game::onKey(GLFWwindow* window, int key, int scancode, int action, int mods
 			show_debug_info = !show_debug_info;
 		}
 
+		// F4 = toggle message bus stats in debug info
+		if (key == GLFW_KEY_F4) {
+			show_bus_stats = !show_bus_stats;
+		}
+
+		// F5 = dump message bus stats (with full latency histograms) to bus_stats.json
+		// (written by a job, so the frame doesn't wait on the disk)
+		if (key == GLFW_KEY_F5) {
+			auto ok = std::make_shared<bool>(false);
+			job_system().submit([ok]() { *ok = bus_stats().dump("bus_stats.json"); }, 0, {}, [ok]() {
+				if (!*ok) {
+					OutputDebugString("Failed to write bus_stats.json\n");
+				}
+			});
+		}
+
 		// [F11 | ALT+ENTER] = toggle fullscreen
 		if (key == GLFW_KEY_F11 || (mods == GLFW_MOD_ALT && key == GLFW_KEY_ENTER)) {
 			// if fullscreen
@@ -343,6 +438,16 @@ void Game::onKey(GLFWwindow* window, int key, int scancode, int action, int mods
 			}
 		}
 
+		// L = toggle levels of detail
+		if (key == GLFW_KEY_L) {
+			world_render->lod_enabled = !world_render->lod_enabled;
+		}
+
+		// B = toggle skipping faces that point away from the camera
+		if (key == GLFW_KEY_B) {
+			world_render->face_culling_enabled = !world_render->face_culling_enabled;
+		}
+
 		// T = toggle t-junction fixing
 		if (key == GLFW_KEY_T) {
 			should_fix_tjunctions = !should_fix_tjunctions;
@@ -392,14 +497,13 @@ void Game::onKey(GLFWwindow* window, int key, int scancode, int action, int mods
 	if (action == GLFW_PRESS || action == GLFW_REPEAT) {
 		// + = increase render distance
 		if (key == GLFW_KEY_KP_ADD || key == GLFW_KEY_EQUAL) {
-			get_player().render_distance++;
-			get_player().should_check_for_nearby_chunks = true;
+			input.render_distance++;
 		}
 
 		// - = decrease render distance
 		if (key == GLFW_KEY_KP_SUBTRACT || key == GLFW_KEY_MINUS) {
-			if (get_player().render_distance > 0) {
-				get_player().render_distance--;
+			if (input.render_distance > 0) {
+				input.render_distance--;
 			}
 		}
 	}
@@ -421,14 +525,14 @@ void Game::onMouseMove(GLFWwindow* window, double x, double y)
 		double delta_y = y - last_mouse_y;
 
 		// update pitch/yaw
-		get_player().yaw += static_cast<float>(windowInfo->mouseX_Sensitivity * delta_x);
-		get_player().pitch += static_cast<float>(windowInfo->mouseY_Sensitivity * delta_y);
+		input.yaw += static_cast<float>(windowInfo->mouseX_Sensitivity * delta_x);
+		input.pitch += static_cast<float>(windowInfo->mouseY_Sensitivity * delta_y);
 		
 		// wrap yaw
-		get_player().yaw = posmod(get_player().yaw, 360.0f);
+		input.yaw = posmod(input.yaw, 360.0f);
 
 		// cap pitch
-		get_player().pitch = clamp(get_player().pitch, -90.0f, 90.0f);
+		input.pitch = clamp(input.pitch, -90.0f, 90.0f);
 
 		// update old values
 		last_mouse_x = x;
@@ -443,32 +547,17 @@ void Game::onResize(GLFWwindow* window, int width, int height)
 void Game::onMouseButton(int button, int action) {
 	if (capture_mouse)
 	{
+		// (the world works out what we're staring at, so make sure it knows where we're looking first)
+		send_input();
+
 		// left click
 		if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS) {
-			// if staring at valid block
-			if (get_player().staring_at[1] >= 0) {
-				world->data.destroy_block(get_player().staring_at);
-			}
+			bus.send(Message(msg::PLAYER_BREAK_BLOCK));
 		}
 
 		// right click
 		if (button == GLFW_MOUSE_BUTTON_RIGHT && action == GLFW_PRESS) {
-			// if staring at valid block
-			if (get_player().staring_at[1] >= 0) {
-				// position we wanna place block at
-				ivec3 desired_position = get_player().staring_at + get_player().staring_at_face;
-
-				// check if we're in the way
-				vector<ivec4> intersecting_blocks = get_player_intersecting_blocks(get_player().coords);
-				auto result = find_if(begin(intersecting_blocks), end(intersecting_blocks), [desired_position](const auto& ipos) {
-					return desired_position == ivec3(ipos[0], ipos[1], ipos[2]);
-					});
-
-				// if we're not in the way, place it
-				if (result == end(intersecting_blocks)) {
-					world->data.add_block(desired_position, get_player().held_block);
-				}
-			}
+			bus.send(Message(msg::PLAYER_PLACE_BLOCK));
 		}
 	}
 }
@@ -482,6 +571,6 @@ void Game::onMouseWheel(double scroll_direction) {
 
 		// increment/decrement block type
 		int scroll_offset = scroll_direction > 0 ? 1 : -1;
-		get_player().held_block = BlockType(static_cast<int>(get_player().held_block) + scroll_offset);
+		input.held_block = BlockType(static_cast<int>(input.held_block) + scroll_offset);
 	}
 }
@@ -13,7 +13,6 @@
 #include "GL/gl3w.h"
 #include "GLFW/glfw3.h"
 #include "vmath.h"
-#include "zmq.hpp"
 
 #include <cassert>
 #include <memory>
@@ -24,15 +23,13 @@
 
 constexpr int NUM_MESH_GEN_THREADS = 1;
 
-void run_game(std::shared_ptr<zmq::context_t> ctx);
+void run_game();
 
 class Game {
 public:
-	// zmq
-	std::shared_ptr<zmq::context_t> ctx;
 	BusNode bus;
 
-	Game(std::shared_ptr<zmq::context_t> ctx_, std::shared_ptr<GLFWwindow> window_, std::shared_ptr<GlfwInfo> windowInfo_, std::shared_ptr<OpenGLInfo> glInfo_);
+	Game(std::shared_ptr<GLFWwindow> window_, std::shared_ptr<GlfwInfo> windowInfo_, std::shared_ptr<OpenGLInfo> glInfo_);
 	~Game();
 
 	/* INPUTS */
@@ -44,6 +41,10 @@ public:
 	// key inputs
 	std::array<bool, GLFW_KEY_LAST + 1> held_keys;
 
+	// what the player's asking for (sent to the world whenever it changes)
+	PlayerInput input;
+	PlayerInput last_sent_input;
+
 	// redirected GLFW/GL callbacks
 	void onKey(GLFWwindow* window, int key, int scancode, int action, int mods);
 	void onMouseMove(GLFWwindow* window, double x, double y);
@@ -68,6 +69,7 @@ public:
 	void render_esc_menu(bool& quit);
 
 	bool show_debug_info = false;
+	bool show_bus_stats = false;
 	bool should_fix_tjunctions = true;
 	double fps = 0;
 	bool capture_mouse = true;
@@ -86,8 +88,14 @@ public:
 	// misc
 	std::unique_ptr<World> world;
 
+	// the world as of its last tick, and the player as the renderer sees it (in between the last two ticks, looking wherever the mouse says)
+	WorldSnapshot snapshot;
+	Player player;
+
 	// funcs
 	void update_player_actions();
+	void send_input();
+	void update_snapshot();
 	Player& get_player();
 
 	/* GAME STATE PART */
@@ -98,9 +106,6 @@ public:
 	void shutdown();
 
 	inline void set_min_render_distance(int min_render_distance) {
-		if (min_render_distance > world->player.render_distance) {
-			world->player.should_check_for_nearby_chunks = true;
-		}
-		world->player.render_distance = min_render_distance;
+		input.render_distance = min_render_distance;
 	}
 };
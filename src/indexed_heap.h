@@ -0,0 +1,301 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// min-heap of unique keys, each with a priority and a value
+// keys can be looked up in O(1), and reprioritized or erased in O(log n), instead of rebuilding the whole heap
+//
+// keys and values live in slots that never move, and the heap itself is just (priority, slot) pairs
+// (so sifting doesn't touch the hash map, and comparisons don't have to chase pointers)
+template<
+	class Key,
+	class T,
+	class Priority = int,
+	class Hash = std::hash<Key>,
+	class KeyEqual = std::equal_to<Key>
+>
+class indexed_heap
+{
+public:
+	using size_type = size_t;
+
+	size_type size() const
+	{
+		return heap.size();
+	}
+
+	bool empty() const
+	{
+		return heap.empty();
+	}
+
+	bool contains(const Key& key) const
+	{
+		return index.contains(key);
+	}
+
+	// nullptr if not queued
+	T* find(const Key& key)
+	{
+		auto search = index.find(key);
+		return search == index.end() ? nullptr : &slots[search->second].value;
+	}
+
+	// returns false (and changes nothing) if key's already queued
+	bool insert(const Key& key, const Priority priority, T value)
+	{
+		auto [it, inserted] = index.try_emplace(key, 0);
+		if (!inserted)
+		{
+			return false;
+		}
+
+		uint32_t slot;
+		if (!free_slots.empty())
+		{
+			slot = free_slots.back();
+			free_slots.pop_back();
+			slots[slot].key = key;
+			slots[slot].value = std::move(value);
+		}
+		else
+		{
+			slot = static_cast<uint32_t>(slots.size());
+			slots.push_back({ key, std::move(value), 0 });
+		}
+		it->second = slot;
+
+		heap.push_back({ priority, slot });
+		slots[slot].pos = heap.size() - 1;
+		sift_up(heap.size() - 1);
+		return true;
+	}
+
+	// key must be queued
+	void update(const Key& key, const Priority priority)
+	{
+		auto search = index.find(key);
+		assert(search != index.end());
+		const size_t pos = slots[search->second].pos;
+		const Priority old_priority = heap[pos].priority;
+		heap[pos].priority = priority;
+		if (priority < old_priority)
+		{
+			sift_up(pos);
+		}
+		else
+		{
+			sift_down(pos);
+		}
+	}
+
+	// returns false if key wasn't queued
+	bool erase(const Key& key)
+	{
+		auto search = index.find(key);
+		if (search == index.end())
+		{
+			return false;
+		}
+
+		const uint32_t slot = search->second;
+		index.erase(search);
+		remove_at(slots[slot].pos);
+		return true;
+	}
+
+	// lowest priority key
+	const Key& top_key() const
+	{
+		assert(!empty());
+		return slots[heap.front().slot].key;
+	}
+
+	Priority top_priority() const
+	{
+		assert(!empty());
+		return heap.front().priority;
+	}
+
+	T& top_value()
+	{
+		assert(!empty());
+		return slots[heap.front().slot].value;
+	}
+
+	void pop()
+	{
+		assert(!empty());
+		index.erase(slots[heap.front().slot].key);
+		remove_at(0);
+	}
+
+	// recompute every priority (priority_of(key) => priority), then fix the heap once
+	// O(n), vs O(n log n) for updating them one at a time
+	template<class PriorityOf>
+	void reprioritize(PriorityOf&& priority_of)
+	{
+		for (auto& entry : heap)
+		{
+			entry.priority = priority_of(slots[entry.slot].key);
+		}
+		rebuild();
+	}
+
+	// erase everything that should_remove(key, priority) says to, in one pass
+	// returns how many were erased
+	template<class Pred>
+	size_type erase_if(Pred&& should_remove)
+	{
+		size_t kept = 0;
+		for (size_t i = 0; i < heap.size(); i++)
+		{
+			slot_t& slot = slots[heap[i].slot];
+			if (should_remove(std::as_const(slot.key), heap[i].priority))
+			{
+				index.erase(slot.key);
+				release(heap[i].slot);
+			}
+			else
+			{
+				heap[kept++] = heap[i];
+			}
+		}
+
+		const size_type erased = heap.size() - kept;
+		if (erased > 0)
+		{
+			heap.resize(kept);
+			rebuild();
+		}
+		return erased;
+	}
+
+	void clear()
+	{
+		heap.clear();
+		slots.clear();
+		free_slots.clear();
+		index.clear();
+	}
+
+private:
+	struct heap_entry
+	{
+		Priority priority;
+		uint32_t slot;
+	};
+
+	struct slot_t
+	{
+		Key key;
+		T value;
+
+		// where this slot is in the heap
+		size_t pos;
+	};
+
+	// remove the heap entry at pos (its key must already be gone from the index)
+	void remove_at(const size_t pos)
+	{
+		release(heap[pos].slot);
+
+		// fill the hole with the last entry, then move that entry wherever it belongs
+		const size_t last = heap.size() - 1;
+		if (pos != last)
+		{
+			place(pos, heap[last]);
+		}
+		heap.pop_back();
+
+		if (pos < heap.size())
+		{
+			sift_down(sift_up(pos));
+		}
+	}
+
+	// free a slot for reuse (resetting its value, so e.g. shared_ptrs don't outlive the entry)
+	void release(const uint32_t slot)
+	{
+		slots[slot].value = T();
+		free_slots.push_back(slot);
+	}
+
+	void place(const size_t pos, const heap_entry& entry)
+	{
+		heap[pos] = entry;
+		slots[entry.slot].pos = pos;
+	}
+
+	// returns entry's new position
+	size_t sift_up(size_t pos)
+	{
+		const heap_entry entry = heap[pos];
+		while (pos > 0)
+		{
+			const size_t parent = (pos - 1) / 2;
+			if (!(entry.priority < heap[parent].priority))
+			{
+				break;
+			}
+			place(pos, heap[parent]);
+			pos = parent;
+		}
+		place(pos, entry);
+		return pos;
+	}
+
+	void sift_down(size_t pos)
+	{
+		const heap_entry entry = heap[pos];
+		while (true)
+		{
+			const size_t child = smallest_child(pos);
+			if (child == pos || !(heap[child].priority < entry.priority))
+			{
+				break;
+			}
+			place(pos, heap[child]);
+			pos = child;
+		}
+		place(pos, entry);
+	}
+
+	// pos's child with the lowest priority (or pos if it has no children)
+	size_t smallest_child(const size_t pos) const
+	{
+		const size_t left = 2 * pos + 1;
+		const size_t right = left + 1;
+		if (left >= heap.size())
+		{
+			return pos;
+		}
+		return right < heap.size() && heap[right].priority < heap[left].priority ? right : left;
+	}
+
+	// make the whole vector a heap again (bottom-up)
+	void rebuild()
+	{
+		for (size_t i = heap.size() / 2; i-- > 0;)
+		{
+			sift_down(i);
+		}
+		for (size_t i = 0; i < heap.size(); i++)
+		{
+			slots[heap[i].slot].pos = i;
+		}
+	}
+
+	std::vector<heap_entry> heap;
+	std::vector<slot_t> slots;
+	std::vector<uint32_t> free_slots;
+
+	// key => slot
+	std::unordered_map<Key, uint32_t, Hash, KeyEqual> index;
+};
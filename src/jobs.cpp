@@ -0,0 +1,242 @@
+#include "jobs.h"
+
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+
+
+struct Job
+{
+	std::function<void()> fn;
+	std::function<void()> on_main_thread;
+	int priority = 0;
+
+	// dependencies that aren't done yet (plus one while it's being submitted)
+	std::atomic_int remaining = 1;
+
+	// guards done and dependents (so a dependent can't be added after we've finished)
+	std::mutex mutex;
+	std::atomic_bool done = false;
+	std::vector<JobHandle> dependents;
+};
+
+JobStats& job_stats()
+{
+	static JobStats stats;
+	return stats;
+}
+
+JobSystem::JobSystem(const size_t num_workers)
+{
+	assert(num_workers > 0);
+	workers.reserve(num_workers);
+	for (size_t i = 0; i < num_workers; i++)
+	{
+		workers.emplace_back(&JobSystem::worker_loop, this);
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	// (jobs that haven't started yet are dropped)
+	{
+		std::lock_guard lock(mutex);
+		stop = true;
+	}
+	cv.notify_all();
+
+	for (auto& worker : workers)
+	{
+		worker.join();
+	}
+}
+
+JobHandle JobSystem::submit(std::function<void()> fn, const int priority, std::span<const JobHandle> dependencies, std::function<void()> on_main_thread)
+{
+	auto job = std::make_shared<Job>();
+	job->fn = std::move(fn);
+	job->on_main_thread = std::move(on_main_thread);
+	job->priority = priority;
+
+	job_stats().blocked++;
+	for (const auto& dependency : dependencies)
+	{
+		assert(dependency);
+		std::lock_guard lock(dependency->mutex);
+		if (!dependency->done)
+		{
+			dependency->dependents.push_back(job);
+			job->remaining++;
+		}
+	}
+
+	// done submitting => if every dependency's already done, it can run now
+	if (--job->remaining == 0)
+	{
+		make_ready(job);
+	}
+
+	return job;
+}
+
+JobHandle JobSystem::when_all(std::span<const JobHandle> jobs, const int priority)
+{
+	return submit([]() {}, priority, jobs);
+}
+
+void JobSystem::wait(const JobHandle& job, const int max_priority)
+{
+	while (!is_done(job))
+	{
+		// help out instead of just sleeping
+		if (try_run_one(max_priority))
+		{
+			continue;
+		}
+
+		std::unique_lock lock(mutex);
+		waiters++;
+		cv.wait(lock, [&]() { return is_done(job) || (!ready.empty() && ready.top().priority <= max_priority) || stop; });
+		waiters--;
+		if (stop)
+		{
+			return;
+		}
+	}
+}
+
+bool JobSystem::is_done(const JobHandle& job)
+{
+	return job->done.load(std::memory_order_acquire);
+}
+
+size_t JobSystem::run_main_thread_continuations(const size_t max_count)
+{
+	std::vector<std::function<void()>> to_run;
+	{
+		std::lock_guard lock(main_thread_mutex);
+		const size_t count = std::min(max_count, main_thread_continuations.size());
+		to_run.assign(std::make_move_iterator(main_thread_continuations.begin()), std::make_move_iterator(main_thread_continuations.begin() + count));
+		main_thread_continuations.erase(main_thread_continuations.begin(), main_thread_continuations.begin() + count);
+	}
+
+	for (auto& continuation : to_run)
+	{
+		continuation();
+	}
+	job_stats().main_thread_queued -= to_run.size();
+
+	return to_run.size();
+}
+
+size_t JobSystem::num_workers() const
+{
+	return workers.size();
+}
+
+void JobSystem::worker_loop()
+{
+	while (true)
+	{
+		JobHandle job;
+		{
+			std::unique_lock lock(mutex);
+			cv.wait(lock, [&]() { return stop || !ready.empty(); });
+			if (stop)
+			{
+				return;
+			}
+
+			job = ready.top().job;
+			ready.pop();
+		}
+		job_stats().ready--;
+
+		run(job);
+	}
+}
+
+void JobSystem::make_ready(JobHandle job)
+{
+	JobStats& stats = job_stats();
+	stats.blocked--;
+	stats.ready++;
+
+	{
+		std::lock_guard lock(mutex);
+		ready.push({ job->priority, next_sequence++, std::move(job) });
+	}
+	cv.notify_one();
+}
+
+// run the highest priority ready job on this thread, if there is one (with a priority of *max_priority* or better)
+bool JobSystem::try_run_one(const int max_priority)
+{
+	JobHandle job;
+	{
+		std::lock_guard lock(mutex);
+		if (ready.empty() || ready.top().priority > max_priority)
+		{
+			return false;
+		}
+
+		job = ready.top().job;
+		ready.pop();
+	}
+	job_stats().ready--;
+
+	run(job);
+	return true;
+}
+
+void JobSystem::run(const JobHandle& job)
+{
+	JobStats& stats = job_stats();
+	stats.running++;
+
+	job->fn();
+	job->fn = nullptr;
+
+	// mark it done, and start anything that was only waiting on us
+	std::vector<JobHandle> dependents;
+	{
+		std::lock_guard lock(job->mutex);
+		job->done.store(true, std::memory_order_release);
+		dependents.swap(job->dependents);
+	}
+
+	if (job->on_main_thread)
+	{
+		std::lock_guard lock(main_thread_mutex);
+		main_thread_continuations.push_back(std::move(job->on_main_thread));
+		stats.main_thread_queued++;
+	}
+
+	stats.running--;
+	stats.completed++;
+
+	for (auto& dependent : dependents)
+	{
+		if (--dependent->remaining == 0)
+		{
+			make_ready(std::move(dependent));
+		}
+	}
+
+	// wake up anyone waiting on this job
+	bool has_waiters;
+	{
+		std::lock_guard lock(mutex);
+		has_waiters = waiters > 0;
+	}
+	if (has_waiters)
+	{
+		cv.notify_all();
+	}
+}
+
+JobSystem& job_system()
+{
+	static JobSystem system(std::max(2u, std::thread::hardware_concurrency()) - 1);
+	return system;
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <atomic>
+#include <climits>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <span>
+#include <thread>
+#include <vector>
+
+// a unit of work for the job system (see JobSystem::submit)
+struct Job;
+using JobHandle = std::shared_ptr<Job>;
+
+// job counters, shared by all threads (for debug info)
+struct JobStats
+{
+	// waiting for a worker (their dependencies are done)
+	std::atomic_uint64_t ready = 0;
+
+	// waiting for their dependencies
+	std::atomic_uint64_t blocked = 0;
+
+	std::atomic_uint64_t running = 0;
+	std::atomic_uint64_t completed = 0;
+
+	// continuations waiting for the main thread
+	std::atomic_uint64_t main_thread_queued = 0;
+};
+
+JobStats& job_stats();
+
+// fixed pool of worker threads that run jobs, lowest priority first
+// background work is split into jobs (e.g. one per chunk to generate or mini to mesh) so that every stage shares every core,
+// instead of each stage getting one thread whether it has work or not
+class JobSystem
+{
+public:
+	explicit JobSystem(const size_t num_workers);
+	~JobSystem();
+
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	// run *fn* on a worker once every job in *dependencies* is done (lower priority runs first)
+	// if *on_main_thread* is set, it's queued for the main thread once *fn*'s done (see run_main_thread_continuations)
+	JobHandle submit(std::function<void()> fn, const int priority = 0, std::span<const JobHandle> dependencies = {}, std::function<void()> on_main_thread = nullptr);
+
+	// a job that does nothing, but is done once all of *jobs* are (to wait for or depend on a group of jobs)
+	JobHandle when_all(std::span<const JobHandle> jobs, const int priority = 0);
+
+	// block until *job*'s done, running other ready jobs in the meantime
+	// (so a job or worker-side thread can wait on jobs without tying up a core)
+	// only jobs with a priority of *max_priority* or better are run, so a thread that mustn't stall (e.g. the world's) doesn't pick up long jobs
+	void wait(const JobHandle& job, const int max_priority = INT_MAX);
+
+	static bool is_done(const JobHandle& job);
+
+	// run (up to *max_count*) continuations queued for the main thread, and return how many ran
+	// the main thread calls this once per frame
+	size_t run_main_thread_continuations(const size_t max_count = SIZE_MAX);
+
+	size_t num_workers() const;
+
+private:
+	struct ready_entry
+	{
+		int priority;
+		uint64_t sequence; // equal priorities run in submission order
+		JobHandle job;
+
+		friend bool operator>(const ready_entry& lhs, const ready_entry& rhs)
+		{
+			return lhs.priority != rhs.priority ? lhs.priority > rhs.priority : lhs.sequence > rhs.sequence;
+		}
+	};
+
+	void worker_loop();
+	void make_ready(JobHandle job);
+	bool try_run_one(const int max_priority);
+	void run(const JobHandle& job);
+
+	std::vector<std::thread> workers;
+
+	// guards ready and stop, and is what waiters sleep on (notified when a job becomes ready or finishes)
+	std::mutex mutex;
+	std::condition_variable cv;
+	std::priority_queue<ready_entry, std::vector<ready_entry>, std::greater<ready_entry>> ready;
+	uint64_t next_sequence = 0;
+	size_t waiters = 0;
+	bool stop = false;
+
+	std::mutex main_thread_mutex;
+	std::vector<std::function<void()>> main_thread_continuations;
+};
+
+// the game's job system (one worker per hardware thread, minus one for the main thread)
+JobSystem& job_system();
@@ -0,0 +1,695 @@
+#include "liquids.h"
+
+#include "world_utils.h"
+
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+
+namespace
+{
+	// LiquidChunk::sides order
+	enum Side { EAST, WEST, SOUTH, NORTH };
+
+	constexpr vmath::ivec2 SIDE_OFFSETS[4] = { { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 } };
+	constexpr Side OPPOSITE_SIDES[4] = { WEST, EAST, NORTH, SOUTH };
+
+	constexpr int cell_idx(const int x, const int y, const int z) {
+		return x + z * CHUNK_WIDTH + y * CHUNK_WIDTH * CHUNK_DEPTH;
+	}
+
+	constexpr vmath::ivec3 cell_coords(const int idx) {
+		return { idx % CHUNK_WIDTH, idx / (CHUNK_WIDTH * CHUNK_DEPTH), (idx / CHUNK_WIDTH) % CHUNK_DEPTH };
+	}
+
+	static_assert(CHUNK_WIDTH == CHUNK_DEPTH, "ghost cells assume every side's the same length");
+
+	// *pos* is along the side (z for east and west, x for south and north)
+	constexpr int ghost_idx(const int y, const int pos) {
+		return pos + y * CHUNK_WIDTH;
+	}
+
+	// the index, in the neighbor on *side*, of the cell that's across from position *pos* on our side
+	constexpr int across_idx(const Side side, const int y, const int pos) {
+		switch (side) {
+		case EAST: return cell_idx(0, y, pos);
+		case WEST: return cell_idx(CHUNK_WIDTH - 1, y, pos);
+		case SOUTH: return cell_idx(pos, y, 0);
+		default: return cell_idx(pos, y, CHUNK_DEPTH - 1);
+		}
+	}
+
+	// read *count* blocks along x, starting at these mini-relative coords, with one interval lookup for the whole run
+	void read_row(const MiniChunk* mini, const int x, const int y, const int z, const int count, BlockType* out) {
+		if (mini == nullptr) {
+			std::fill(out, out + count, BlockType::Air);
+			return;
+		}
+
+		const int first = cell_idx(x, y, z);
+		auto it = mini->blocks.get_interval(static_cast<short>(first));
+		for (int i = 0; i < count; i++) {
+			for (auto next = std::next(it); next != mini->blocks.end() && next->first <= first + i; next = std::next(it)) {
+				it = next;
+			}
+			out[i] = it->second;
+		}
+	}
+
+	// (for finding paths)
+	bool can_spread_through(const BlockType& block) {
+		return block == BlockType::Air || block == BlockType::FlowingWater;
+	}
+}
+
+uint8_t liquid::from_block(const BlockType& block, const Metadata& metadata) {
+	if (block == BlockType::Air) {
+		return EMPTY;
+	}
+	if (block == BlockType::FlowingWater) {
+		return flowing(std::min<uint8_t>(metadata.get_liquid_level(), 7));
+	}
+	if (block == BlockType::StillWater) {
+		return SOURCE;
+	}
+	return SOLID;
+}
+
+
+/* LiquidChunk */
+
+
+LiquidChunk::LiquidChunk(std::shared_ptr<Chunk> chunk_) : coords(chunk_->coords), chunk(std::move(chunk_)) {
+	// copy block by block interval, only looking up metadata for flowing water
+	for (int i = 0; i < MINIS_PER_CHUNK; i++) {
+		uint8_t* mini_cells = cells.data() + i * MINICHUNK_SIZE;
+		const MiniChunk* mini = chunk->minis[i].get();
+		if (mini == nullptr) {
+			std::fill(mini_cells, mini_cells + MINICHUNK_SIZE, liquid::EMPTY);
+			continue;
+		}
+
+		for (auto it = mini->blocks.begin(); it != mini->blocks.end(); ++it) {
+			const auto next = std::next(it);
+			const int from = std::max<int>(it->first, 0);
+			const int to = next == mini->blocks.end() ? MINICHUNK_SIZE : std::min<int>(next->first, MINICHUNK_SIZE);
+
+			if (it->second == BlockType::FlowingWater) {
+				for (int idx = from; idx < to; idx++) {
+					mini_cells[idx] = liquid::from_block(it->second, mini->metadatas[static_cast<short>(idx)]);
+				}
+			}
+			else if (from < to) {
+				std::fill(mini_cells + from, mini_cells + to, liquid::from_block(it->second, {}));
+			}
+		}
+	}
+}
+
+
+/* LiquidSim */
+
+
+LiquidSim::LiquidSim(ChunkLookup get_chunk_, JobSystem* jobs_, const size_t budget_per_tick_) : get_chunk(std::move(get_chunk_)), jobs(jobs_), budget_per_tick(budget_per_tick_) {
+	assert(budget_per_tick > 0);
+}
+
+void LiquidSim::on_block_changed(const vmath::ivec3& xyz) {
+	if (xyz[1] < 0 || xyz[1] >= CHUNK_HEIGHT) {
+		return;
+	}
+
+	const vmath::ivec2 coords = get_chunk_coords(xyz[0], xyz[2]);
+	const auto search = chunks.find(coords);
+	LiquidChunk* lc = search == chunks.end() ? nullptr : search->second.get();
+
+	// not simulating this chunk yet => only start if there's water around to react
+	const bool added = lc == nullptr;
+	if (added) {
+		if (!near_water(xyz)) {
+			return;
+		}
+
+		lc = get_or_add(coords);
+		if (lc == nullptr) {
+			return;
+		}
+	}
+
+	const vmath::ivec3 rel = get_chunk_relative_coordinates(xyz[0], xyz[1], xyz[2]);
+	uint8_t& cell = lc->cells[cell_idx(rel[0], rel[1], rel[2])];
+	const uint8_t before = cell;
+	cell = liquid::from_block(lc->chunk->get_block(rel), lc->chunk->get_metadata(rel));
+
+	activate_around(*lc, rel[0], rel[1], rel[2], added || (before == liquid::SOLID) != (cell == liquid::SOLID));
+}
+
+void LiquidSim::on_chunk_loaded(const vmath::ivec2& coords) {
+	for (const auto& offset : SIDE_OFFSETS) {
+		const auto search = chunks.find(coords + offset);
+		if (search != chunks.end() && search->second->simulated) {
+			get_or_add(coords);
+			return;
+		}
+	}
+}
+
+void LiquidSim::update(const int tick) {
+	last_tick = tick;
+
+	size_t work = 0;
+	while (work < budget_per_tick) {
+		if (!stepping) {
+			if (active_cells == 0 || tick < next_step_tick) {
+				break;
+			}
+			begin_step();
+		}
+
+		// as many of the remaining chunks as fit in the budget (and at least one)
+		const size_t begin = stepping_chunk;
+		do {
+			work += stepping_chunks[stepping_chunk++]->stepping.size();
+		} while (stepping_chunk < stepping_chunks.size() && work + stepping_chunks[stepping_chunk]->stepping.size() <= budget_per_tick);
+
+		const std::span<LiquidChunk* const> regions(stepping_chunks.data() + begin, stepping_chunk - begin);
+		for_each_region(regions, step_region);
+		merge_regions(regions);
+
+		if (stepping_chunk == stepping_chunks.size()) {
+			stepping_chunks.clear();
+			stepping = false;
+			next_step_tick = tick + LIQUID_STEP_TICKS;
+			stats.steps++;
+		}
+	}
+
+	stats.last_update_work = work;
+}
+
+std::vector<vmath::ivec3> LiquidSim::take_changed_blocks() {
+	std::vector<vmath::ivec3> result;
+	result.swap(changed_blocks);
+	return result;
+}
+
+uint8_t LiquidSim::get_cell(const vmath::ivec3& xyz) const {
+	if (xyz[1] < 0 || xyz[1] >= CHUNK_HEIGHT) {
+		return liquid::EMPTY;
+	}
+
+	const auto search = chunks.find(get_chunk_coords(xyz[0], xyz[2]));
+	if (search == chunks.end()) {
+		return liquid::EMPTY;
+	}
+
+	const vmath::ivec3 rel = get_chunk_relative_coordinates(xyz[0], xyz[1], xyz[2]);
+	return search->second->cells[cell_idx(rel[0], rel[1], rel[2])];
+}
+
+size_t LiquidSim::num_active() const {
+	return active_cells;
+}
+
+size_t LiquidSim::num_chunks() const {
+	return chunks.size();
+}
+
+bool LiquidSim::mid_step() const {
+	return stepping;
+}
+
+size_t LiquidSim::budget() const {
+	return budget_per_tick;
+}
+
+void LiquidSim::set_budget(const size_t budget_per_tick_) {
+	assert(budget_per_tick_ > 0);
+	budget_per_tick = budget_per_tick_;
+}
+
+LiquidChunk* LiquidSim::get_or_add(const vmath::ivec2& coords) {
+	const auto search = chunks.find(coords);
+	if (search != chunks.end()) {
+		return search->second.get();
+	}
+
+	std::shared_ptr<Chunk> chunk = get_chunk(coords);
+	if (chunk == nullptr) {
+		return nullptr;
+	}
+
+	auto lc = std::make_unique<LiquidChunk>(std::move(chunk));
+	for (int side = 0; side < 4; side++) {
+		const auto neighbor = chunks.find(coords + SIDE_OFFSETS[side]);
+		if (neighbor != chunks.end()) {
+			lc->sides[side] = neighbor->second.get();
+			neighbor->second->sides[OPPOSITE_SIDES[side]] = lc.get();
+		}
+	}
+
+	return chunks.emplace(coords, std::move(lc)).first->second.get();
+}
+
+void LiquidSim::add_sides(LiquidChunk& lc) {
+	lc.simulated = true;
+	for (int side = 0; side < 4; side++) {
+		if (lc.sides[side] == nullptr) {
+			get_or_add(lc.coords + SIDE_OFFSETS[side]);
+		}
+	}
+}
+
+bool LiquidSim::near_water(const vmath::ivec3& xyz) const {
+	// the block itself, and every block whose next level could depend on it
+	static const vmath::ivec3 offsets[] = {
+		{ 0, 0, 0 }, IUP, IDOWN, IEAST, IWEST, ISOUTH, INORTH,
+		IUP + IEAST, IUP + IWEST, IUP + ISOUTH, IUP + INORTH,
+	};
+
+	for (const auto& offset : offsets) {
+		const vmath::ivec3 block = xyz + offset;
+		if (block[1] < 0 || block[1] >= CHUNK_HEIGHT) {
+			continue;
+		}
+
+		const std::shared_ptr<Chunk> chunk = get_chunk(get_chunk_coords(block[0], block[2]));
+		if (chunk == nullptr) {
+			continue;
+		}
+
+		if (liquid::is_water(liquid::from_block(chunk->get_block(get_chunk_relative_coordinates(block[0], block[1], block[2])), {}))) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void LiquidSim::activate(LiquidChunk& lc, int x, const int y, int z) {
+	if (y < 0 || y >= CHUNK_HEIGHT) {
+		return;
+	}
+
+	LiquidChunk* target = &lc;
+	if (x < 0) { target = lc.sides[WEST]; x += CHUNK_WIDTH; }
+	else if (x >= CHUNK_WIDTH) { target = lc.sides[EAST]; x -= CHUNK_WIDTH; }
+	else if (z < 0) { target = lc.sides[NORTH]; z += CHUNK_DEPTH; }
+	else if (z >= CHUNK_DEPTH) { target = lc.sides[SOUTH]; z -= CHUNK_DEPTH; }
+
+	if (target != nullptr) {
+		activate(*target, cell_idx(x, y, z));
+	}
+}
+
+void LiquidSim::activate(LiquidChunk& lc, const int idx) {
+	if (lc.is_active[idx]) {
+		return;
+	}
+
+	// first thing to wake up in a while => the first step happens as long after it as every other step would
+	if (active_cells == 0 && !stepping) {
+		next_step_tick = last_tick + LIQUID_STEP_TICKS;
+	}
+
+	lc.is_active[idx] = true;
+	lc.active.push_back(static_cast<uint16_t>(idx));
+	active_cells++;
+
+	if (!lc.queued) {
+		lc.queued = true;
+		active_chunks.push_back(&lc);
+		add_sides(lc);
+	}
+}
+
+void LiquidSim::activate_around(LiquidChunk& lc, const int x, const int y, const int z, const bool solidity_changed) {
+	activate(lc, x, y, z);
+	activate(lc, x, y - 1, z);
+	activate(lc, x + 1, y, z);
+	activate(lc, x - 1, y, z);
+	activate(lc, x, y, z + 1);
+	activate(lc, x, y, z - 1);
+
+	// water next to the block above only looks at this block to see whether it's standing on something
+	if (solidity_changed) {
+		activate(lc, x + 1, y + 1, z);
+		activate(lc, x - 1, y + 1, z);
+		activate(lc, x, y + 1, z + 1);
+		activate(lc, x, y + 1, z - 1);
+	}
+}
+
+uint8_t LiquidSim::cell_at(const LiquidChunk& lc, const int x, const int y, const int z) {
+	if (y < 0 || y >= CHUNK_HEIGHT) {
+		return liquid::EMPTY;
+	}
+
+	// (cells only ever look one block to the side)
+	if (x < 0) { return lc.ghosts[WEST][ghost_idx(y, z)]; }
+	if (x >= CHUNK_WIDTH) { return lc.ghosts[EAST][ghost_idx(y, z)]; }
+	if (z < 0) { return lc.ghosts[NORTH][ghost_idx(y, x)]; }
+	if (z >= CHUNK_DEPTH) { return lc.ghosts[SOUTH][ghost_idx(y, x)]; }
+
+	return lc.cells[cell_idx(x, y, z)];
+}
+
+uint8_t LiquidSim::next_cell(const LiquidChunk& lc, const int idx) {
+	const uint8_t cell = lc.cells[idx];
+
+	// only air and flowing water change
+	if (cell != liquid::EMPTY && !liquid::is_flowing(cell)) {
+		return cell;
+	}
+
+	const vmath::ivec3 xyz = cell_coords(idx);
+	const int x = xyz[0], y = xyz[1], z = xyz[2];
+
+	// water on top => full
+	if (liquid::is_water(cell_at(lc, x, y + 1, z))) {
+		return liquid::flowing(7);
+	}
+
+	// otherwise one lower than the highest water beside us, out of the ones that are standing on something
+	uint8_t highest_side = 0;
+	for (const auto& offset : SIDE_OFFSETS) {
+		if (cell_at(lc, x + offset[0], y - 1, z + offset[1]) != liquid::SOLID) {
+			continue;
+		}
+
+		const uint8_t side = cell_at(lc, x + offset[0], y, z + offset[1]);
+		if (liquid::is_water(side)) {
+			highest_side = std::max(highest_side, liquid::level(side));
+			if (highest_side == 7) {
+				break;
+			}
+		}
+	}
+
+	// (and nothing beside us => drain away)
+	const int level = cell == liquid::EMPTY ? 0 : liquid::level(cell);
+	const int next_level = highest_side - 1;
+	if (next_level == level) {
+		return cell;
+	}
+	return next_level >= 0 ? liquid::flowing(static_cast<uint8_t>(next_level)) : liquid::EMPTY;
+}
+
+void LiquidSim::begin_step() {
+	stepping_chunks.swap(active_chunks);
+	active_chunks.clear();
+
+	for (LiquidChunk* lc : stepping_chunks) {
+		lc->stepping.swap(lc->active);
+		lc->active.clear();
+		for (const uint16_t idx : lc->stepping) {
+			lc->is_active[idx] = false;
+		}
+		lc->queued = false;
+	}
+
+	active_cells = 0;
+	stepping_chunk = 0;
+	stepping = true;
+
+	// every region's ghosts are taken before any region changes, even if the step's spread over a few ticks
+	for_each_region(stepping_chunks, capture_ghosts);
+}
+
+void LiquidSim::for_each_region(std::span<LiquidChunk* const> regions, void (*fn)(LiquidChunk&)) {
+	if (jobs == nullptr) {
+		for (LiquidChunk* lc : regions) {
+			fn(*lc);
+		}
+		return;
+	}
+
+	// runs of neighboring regions (in the list), with enough cells between them to be worth a job
+	std::vector<JobHandle> handles;
+	size_t begin = 0, cells = 0;
+	for (size_t i = 0; i < regions.size(); i++) {
+		cells += regions[i]->stepping.size();
+		if (cells < LIQUID_CELLS_PER_JOB && i + 1 < regions.size()) {
+			continue;
+		}
+
+		const std::span<LiquidChunk* const> group = regions.subspan(begin, i + 1 - begin);
+		if (i + 1 == regions.size()) {
+			// (the last one runs on this thread, which would only be waiting otherwise)
+			for (LiquidChunk* lc : group) {
+				fn(*lc);
+			}
+			break;
+		}
+
+		handles.push_back(jobs->submit([group, fn]() {
+			for (LiquidChunk* lc : group) {
+				fn(*lc);
+			}
+		}, LIQUID_JOB_PRIORITY));
+		begin = i + 1;
+		cells = 0;
+	}
+
+	// (only helping with liquid jobs: a chunk generation or meshing job picked up here would hold up the whole tick)
+	if (!handles.empty()) {
+		jobs->wait(jobs->when_all(handles, LIQUID_JOB_PRIORITY), LIQUID_JOB_PRIORITY);
+	}
+}
+
+void LiquidSim::merge_regions(std::span<LiquidChunk* const> regions) {
+	for (LiquidChunk* lc : regions) {
+		stats.cells_updated += lc->stepping.size();
+		stats.cells_changed += lc->num_changed;
+		lc->stepping.clear();
+		lc->num_changed = 0;
+
+		// (its own cells were woken up already, but it might not be in the list)
+		active_cells += lc->num_activated;
+		lc->num_activated = 0;
+		if (!lc->active.empty() && !lc->queued) {
+			lc->queued = true;
+			active_chunks.push_back(lc);
+			add_sides(*lc);
+		}
+
+		changed_blocks.insert(changed_blocks.end(), lc->changed_blocks.begin(), lc->changed_blocks.end());
+		lc->changed_blocks.clear();
+
+		for (int side = 0; side < 4; side++) {
+			for (const uint16_t idx : lc->outbox[side]) {
+				activate(*lc->sides[side], idx);
+			}
+			lc->outbox[side].clear();
+		}
+	}
+}
+
+void LiquidSim::capture_ghosts(LiquidChunk& lc) {
+	const auto capture = [&](const Side side, const int y, const int pos) {
+		const LiquidChunk* neighbor = lc.sides[side];
+
+		// the cell beside us, and the one it's standing on
+		for (int ghost_y = std::max(y - 1, 0); ghost_y <= y; ghost_y++) {
+			// unloaded => air
+			lc.ghosts[side][ghost_idx(ghost_y, pos)] = neighbor == nullptr ? liquid::EMPTY : neighbor->cells[across_idx(side, ghost_y, pos)];
+		}
+	};
+
+	for (const uint16_t idx : lc.stepping) {
+		const vmath::ivec3 xyz = cell_coords(idx);
+		const int x = xyz[0], y = xyz[1], z = xyz[2];
+		if (x == 0) { capture(WEST, y, z); }
+		if (x == CHUNK_WIDTH - 1) { capture(EAST, y, z); }
+		if (z == 0) { capture(NORTH, y, x); }
+		if (z == CHUNK_DEPTH - 1) { capture(SOUTH, y, x); }
+	}
+}
+
+void LiquidSim::step_region(LiquidChunk& lc) {
+	// work out every change before making any, so cells only see the last step
+	for (const uint16_t idx : lc.stepping) {
+		const uint8_t next = next_cell(lc, idx);
+		if (next != lc.cells[idx]) {
+			lc.changes.emplace_back(idx, next);
+		}
+	}
+
+	for (const auto& [idx, cell] : lc.changes) {
+		lc.cells[idx] = cell;
+
+		const vmath::ivec3 xyz = cell_coords(idx);
+		write_block(lc, xyz[0], xyz[1], xyz[2], cell);
+		lc.changed_blocks.push_back({ lc.coords[0] * CHUNK_WIDTH + xyz[0], xyz[1], lc.coords[1] * CHUNK_DEPTH + xyz[2] });
+		activate_around_in_region(lc, xyz[0], xyz[1], xyz[2]);
+	}
+
+	lc.num_changed = lc.changes.size();
+	lc.changes.clear();
+}
+
+void LiquidSim::activate_in_region(LiquidChunk& lc, int x, const int y, int z) {
+	if (y < 0 || y >= CHUNK_HEIGHT) {
+		return;
+	}
+
+	int side = -1;
+	if (x < 0) { side = WEST; x += CHUNK_WIDTH; }
+	else if (x >= CHUNK_WIDTH) { side = EAST; x -= CHUNK_WIDTH; }
+	else if (z < 0) { side = NORTH; z += CHUNK_DEPTH; }
+	else if (z >= CHUNK_DEPTH) { side = SOUTH; z -= CHUNK_DEPTH; }
+
+	const int idx = cell_idx(x, y, z);
+	if (side >= 0) {
+		if (lc.sides[side] != nullptr) {
+			lc.outbox[side].push_back(static_cast<uint16_t>(idx));
+		}
+		return;
+	}
+
+	if (!lc.is_active[idx]) {
+		lc.is_active[idx] = true;
+		lc.active.push_back(static_cast<uint16_t>(idx));
+		lc.num_activated++;
+	}
+}
+
+void LiquidSim::activate_around_in_region(LiquidChunk& lc, const int x, const int y, const int z) {
+	// (the sim never changes whether a cell's solid)
+	activate_in_region(lc, x, y, z);
+	activate_in_region(lc, x, y - 1, z);
+	activate_in_region(lc, x + 1, y, z);
+	activate_in_region(lc, x - 1, y, z);
+	activate_in_region(lc, x, y, z + 1);
+	activate_in_region(lc, x, y, z - 1);
+}
+
+void LiquidSim::write_block(LiquidChunk& lc, const int x, const int y, const int z, const uint8_t cell) {
+	Chunk& chunk = *lc.chunk;
+	if (chunk.get_mini_with_y_level(y) == nullptr) {
+		return;
+	}
+
+	if (cell == liquid::EMPTY) {
+		chunk.set_block(x, y, z, BlockType::Air);
+		return;
+	}
+
+	assert(liquid::is_flowing(cell));
+	Metadata metadata;
+	metadata.set_liquid_level(liquid::level(cell));
+	chunk.set_block(x, y, z, BlockType::FlowingWater);
+	chunk.set_metadata(x, y, z, metadata);
+}
+
+
+/* paths */
+
+
+liquid::PathGrid liquid::fetch_path_grid(const LiquidSim::ChunkLookup& get_chunk, const vmath::ivec3& xyz) {
+	PathGrid grid;
+	const int y = xyz[1];
+	if (y < 0 || y >= CHUNK_HEIGHT) {
+		return grid;
+	}
+
+	const int min_x = xyz[0] - PATH_RADIUS, max_x = xyz[0] + PATH_RADIUS;
+	const int min_z = xyz[2] - PATH_RADIUS, max_z = xyz[2] + PATH_RADIUS;
+	const vmath::ivec2 min_chunk = get_chunk_coords(min_x, min_z);
+	const vmath::ivec2 max_chunk = get_chunk_coords(max_x, max_z);
+
+	for (int chunk_x = min_chunk[0]; chunk_x <= max_chunk[0]; chunk_x++) {
+		for (int chunk_z = min_chunk[1]; chunk_z <= max_chunk[1]; chunk_z++) {
+			const std::shared_ptr<Chunk> chunk = get_chunk({ chunk_x, chunk_z });
+			if (chunk == nullptr) {
+				continue;
+			}
+
+			// the part of the grid in this chunk
+			const int from_x = std::max(min_x, chunk_x * CHUNK_WIDTH), to_x = std::min(max_x, chunk_x * CHUNK_WIDTH + CHUNK_WIDTH - 1);
+			const int from_z = std::max(min_z, chunk_z * CHUNK_DEPTH), to_z = std::min(max_z, chunk_z * CHUNK_DEPTH + CHUNK_DEPTH - 1);
+			const int count = to_x - from_x + 1;
+
+			const MiniChunk* mini = chunk->get_mini_with_y_level(y);
+			const MiniChunk* mini_below = y > 0 ? chunk->get_mini_with_y_level(y - 1) : nullptr;
+
+			for (int z = from_z; z <= to_z; z++) {
+				const vmath::ivec3 rel = get_chunk_relative_coordinates(from_x, y, z);
+				BlockType blocks[PATH_WIDTH], below[PATH_WIDTH];
+				read_row(mini, rel[0], y % MINICHUNK_HEIGHT, rel[2], count, blocks);
+
+				// (the bottom of the world holds water up)
+				if (y > 0) {
+					read_row(mini_below, rel[0], (y - 1) % MINICHUNK_HEIGHT, rel[2], count, below);
+				}
+				else {
+					std::fill(below, below + count, BlockType::Stone);
+				}
+
+				for (int i = 0; i < count; i++) {
+					if (!can_spread_through(blocks[i])) {
+						continue;
+					}
+
+					const uint16_t bit = 1 << (from_x + i - min_x);
+					(below[i].is_solid() ? grid.open : grid.drop)[z - min_z] |= bit;
+				}
+			}
+		}
+	}
+
+	return grid;
+}
+
+uint8_t liquid::shortest_path_dirs(const PathGrid& grid) {
+	using Rows = std::array<uint16_t, PATH_WIDTH>;
+	constexpr uint16_t ROW_MASK = (1 << PATH_WIDTH) - 1;
+	constexpr uint16_t MIDDLE = 1 << PATH_RADIUS;
+	constexpr uint8_t DIRS[4] = { PATH_EAST, PATH_WEST, PATH_SOUTH, PATH_NORTH };
+
+	// a breadth-first search a whole distance at a time, with a frontier for each direction out of the middle, so every drop found knows which ways lead to it
+	// (a block that's the same distance away in two directions is in both frontiers)
+	std::array<Rows, 4> frontiers{};
+	frontiers[EAST][PATH_RADIUS] = MIDDLE << 1;
+	frontiers[WEST][PATH_RADIUS] = MIDDLE >> 1;
+	frontiers[SOUTH][PATH_RADIUS + 1] = MIDDLE;
+	frontiers[NORTH][PATH_RADIUS - 1] = MIDDLE;
+
+	Rows reached{};
+	reached[PATH_RADIUS] = MIDDLE;
+
+	while (true) {
+		// drops at this distance => done
+		uint8_t result = 0;
+		bool any_open = false;
+		for (int dir = 0; dir < 4; dir++) {
+			for (int row = 0; row < PATH_WIDTH; row++) {
+				if (frontiers[dir][row] & grid.drop[row]) {
+					result |= DIRS[dir];
+				}
+				frontiers[dir][row] &= grid.open[row];
+				any_open |= frontiers[dir][row] != 0;
+			}
+		}
+		if (result != 0 || !any_open) {
+			return result;
+		}
+
+		for (const Rows& frontier : frontiers) {
+			for (int row = 0; row < PATH_WIDTH; row++) {
+				reached[row] |= frontier[row];
+			}
+		}
+
+		// step out from the open blocks, to everything not reached yet
+		for (Rows& frontier : frontiers) {
+			Rows next;
+			for (int row = 0; row < PATH_WIDTH; row++) {
+				const uint16_t beside = (frontier[row] << 1) | (frontier[row] >> 1);
+				const uint16_t across = (row > 0 ? frontier[row - 1] : 0) | (row + 1 < PATH_WIDTH ? frontier[row + 1] : 0);
+				next[row] = (beside | across) & ROW_MASK & ~reached[row];
+			}
+			frontier = next;
+		}
+	}
+}
@@ -0,0 +1,240 @@
+#pragma once
+
+#include "chunk.h"
+#include "jobs.h"
+#include "util.h"
+
+#include "vmath.h"
+
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+// how many ticks liquid waits before it spreads
+constexpr int LIQUID_STEP_TICKS = 5;
+
+// how many cells the liquid sim updates per tick, at most (give or take a chunk, since a chunk's cells are always updated together)
+// anything past that waits for the next tick, so e.g. breaking a dam next to an ocean can't stall a frame
+constexpr size_t LIQUID_UPDATE_BUDGET = 16384;
+
+// chunks are stepped in parallel in jobs of at least this many cells, so small steps don't cost more in jobs than they save
+constexpr size_t LIQUID_CELLS_PER_JOB = 2048;
+
+// job priority for liquid steps (lower runs first), ahead of chunk generation and meshing since the world thread's waiting on them
+constexpr int LIQUID_JOB_PRIORITY = -1;
+
+// what liquid sees in each block
+namespace liquid
+{
+	constexpr uint8_t EMPTY = 0;  // air
+	                              // 1-8 = flowing water with level 0-7
+	constexpr uint8_t SOURCE = 9; // still water (counts as level 7)
+	constexpr uint8_t SOLID = 10; // everything else
+
+	constexpr uint8_t flowing(const uint8_t level) { return level + 1; }
+
+	constexpr bool is_flowing(const uint8_t cell) { return EMPTY < cell && cell < SOURCE; }
+	constexpr bool is_water(const uint8_t cell) { return EMPTY < cell && cell <= SOURCE; }
+
+	// (for water only)
+	constexpr uint8_t level(const uint8_t cell) { return cell == SOURCE ? 7 : cell - 1; }
+
+	uint8_t from_block(const BlockType& block, const Metadata& metadata);
+}
+
+// one loaded chunk, as liquid sees it
+// a chunk's also a region of the sim: during a step, it only writes to itself, and only reads its neighbors through its ghost cells
+struct LiquidChunk
+{
+	LiquidChunk(std::shared_ptr<Chunk> chunk_);
+
+	vmath::ivec2 coords;
+	std::shared_ptr<Chunk> chunk;
+
+	// indexed like chunk blocks (x, then z, then y)
+	std::array<uint8_t, CHUNK_SIZE> cells;
+
+	// cells to update in the next step, each at most once
+	std::vector<uint16_t> active;
+	std::bitset<CHUNK_SIZE> is_active;
+
+	// cells being updated in this step
+	std::vector<uint16_t> stepping;
+
+	// loaded side neighbors (east, west, south, north), so cells on the edge can look across without a lookup
+	std::array<LiquidChunk*, 4> sides{};
+
+	// copies of the neighbors' cells along each side (indexed by y * CHUNK_WIDTH + position along the side), taken when a step starts
+	// only the ones next to stepping cells (and one lower) are filled in
+	std::array<std::array<uint8_t, CHUNK_WIDTH * CHUNK_HEIGHT>, 4> ghosts;
+
+	// what the last step did, for the sim to pick up once every region's done
+	std::array<std::vector<uint16_t>, 4> outbox; // neighbor cells to wake up, by side
+	std::vector<vmath::ivec3> changed_blocks;
+	std::vector<std::pair<uint16_t, uint8_t>> changes;
+	size_t num_activated = 0;
+	size_t num_changed = 0;
+
+	// whether we're in the sim's list of chunks with active cells
+	bool queued = false;
+
+	// whether we've ever had active cells (if not, we're only here so a neighbor can look at us, and our own neighbors don't matter)
+	bool simulated = false;
+};
+
+struct LiquidStats
+{
+	uint64_t steps = 0;
+	uint64_t cells_updated = 0;
+	uint64_t cells_changed = 0;
+
+	// cells updated in the last update
+	size_t last_update_work = 0;
+};
+
+// water, as a cellular automaton over per-chunk copies of the world's liquid levels
+//
+// changed blocks wake up the cells around them, and every LIQUID_STEP_TICKS ticks, each awake cell works out its next level from its neighbors' current ones
+// once every awake cell in a chunk's done, its changes are written back together, and the cells around each change wake up for the next step
+// cells on a chunk's edge read their neighbors' ghost copies, taken before any chunk changed, and wake up neighbors through an outbox delivered afterwards
+// so the result doesn't depend on what order cells or chunks are updated in, and chunks can be stepped in parallel (with the same result as one at a time)
+//
+// world thread only (steps run on the job system, but update doesn't return until they're done)
+class LiquidSim
+{
+public:
+	// gets the loaded chunk at these chunk coords (or nullptr)
+	using ChunkLookup = std::function<std::shared_ptr<Chunk>(const vmath::ivec2&)>;
+
+	// steps chunks in parallel on *jobs* (or one at a time on the calling thread if it's null)
+	explicit LiquidSim(ChunkLookup get_chunk_, JobSystem* jobs_ = nullptr, const size_t budget_per_tick_ = LIQUID_UPDATE_BUDGET);
+
+	// something other than the sim (e.g. the player) changed the block at *xyz* => update our copy of it, and wake up the liquid around it
+	void on_block_changed(const vmath::ivec3& xyz);
+
+	// a chunk was loaded => if liquid next to it's being simulated, let it see the new chunk
+	void on_chunk_loaded(const vmath::ivec2& coords);
+
+	// run the sim up to *tick*, within the budget
+	void update(const int tick);
+
+	// blocks liquid changed since the last call (for the world's ChangeJournal, which works out which minis to remesh)
+	std::vector<vmath::ivec3> take_changed_blocks();
+
+	// the cell at these block coords (EMPTY if its chunk isn't being simulated)
+	uint8_t get_cell(const vmath::ivec3& xyz) const;
+
+	// cells waiting for the next step
+	size_t num_active() const;
+
+	// chunks we have a copy of
+	size_t num_chunks() const;
+
+	// whether a step's been started but not finished
+	bool mid_step() const;
+
+	size_t budget() const;
+	void set_budget(const size_t budget_per_tick_);
+
+	LiquidStats stats;
+
+private:
+	// our copy of the chunk at *coords*, made if the chunk's loaded
+	LiquidChunk* get_or_add(const vmath::ivec2& coords);
+
+	// make sure the chunk's loaded side neighbors are copied too, since its cells look at them
+	void add_sides(LiquidChunk& lc);
+
+	// is there water at or around these block coords? (looked up in the world, for chunks we don't have a copy of)
+	bool near_water(const vmath::ivec3& xyz) const;
+
+	// wake up the cell at these chunk-relative coords (x and z can be one past the edge)
+	void activate(LiquidChunk& lc, int x, const int y, int z);
+	void activate(LiquidChunk& lc, const int idx);
+
+	// wake up everything that might react to a change at these coords
+	void activate_around(LiquidChunk& lc, const int x, const int y, const int z, const bool solidity_changed);
+
+	void begin_step();
+
+	// run *fn* on each of *regions*, in parallel if we can
+	void for_each_region(std::span<LiquidChunk* const> regions, void (*fn)(LiquidChunk&));
+
+	// pick up what *regions* did in their step (in order, so it's the same however they were run)
+	void merge_regions(std::span<LiquidChunk* const> regions);
+
+	// the rest only touch the one region, so they're safe to run on any thread during a step
+
+	// copy the neighbor cells that the region's stepping cells look at
+	static void capture_ghosts(LiquidChunk& lc);
+
+	// update every stepping cell in the region, then write back the changes
+	static void step_region(LiquidChunk& lc);
+
+	// the cell at these chunk-relative coords (x and z can be one past the edge, which reads the ghosts)
+	static uint8_t cell_at(const LiquidChunk& lc, const int x, const int y, const int z);
+
+	// what the cell at *idx* becomes next step
+	static uint8_t next_cell(const LiquidChunk& lc, const int idx);
+
+	// wake up the cell at these chunk-relative coords next step, or leave it in the outbox if it's in a neighbor
+	static void activate_in_region(LiquidChunk& lc, int x, const int y, int z);
+	static void activate_around_in_region(LiquidChunk& lc, const int x, const int y, const int z);
+
+	// write a cell back to the chunk
+	static void write_block(LiquidChunk& lc, const int x, const int y, const int z, const uint8_t cell);
+
+	ChunkLookup get_chunk;
+	JobSystem* jobs;
+	size_t budget_per_tick;
+
+	std::unordered_map<vmath::ivec2, std::unique_ptr<LiquidChunk>, vecN_hash> chunks;
+
+	// chunks with active cells, in the order they were woken up
+	std::vector<LiquidChunk*> active_chunks;
+	size_t active_cells = 0;
+
+	// the step in progress (chunks before stepping_chunk are done)
+	bool stepping = false;
+	std::vector<LiquidChunk*> stepping_chunks;
+	size_t stepping_chunk = 0;
+
+	int last_tick = 0;
+	int next_step_tick = 0;
+
+	std::vector<vmath::ivec3> changed_blocks;
+};
+
+// finding the way down, for water that's spreading over a flat surface
+namespace liquid
+{
+	// how far to look (blocks out from the water, along x and z)
+	constexpr int PATH_RADIUS = 4;
+	constexpr int PATH_WIDTH = PATH_RADIUS * 2 + 1;
+
+	// directions out of the water (as bits)
+	constexpr uint8_t PATH_EAST = 1 << 0;
+	constexpr uint8_t PATH_WEST = 1 << 1;
+	constexpr uint8_t PATH_SOUTH = 1 << 2;
+	constexpr uint8_t PATH_NORTH = 1 << 3;
+
+	// the blocks around some water, at its height, with the water in the middle
+	// one row per z, one bit per x
+	struct PathGrid
+	{
+		std::array<uint16_t, PATH_WIDTH> open{}; // air (or flowing water) that's standing on something solid => water can spread through it
+		std::array<uint16_t, PATH_WIDTH> drop{}; // air (or flowing water) that isn't => water can fall down it
+	};
+
+	// the grid around *xyz*, reading each chunk it covers (at most 4) once, a row of blocks at a time (unloaded chunks are neither open nor drops)
+	PathGrid fetch_path_grid(const LiquidSim::ChunkLookup& get_chunk, const vmath::ivec3& xyz);
+
+	// the directions out of the middle that start a shortest path through open blocks to a drop (0 if there's no drop in reach)
+	uint8_t shortest_path_dirs(const PathGrid& grid);
+}
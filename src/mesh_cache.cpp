@@ -0,0 +1,90 @@
+#include "mesh_cache.h"
+
+#include <cassert>
+
+
+/* MeshCacheStats */
+
+
+float MeshCacheStats::hit_rate() const
+{
+	const uint64_t h = hits;
+	const uint64_t total = h + misses;
+	return total == 0 ? 0.0f : static_cast<float>(h) / total;
+}
+
+int64_t MeshCacheStats::net_saved_ns() const
+{
+	return static_cast<int64_t>(saved_ns) - static_cast<int64_t>(hash_ns);
+}
+
+MeshCacheStats& mesh_cache_stats()
+{
+	static MeshCacheStats stats;
+	return stats;
+}
+
+
+/* MeshCache */
+
+
+MeshCache::MeshCache(const size_t capacity) : capacity(capacity)
+{
+	assert(capacity > 0);
+	map.reserve(capacity);
+}
+
+bool MeshCache::find(const uint64_t key, MeshCacheEntry& result)
+{
+	std::lock_guard lock(mutex);
+
+	auto search = map.find(key);
+	if (search == map.end())
+	{
+		return false;
+	}
+
+	// move to front
+	lru.splice(lru.begin(), lru, search->second);
+
+	result = search->second->second;
+	return true;
+}
+
+void MeshCache::insert(const uint64_t key, const MeshCacheEntry& entry)
+{
+	std::lock_guard lock(mutex);
+
+	auto search = map.find(key);
+
+	// if key exists, update it
+	if (search != map.end())
+	{
+		search->second->second = entry;
+		lru.splice(lru.begin(), lru, search->second);
+		return;
+	}
+
+	// if full, evict least recently used
+	if (lru.size() >= capacity)
+	{
+		map.erase(lru.back().first);
+		lru.pop_back();
+	}
+
+	lru.emplace_front(key, entry);
+	map[key] = lru.begin();
+}
+
+size_t MeshCache::size() const
+{
+	std::lock_guard lock(mutex);
+	return lru.size();
+}
+
+void MeshCache::clear()
+{
+	std::lock_guard lock(mutex);
+	lru.clear();
+	map.clear();
+}
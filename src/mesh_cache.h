@@ -0,0 +1,77 @@
+#pragma once
+
+#include "minichunkmesh.h"
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+constexpr size_t MESH_CACHE_CAPACITY = 1024;
+
+// everything a mini meshed into, shared between all minis with the same contents
+struct MeshCacheEntry
+{
+	bool invisible = false;
+	std::shared_ptr<const MiniChunkMesh> mesh;
+	std::shared_ptr<const MiniChunkMesh> water_mesh;
+	MiniChunkLodMeshes lods[MESH_LOD_LEVELS - 1];
+
+	// how long it took to mesh (i.e. how much time a hit saves)
+	uint64_t mesh_ns = 0;
+};
+
+// cache counters, shared by all meshers (for debug info)
+struct MeshCacheStats
+{
+	std::atomic_uint64_t hits = 0;
+	std::atomic_uint64_t misses = 0;
+
+	// time spent hashing requests (hits and misses)
+	std::atomic_uint64_t hash_ns = 0;
+
+	// time spent meshing on misses
+	std::atomic_uint64_t miss_ns = 0;
+
+	// meshing time that hits didn't have to spend
+	std::atomic_uint64_t saved_ns = 0;
+
+	float hit_rate() const;
+
+	// time saved by hits, minus the time we spent hashing
+	int64_t net_saved_ns() const;
+};
+
+MeshCacheStats& mesh_cache_stats();
+
+// bounded LRU of generated meshes, keyed by a hash of a mini's contents + the neighbor blocks bordering it
+// thread-safe (minis are meshed by job system workers in parallel)
+class MeshCache
+{
+public:
+	MeshCache(const size_t capacity = MESH_CACHE_CAPACITY);
+
+	// if key exists, copy its entry into result and mark it as most recently used
+	bool find(const uint64_t key, MeshCacheEntry& result);
+
+	// insert entry, evicting least recently used if full
+	void insert(const uint64_t key, const MeshCacheEntry& entry);
+
+	size_t size() const;
+
+	void clear();
+
+private:
+	using lru_list = std::list<std::pair<uint64_t, MeshCacheEntry>>;
+
+	const size_t capacity;
+
+	mutable std::mutex mutex;
+
+	// most recently used at front
+	lru_list lru;
+	std::unordered_map<uint64_t, lru_list::iterator> map;
+};
@@ -1,33 +1,29 @@
 #include "mesher.h"
 
+#include "bus_stats.h"
+#include "jobs.h"
 #include "world_meshing.h"
 
-#include "zmq_addon.hpp"
-
+#include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <thread>
 
 
 using namespace vmath;
 using namespace std;
 
 
-void MeshingThread2(std::shared_ptr<zmq::context_t> ctx, msg::on_ready_fn on_ready)
+void MeshingThread2(msg::on_ready_fn on_ready)
 {
-	Mesher m(ctx);
+	Mesher m;
 	m.run(on_ready);
 }
 
-Mesher::Mesher(std::shared_ptr<zmq::context_t> ctx_) : ctx(ctx_), bus(ctx_), player_coords({ 0, 0 })
+Mesher::Mesher()
 {
-#ifdef _DEBUG
-	bus.out.setsockopt(ZMQ_SUBSCRIBE, "", 0);
-#else
-	for (const auto& m : msg::meshing_thread_incoming)
-	{
-		// TODO: Upgrade cppzmq and replace this with .set()
-		bus.out.setsockopt(ZMQ_SUBSCRIBE, m.c_str(), m.size());
-	}
-#endif // _DEBUG
+	bus.subscribe(msg::meshing_thread_incoming);
+	bus.track_thread("mesher");
 }
 
 // thread for generating new chunk meshes
@@ -39,19 +35,29 @@ void Mesher::run(msg::on_ready_fn on_ready) {
 	bool stop = false;
 	while (!stop)
 	{
-		// If no queued requests, wait for a message to come in
-		bool wait_for_first = pq.size() == 0;
+		// If we can't start any more jobs, wait for a message to come in (our jobs send us one when they finish)
+		bool wait_for_first = (queue.empty() || jobs_in_flight >= job_system().num_workers()) && held_responses.empty();
 		handle_all_messages(wait_for_first, stop);
 		if (stop) break;
 
-		// Handle a queued request if exists
-		handle_queued_request();
+		// If the render thread's behind, give it a moment instead of meshing more
+		if (!send_held_responses())
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			continue;
+		}
+
+		// Keep every worker busy
+		start_queued_requests();
 	}
+
+	// (jobs still running use our cache and bus)
+	wait_for_jobs();
 }
 
 void Mesher::handle_all_messages(bool wait_for_first, bool& stop)
 {
-	std::vector<zmq::message_t> msg;
+	Message msg;
 	bool wait = wait_for_first;
 	while (read_msg(wait, msg))
 	{
@@ -61,98 +67,238 @@ void Mesher::handle_all_messages(bool wait_for_first, bool& stop)
 	}
 }
 
-void Mesher::on_msg(const std::vector<zmq::message_t>& msg, bool& stop)
+void Mesher::on_msg(Message& msg, bool& stop)
 {
-	if (msg[0].to_string_view() == msg::EXIT)
+	switch (msg.topic)
 	{
+	case msg::EXIT:
 		stop = true;
-	}
-	else if (msg[0].to_string_view() == msg::MESH_GEN_REQUEST)
+		break;
+	case msg::MESH_GEN_REQUEST:
 	{
 		// Enqueue any meshing requests
 		// TODO: Just enqueue coords, then later deal them to workers
 
-		MeshGenRequest* req_ = *(msg[1].data<MeshGenRequest*>());
-		assert(req_);
-		std::shared_ptr<MeshGenRequest> req(req_);
-		on_mesh_gen_request(req);
+		std::shared_ptr<MeshGenRequest> req = msg.take<MeshGenRequest>();
+		assert(req);
+		on_mesh_gen_request(req, msg.sent);
+		break;
 	}
-	else if (msg[0].to_string_view() == msg::EVENT_PLAYER_MOVED_CHUNKS)
-	{
-		vmath::ivec2 new_coords = *(msg[1].data<vmath::ivec2>());
-		update_player_coords(new_coords);
-	}
-	else
-	{
+	case msg::MESH_GEN_JOB_DONE:
+		on_mesh_gen_job_done(msg.take<mesh_gen_job_result>());
+		break;
+	case msg::EVENT_PLAYER_VIEW_CHANGED:
+		update_view(msg.get<PlayerView>());
+		break;
+	case msg::EVENT_RENDER_DISTANCE_CHANGED:
+		update_render_distance(msg.get<int>());
+		break;
+	default:
 #ifndef _DEBUG
 		WindowsException("unknown message");
 #endif // _DEBUG
+		break;
 	}
 }
 
-bool Mesher::read_msg(bool wait, std::vector<zmq::message_t>& msg)
+bool Mesher::read_msg(bool wait, Message& msg)
 {
-	msg.clear();
-	auto flags = wait ? zmq::recv_flags::none : zmq::recv_flags::dontwait;
-	auto ret = zmq::recv_multipart(bus.out, std::back_inserter(msg), flags);
-	return ret > 0;
+	return bus.recv(msg, wait);
 }
 
-bool Mesher::handle_queued_request()
+// start meshing queued minis until every worker has one (one job each)
+// each job sends its mesh back to us when it's done, so we can start the next one right away, and handle messages (e.g. the player moving) in the meantime
+void Mesher::start_queued_requests()
 {
-	if (pq.size())
+	JobSystem& jobs = job_system();
+	if (queue.empty() || jobs_in_flight >= jobs.num_workers())
 	{
-		// handle one
-		vmath::ivec3 coords = pq.top().coords;
-		pq.pop();
-		auto search = reqs.find(coords);
-		assert(search != reqs.end());
-		std::shared_ptr<MeshGenRequest> req = search->second;
-		reqs.erase(search);
+		return;
+	}
+
+	// forget jobs that are done
+	std::erase_if(job_handles, [](const JobHandle& job) { return JobSystem::is_done(job); });
+
+	RequestQueueStats& stats = mesh_gen_stats();
+	while (!queue.empty() && jobs_in_flight < jobs.num_workers())
+	{
+		std::shared_ptr<MeshGenRequest> req = std::move(queue.top_value().req);
+		const int priority = queue.top_priority();
+		const msg::clock::time_point requested = queue.top_value().requested;
+		queue.pop();
+
+		stats.completed++;
+		stats.in_flight--;
+		if (render_distance >= 0 && distance_to_player(req->coords) > render_distance)
+		{
+			stats.wasted++;
+		}
 
 		// generate a mesh if possible
-		MeshGenResult* mesh = gen_minichunk_mesh_from_req(req);
-		if (mesh != nullptr)
+		MeshingOptions options;
+		options.lods = needs_lods(req->coords);
+		jobs_in_flight++;
+		job_handles.push_back(jobs.submit([this, req = std::move(req), options, requested]()
+			{
+				auto result = std::make_unique<mesh_gen_job_result>();
+				result->mesh.reset(gen_minichunk_mesh_from_req(req, &mesh_cache, options));
+				result->requested = requested;
+
+				// (if this got lost, we'd think the job never finished, and stop starting new ones, so keep trying until our inbox has room)
+				Message done(msg::MESH_GEN_JOB_DONE, std::move(result));
+				while (!bus.send(std::move(done)))
+				{
+					std::this_thread::yield();
+				}
+			}, priority));
+	}
+	stats.queued = queue.size();
+}
+
+void Mesher::on_mesh_gen_job_done(std::unique_ptr<mesh_gen_job_result> result)
+{
+	assert(jobs_in_flight > 0);
+	jobs_in_flight--;
+
+	if (result->mesh != nullptr)
+	{
+		// send it (or hold on to it if the render thread's inbox is full, or earlier ones are already held)
+		mesh_gen_stats().messages++;
+		Message response(msg::MESH_GEN_RESPONSE, std::move(result->mesh));
+		if (!held_responses.empty() || !bus.send(std::move(response)))
+		{
+			held_responses.push_back(std::move(response));
+		}
+	}
+
+	bus_stats().topic(msg::MESH_GEN_REQUEST).request_to_response.record(msg::clock::now() - result->requested);
+}
+
+// (jobs that are still running keep trying to tell us they're done, so keep reading until they all have)
+void Mesher::wait_for_jobs()
+{
+	Message msg;
+	while (jobs_in_flight > 0 && bus.recv(msg, true))
+	{
+		if (msg.topic == msg::MESH_GEN_JOB_DONE)
 		{
-			// send it
-			std::vector<zmq::const_buffer> result({
-				zmq::buffer(msg::MESH_GEN_RESPONSE),
-				zmq::buffer(&mesh, sizeof(mesh))
-				});
-			auto ret = zmq::send_multipart(bus.in, result, zmq::send_flags::dontwait);
-			assert(ret);
+			jobs_in_flight--;
 		}
+	}
+
+	JobSystem& jobs = job_system();
+	jobs.wait(jobs.when_all(job_handles));
+	job_handles.clear();
+}
 
-		return true;
+// returns true if there's nothing held back anymore
+bool Mesher::send_held_responses()
+{
+	while (!held_responses.empty() && bus.send(std::move(held_responses.front())))
+	{
+		held_responses.pop_front();
 	}
 
-	return false;
+	return held_responses.empty();
 }
 
-void Mesher::on_mesh_gen_request(std::shared_ptr<MeshGenRequest> req)
+void Mesher::on_mesh_gen_request(std::shared_ptr<MeshGenRequest> req, const msg::clock::time_point requested)
 {
-	vmath::ivec2 chunk_coords = { req->coords[0], req->coords[2] };
-	float priority = vmath::distance(chunk_coords, player_coords);
-	auto search = reqs.find(req->coords);
-	if (search != reqs.end())
+	queued_mesh_request* queued = queue.find(req->coords);
+	if (queued != nullptr)
 	{
-		search->second = req;
+		// replaces the queued one
+		queued->req = req;
+		mesh_gen_stats().in_flight--;
+	}
+	else if (should_cancel(req->coords))
+	{
+		// already too far away, tell the world we won't be meshing it
+		mesh_gen_stats().cancelled++;
+		mesh_gen_stats().in_flight--;
+		mesh_gen_stats().messages++;
+		auto cancelled = std::make_unique<std::vector<vmath::ivec3>>(1, req->coords);
+		auto ret = bus.send(Message(msg::MESH_GEN_CANCELLED, std::move(cancelled)));
+		assert(ret);
 	}
 	else
 	{
-		pq.emplace(priority, req->coords);
-		reqs[req->coords] = req;
+		queue.insert(req->coords, priority_of(req->coords), { req, requested });
+		mesh_gen_stats().queued = queue.size();
 	}
 }
 
-void Mesher::update_player_coords(const vmath::ivec2& new_coords)
+void Mesher::update_view(const PlayerView& new_view)
 {
-	if (new_coords != player_coords)
+	const bool moved_chunks = new_view.chunk_coords != view.chunk_coords;
+	view = new_view;
+
+	// Adjust queue priorities
+	queue.reprioritize([&](const vmath::ivec3& coords) { return priority_of(coords); });
+
+	if (moved_chunks)
 	{
-		player_coords = new_coords;
+		cancel_far_requests();
+	}
+}
 
-		// Adjust priority queue priorities:
-		std::function<void(pq_entry&)> adjust = [&](pq_entry& e) { e.priority = vmath::distance(vmath::ivec2(e.coords[0], e.coords[2]), player_coords); };
-		update_pq_priorities(pq, adjust);
+void Mesher::update_render_distance(const int new_render_distance)
+{
+	if (new_render_distance != render_distance)
+	{
+		render_distance = new_render_distance;
+		cancel_far_requests();
 	}
 }
+
+int Mesher::priority_of(const vmath::ivec3& coords) const
+{
+	return view_priority(view, { coords[0], coords[2] });
+}
+
+// distance (in chunks) from the player's chunk
+int Mesher::distance_to_player(const vmath::ivec3& coords) const
+{
+	return static_cast<int>(vmath::distance(vmath::ivec2(coords[0], coords[2]), view.chunk_coords));
+}
+
+// whether a mini's far enough away that it might get drawn at a coarser level of detail (otherwise building those meshes is a waste)
+// (if the player walks away from it, the renderer asks for it to be re-meshed with them)
+bool Mesher::needs_lods(const vmath::ivec3& coords) const
+{
+	const vmath::vec2 center = { coords[0] + 0.5f, coords[2] + 0.5f };
+	return vmath::length(center - view.position) >= LOD_DISTANCES[0];
+}
+
+bool Mesher::should_cancel(const vmath::ivec3& coords) const
+{
+	return render_distance >= 0 && distance_to_player(coords) > render_distance + REQUEST_CANCEL_SLACK;
+}
+
+// drop queued requests that are too far from the player, and tell the world so it can re-request them if it comes back
+void Mesher::cancel_far_requests()
+{
+	std::vector<vmath::ivec3> cancelled;
+	queue.erase_if([&](const vmath::ivec3& coords, const int) {
+		if (should_cancel(coords))
+		{
+			cancelled.push_back(coords);
+			return true;
+		}
+		return false;
+	});
+
+	if (cancelled.empty())
+	{
+		return;
+	}
+
+	RequestQueueStats& stats = mesh_gen_stats();
+	stats.queued = queue.size();
+	stats.cancelled += cancelled.size();
+	stats.in_flight -= cancelled.size();
+	stats.messages++;
+
+	auto ret = bus.send(Message(msg::MESH_GEN_CANCELLED, std::make_unique<std::vector<vmath::ivec3>>(std::move(cancelled))));
+	assert(ret);
+}
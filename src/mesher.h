@@ -1,62 +1,80 @@
 #pragma once
 
+#include "indexed_heap.h"
+#include "jobs.h"
+#include "mesh_cache.h"
 #include "messaging.h"
 #include "world_utils.h"
 
 #include "vmath.h"
-#include "zmq.hpp"
 
+#include <deque>
 #include <memory>
-#include <queue>
-#include <unordered_map>
 #include <vector>
 
-void MeshingThread2(std::shared_ptr<zmq::context_t> ctx, msg::on_ready_fn on_ready);
+void MeshingThread2(msg::on_ready_fn on_ready);
 
-struct pq_entry
+// a request waiting in the mesher's queue
+struct queued_mesh_request
 {
-	pq_entry(int priority_, const vmath::ivec3& coords_) : priority(priority_), coords(coords_)
-	{
-	}
-
-	friend bool operator<(const pq_entry& lhs, const pq_entry& rhs)
-	{
-		return lhs.priority < rhs.priority;
-	}
-
-	friend bool operator>(const pq_entry& lhs, const pq_entry& rhs)
-	{
-		return lhs.priority > rhs.priority;
-	}
-
-	int priority;
-	vmath::ivec3 coords;
+	std::shared_ptr<MeshGenRequest> req;
+
+	// when the world first asked for this mini (kept when a newer request replaces it)
+	msg::clock::time_point requested;
+};
+
+// a mini one of our jobs finished meshing (the job sends it back to us, see Mesher::start_queued_requests)
+struct mesh_gen_job_result
+{
+	std::unique_ptr<MeshGenResult> mesh;
+	msg::clock::time_point requested;
 };
 
 class Mesher
 {
 public:
-	Mesher(std::shared_ptr<zmq::context_t> ctx_);
+	Mesher();
 	~Mesher() = default;
 	
 	void run(msg::on_ready_fn on_ready);
 
 private:
-	bool read_msg(bool wait, std::vector<zmq::message_t>& msg);
+	bool read_msg(bool wait, Message& msg);
 	void handle_all_messages(bool wait_for_first, bool& stop);
-	void on_msg(const std::vector<zmq::message_t>& msg, bool& stop);
-	bool handle_queued_request();
-	void on_mesh_gen_request(std::shared_ptr<MeshGenRequest> req);
-	void update_player_coords(const vmath::ivec2& new_cords);
+	void on_msg(Message& msg, bool& stop);
+	void start_queued_requests();
+	void on_mesh_gen_job_done(std::unique_ptr<mesh_gen_job_result> result);
+	void wait_for_jobs();
+	bool send_held_responses();
+	void on_mesh_gen_request(std::shared_ptr<MeshGenRequest> req, const msg::clock::time_point requested);
+	void update_view(const PlayerView& new_view);
+	void update_render_distance(const int new_render_distance);
+	int priority_of(const vmath::ivec3& coords) const;
+	int distance_to_player(const vmath::ivec3& coords) const;
+	bool needs_lods(const vmath::ivec3& coords) const;
+	bool should_cancel(const vmath::ivec3& coords) const;
+	void cancel_far_requests();
 
 private:
-	std::shared_ptr<zmq::context_t> ctx;
 	BusNode bus;
 
-	// Player's last-known coords (so we always generate meshes closest to here)
-	vmath::ivec2 player_coords;
+	// Player's last-known position, look direction and velocity (so we always mesh what they'll see soonest first)
+	PlayerView view;
+
+	// Player's last-known render distance (-1 = unknown, never cancel requests)
+	int render_distance = -1;
+
+	// Keep queue of incoming requests (closest to player first)
+	indexed_heap<vmath::ivec3, queued_mesh_request, int, vecN_hash> queue;
+
+	// Share meshes between identical minis
+	MeshCache mesh_cache;
+
+	// jobs we've started that haven't sent their mesh back yet
+	// (the count goes down when we get the mesh, the handles are only for waiting on them when we stop, and get cleared out as we go)
+	size_t jobs_in_flight = 0;
+	std::vector<JobHandle> job_handles;
 
-	// Keep queue of incoming requests (based on distance to player)
-	std::priority_queue<pq_entry, std::vector<pq_entry>, std::greater<pq_entry>> pq;
-	std::unordered_map<vmath::ivec3, std::shared_ptr<MeshGenRequest>, vecN_hash> reqs;
+	// meshes that didn't fit in the render thread's inbox, oldest first (we stop meshing until they're sent)
+	std::deque<Message> held_responses;
 };
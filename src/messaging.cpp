@@ -1,58 +1,239 @@
 #include "messaging.h"
 
-#include "zmq_addon.hpp"
+#include "bus_stats.h"
 
+#include <algorithm>
+#include <array>
 #include <future>
-#include <sstream>
+#include <iterator>
+#include <mutex>
+#include <shared_mutex>
 #include <string>
 
 
 namespace msg
 {
-	std::string gen_unique_addr()
+	const char* topic_name(const Topic topic)
 	{
-		// Not actually that random!
-		static std::atomic_uint64_t extra(0);
-		std::string suffix = std::to_string(extra.fetch_add(1)); // TODO: better memory order
-		std::ostringstream out;
-		out << "inproc://unique-" << suffix;
-		return out.str();
+		static constexpr const char* names[] = {
+			"NONE",
+			"READY",
+			"EXIT",
+			"BUS_CREATED",
+			"CONNECTED_TO_BUS",
+			"START",
+			"MESH_GEN_REQUEST",
+			"MESH_GEN_RESPONSE",
+			"CHUNK_GEN_REQUEST",
+			"CHUNK_GEN_RESPONSE",
+			"MINI_GET_REQUEST",
+			"MINI_GET_RESPONSE",
+			"MESH_GEN_CANCELLED",
+			"CHUNK_GEN_CANCELLED",
+			"MESH_LOD_REQUEST",
+			"MESH_GEN_JOB_DONE",
+			"CHUNK_GEN_JOB_DONE",
+			"WATER_SORT_REQUEST",
+			"WATER_SORT_RESPONSE",
+			"PLAYER_INPUT",
+			"PLAYER_BREAK_BLOCK",
+			"PLAYER_PLACE_BLOCK",
+			"EVENT_PLAYER_VIEW_CHANGED",
+			"EVENT_RENDER_DISTANCE_CHANGED",
+		};
+		static_assert(std::size(names) == NUM_TOPICS, "every topic needs a name");
+
+		return topic < NUM_TOPICS ? names[topic] : "UNKNOWN";
 	}
 
-	std::future<void> launch_thread_wait_until_ready(std::shared_ptr<zmq::context_t> ctx, notifier_thread thread)
+	std::future<void> launch_thread_wait_until_ready(notifier_thread thread)
 	{
-		// Listen to bus start
-		std::string unique_addr = gen_unique_addr();
-		zmq::socket_t pull(*ctx, zmq::socket_type::pull);
-		pull.bind(unique_addr);
-
+		std::promise<void> ready;
+		std::future<void> is_ready = ready.get_future();
 		on_ready_fn on_complete = [&]() {
-			zmq::socket_t push(*ctx, zmq::socket_type::push);
-			push.connect(unique_addr);
-			push.send(zmq::buffer(msg::READY));
+			ready.set_value();
 		};
 
 		// Launch
-		std::future<void> result = std::async(std::launch::async, thread, ctx, on_complete);
+		std::future<void> result = std::async(std::launch::async, thread, on_complete);
 
-		// Wait for response
-		std::vector<zmq::message_t> recv_msgs;
-		auto ret = zmq::recv_multipart(pull, std::back_inserter(recv_msgs));
-		assert(ret);
-		assert(recv_msgs[0].to_string_view() == msg::READY);
+		// Wait for it to say it's ready
+		is_ready.wait();
 
 		// Done
 		return result;
 	}
 }
 
-// TODO: Add operator>> and operator<< ? Or maybe add them to zmq.hpp (and submit a PR)?
-BusNode::BusNode(std::shared_ptr<zmq::context_t> ctx_) : ctx(ctx_), in(*ctx_, zmq::socket_type::pub), out(*ctx_, zmq::socket_type::sub) {
-	in.connect(addr::MSG_BUS_IN);
-	out.connect(addr::MSG_BUS_OUT);
+namespace
+{
+	// who's subscribed to what
+	// (only changes when nodes come and go, so sending just takes a shared lock to read it)
+	class BusRouter
+	{
+	public:
+		void subscribe(const std::shared_ptr<BusInbox>& inbox, std::span<const msg::Topic> topics)
+		{
+			std::unique_lock lock(mutex);
+			for (const msg::Topic topic : topics)
+			{
+				assert(topic < msg::NUM_TOPICS);
+				auto& inboxes = subscribers[topic];
+				if (std::find(inboxes.begin(), inboxes.end(), inbox) == inboxes.end())
+				{
+					inboxes.push_back(inbox);
+				}
+			}
+		}
+
+		void remove(const std::shared_ptr<BusInbox>& inbox)
+		{
+			std::unique_lock lock(mutex);
+			for (auto& inboxes : subscribers)
+			{
+				inboxes.erase(std::remove(inboxes.begin(), inboxes.end(), inbox), inboxes.end());
+			}
+		}
+
+		bool send(Message&& message)
+		{
+			assert(message.topic < msg::NUM_TOPICS);
+			TopicStats& stats = bus_stats().topic(message.topic);
+			message.sent = msg::clock::now();
+
+			std::shared_lock lock(mutex);
+			bool result = true;
+
+			const auto& inboxes = subscribers[message.topic];
+			if (inboxes.empty())
+			{
+				stats.sent.fetch_add(1, std::memory_order_relaxed);
+				return result;
+			}
+
+			// only one subscriber and its inbox is full, so the sender still has the message and can try again later
+			if (inboxes.size() == 1 && !push(*inboxes.back(), std::move(message), stats))
+			{
+				stats.full.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			}
+			stats.sent.fetch_add(1, std::memory_order_relaxed);
+			if (inboxes.size() == 1)
+			{
+				return result;
+			}
+
+			// everyone gets a copy, except the last one, who gets the original
+			assert(message.copyable() && "message with uncopyable data has more than one subscriber");
+			for (size_t i = 0; i < inboxes.size(); i++)
+			{
+				const bool is_last = i + 1 == inboxes.size();
+				if (!push(*inboxes[i], is_last ? std::move(message) : message.copy(), stats))
+				{
+					stats.dropped.fetch_add(1, std::memory_order_relaxed);
+					result = false;
+				}
+			}
+
+			return result;
+		}
+
+	private:
+		static bool push(BusInbox& inbox, Message&& message, TopicStats& stats)
+		{
+			// (counted before pushing, so the receiver can't count it as received first)
+			const uint64_t delivered = stats.delivered.fetch_add(1, std::memory_order_relaxed) + 1;
+			if (!inbox.messages.try_push(message))
+			{
+				stats.delivered.fetch_sub(1, std::memory_order_relaxed);
+				return false;
+			}
+
+			inbox.signal.fetch_add(1, std::memory_order_release);
+			inbox.signal.notify_one();
+
+			// (racy, but close enough for a high-water mark)
+			const uint64_t received = stats.received.load(std::memory_order_relaxed);
+			const uint64_t queued = delivered > received ? delivered - received : 0;
+			uint64_t max_queued = stats.max_queued.load(std::memory_order_relaxed);
+			while (queued > max_queued && !stats.max_queued.compare_exchange_weak(max_queued, queued, std::memory_order_relaxed))
+			{
+			}
+			return true;
+		}
+
+		std::shared_mutex mutex;
+		std::array<std::vector<std::shared_ptr<BusInbox>>, msg::NUM_TOPICS> subscribers;
+	};
+
+	BusRouter& bus_router()
+	{
+		static BusRouter router;
+		return router;
+	}
+}
+
+BusNode::BusNode(const size_t capacity) : inbox(std::make_shared<BusInbox>(capacity))
+{
+}
 
-#ifdef HUGE_BUS_NODES
-	bus_in.setsockopt(ZMQ_SNDHWM, 1000 * 1000);
-	bus_out.setsockopt(ZMQ_RCVHWM, 1000 * 1000);
-#endif // HUGE_BUS_NODES
+BusNode::~BusNode()
+{
+	bus_router().remove(inbox);
+}
+
+void BusNode::subscribe(std::span<const msg::Topic> topics)
+{
+	bus_router().subscribe(inbox, topics);
+}
+
+void BusNode::subscribe(std::initializer_list<msg::Topic> topics)
+{
+	subscribe(std::span<const msg::Topic>(topics.begin(), topics.size()));
+}
+
+void BusNode::track_thread(const std::string& name)
+{
+	thread_stats = &bus_stats().add_thread(name);
+}
+
+bool BusNode::send(Message&& message)
+{
+	return bus_router().send(std::move(message));
+}
+
+bool BusNode::recv(Message& message, const bool wait)
+{
+	while (!inbox->messages.try_pop(message))
+	{
+		if (!wait)
+		{
+			return false;
+		}
+
+		// sleep until someone pushes something
+		// (if they push after we looked, signal will have changed, and wait will return right away)
+		const uint32_t seen = inbox->signal.load(std::memory_order_acquire);
+		if (inbox->messages.try_pop(message))
+		{
+			break;
+		}
+
+		const auto wait_start = msg::clock::now();
+		inbox->signal.wait(seen, std::memory_order_acquire);
+		if (thread_stats)
+		{
+			thread_stats->idle_ns.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(msg::clock::now() - wait_start).count(), std::memory_order_relaxed);
+		}
+	}
+
+	TopicStats& stats = bus_stats().topic(message.topic);
+	stats.received.fetch_add(1, std::memory_order_relaxed);
+	stats.send_to_receive.record(msg::clock::now() - message.sent);
+	return true;
+}
+
+size_t BusNode::queued() const
+{
+	return inbox->messages.size_approx();
 }
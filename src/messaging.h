@@ -1,91 +1,299 @@
 #pragma once
 
-#include "zmq.hpp"
+#include "mpsc_ring.h"
 
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <concepts>
+#include <cstdint>
 #include <functional>
 #include <future>
+#include <initializer_list>
+#include <memory>
+#include <span>
 #include <string>
+#include <typeinfo>
+#include <vector>
 
 
-namespace addr
-{
-	static const std::string MSG_BUS_IN = "inproc://bus-in";
-	static const std::string MSG_BUS_OUT = "inproc://bus-out";
-	static const std::string MSG_BUS_CONTROL = "inproc://bus-control";
-}
-
 namespace msg
 {
+	using clock = std::chrono::high_resolution_clock;
 	using on_ready_fn = std::function<void()>;
-	using notifier_thread = std::function<void(std::shared_ptr<zmq::context_t>, on_ready_fn)>;
+	using notifier_thread = std::function<void(on_ready_fn)>;
 
-	// TODO: Shorten all messages since ZMQ uses prefix matching? Or even just use ints!
-#ifdef _DEBUG
-	static const std::string TEST = "TEST";
-#endif
+	// message topics
+	// (one byte each, and the bus keeps its subscribers in a table indexed by topic, so sending never looks at a string)
+	enum Topic : uint8_t
+	{
+		// default-constructed messages
+		NONE = 0,
 
-	// Connection messages - no data
-	static const std::string READY = "READY";
-	static const std::string EXIT = "EXIT";
-	static const std::string BUS_CREATED = "BUS_CREATED";
-	static const std::string CONNECTED_TO_BUS = "CONNECTED_TO_BUS";
-	static const std::string START = "START";
+		// Connection messages - no data
+		READY,
+		EXIT,
+		BUS_CREATED,
+		CONNECTED_TO_BUS,
+		START,
 
-	// Messages with exactly one receiver (usually comes with some heap data)
-	static const std::string MESH_GEN_REQUEST = "MESH_GEN_REQUEST";
-	static const std::string MESH_GEN_RESPONSE = "MESH_GEN_RESPONSE";
-	static const std::string CHUNK_GEN_REQUEST = "CHUNK_GEN_REQUEST";
-	static const std::string CHUNK_GEN_RESPONSE = "CHUNK_GEN_RESPONSE";
-	static const std::string MINI_GET_REQUEST = "MINI_GET_REQUEST";
-	static const std::string MINI_GET_RESPONSE = "MINI_GET_RESPONSE";
+		// Messages with exactly one receiver (usually comes with some heap data, which the receiver takes ownership of)
+		MESH_GEN_REQUEST,
+		MESH_GEN_RESPONSE,
+		CHUNK_GEN_REQUEST,
+		CHUNK_GEN_RESPONSE,
+		MINI_GET_REQUEST,
+		MINI_GET_RESPONSE,
+		MESH_GEN_CANCELLED,
+		CHUNK_GEN_CANCELLED,
+		MESH_LOD_REQUEST,
+		MESH_GEN_JOB_DONE,
+		CHUNK_GEN_JOB_DONE,
+		WATER_SORT_REQUEST,
+		WATER_SORT_RESPONSE,
+		PLAYER_INPUT,
+		PLAYER_BREAK_BLOCK,
+		PLAYER_PLACE_BLOCK,
+
+		// Messages with multiple receivers (every recipent gets a copy of the data)
+		EVENT_PLAYER_VIEW_CHANGED,
+		EVENT_RENDER_DISTANCE_CHANGED,
+
+		NUM_TOPICS
+	};
 
-	// Messages with multiple receivers (every recipent gets a copy of the data)
-	static const std::string EVENT_PLAYER_MOVED_CHUNKS = "EVENT_PLAYER_MOVED_CHUNKS";
+	// topic's name (for debug output)
+	const char* topic_name(const Topic topic);
 
 
-	const std::vector<std::string> meshing_thread_incoming = {
+	// what each thread subscribes to
+	constexpr Topic meshing_thread_incoming[] = {
 		msg::EXIT,
 		msg::MESH_GEN_REQUEST,
+		msg::MESH_GEN_JOB_DONE,
 		msg::MINI_GET_RESPONSE,
-		EVENT_PLAYER_MOVED_CHUNKS
+		EVENT_PLAYER_VIEW_CHANGED,
+		EVENT_RENDER_DISTANCE_CHANGED
 	};
 
-	const std::vector<std::string> chunk_gen_thread_incoming = {
+	constexpr Topic chunk_gen_thread_incoming[] = {
 		msg::EXIT,
 		msg::CHUNK_GEN_REQUEST,
-		EVENT_PLAYER_MOVED_CHUNKS
+		msg::CHUNK_GEN_JOB_DONE,
+		EVENT_PLAYER_VIEW_CHANGED,
+		EVENT_RENDER_DISTANCE_CHANGED
 	};
 
-	const std::vector<std::string> world_thread_incoming = {
+	constexpr Topic world_thread_incoming[] = {
 		msg::EXIT,
 		msg::MINI_GET_REQUEST,
-		msg::CHUNK_GEN_RESPONSE
+		msg::CHUNK_GEN_RESPONSE,
+		msg::CHUNK_GEN_CANCELLED,
+		msg::MESH_GEN_CANCELLED,
+		msg::MESH_LOD_REQUEST
 	};
 
-	const std::vector<std::string> render_thread_incoming = {
+	// (World's own node, for what the player's doing - WorldDataPart has the one above)
+	constexpr Topic world_player_incoming[] = {
+		msg::PLAYER_INPUT,
+		msg::PLAYER_BREAK_BLOCK,
+		msg::PLAYER_PLACE_BLOCK
+	};
+
+	constexpr Topic render_thread_incoming[] = {
+		msg::EXIT,
+		msg::MESH_GEN_RESPONSE,
+		msg::WATER_SORT_RESPONSE
+	};
+
+	constexpr Topic water_sort_thread_incoming[] = {
 		msg::EXIT,
-		msg::MESH_GEN_RESPONSE
+		msg::WATER_SORT_REQUEST
 	};
 
 
-	// zmq_proxy_steerable messages BEGIN
-	static const std::string PAUSE = "PAUSE";
-	static const std::string RESUME = "RESUME";
-	static const std::string TERMINATE = "TERMINATE";
-	// zmq_proxy_steerable messages END
+	// how many messages can be waiting for a bus node before sends to it fail (unless it asks for a different capacity)
+	constexpr size_t BUS_NODE_CAPACITY = 1 << 16;
 
-	std::string gen_unique_addr();
-	std::future<void> launch_thread_wait_until_ready(std::shared_ptr<zmq::context_t> ctx, notifier_thread thread);
+	// launch a thread, and wait until it calls on_ready (i.e. it's subscribed, so nothing sent to it after this returns gets missed)
+	std::future<void> launch_thread_wait_until_ready(notifier_thread thread);
 }
 
+// a message on the bus: a topic and (optionally) some data
+// single-receiver data is passed around as a unique_ptr, so whoever receives it owns it
+// copyable data (e.g. for events) gets copied once per receiver
+class Message
+{
+public:
+	Message() = default;
+
+	explicit Message(const msg::Topic topic_) : topic(topic_)
+	{
+	}
+
+	template<typename T>
+	Message(const msg::Topic topic_, std::unique_ptr<T> data_) : topic(topic_), data(data_.release()), destroy(&destroy_data<T>), type(&typeid(T))
+	{
+	}
+
+	template<std::copy_constructible T>
+	Message(const msg::Topic topic_, const T& value) : topic(topic_), data(new T(value)), destroy(&destroy_data<T>), clone(&clone_data<T>), type(&typeid(T))
+	{
+	}
+
+	Message(const Message&) = delete;
+	Message& operator=(const Message&) = delete;
+
+	Message(Message&& other) noexcept
+	{
+		*this = std::move(other);
+	}
+
+	Message& operator=(Message&& other) noexcept
+	{
+		if (this != &other)
+		{
+			reset();
+			topic = other.topic;
+			data = std::exchange(other.data, nullptr);
+			destroy = std::exchange(other.destroy, nullptr);
+			clone = std::exchange(other.clone, nullptr);
+			type = std::exchange(other.type, nullptr);
+			sent = other.sent;
+		}
+		return *this;
+	}
+
+	~Message()
+	{
+		reset();
+	}
+
+	// take ownership of the data
+	template<typename T>
+	std::unique_ptr<T> take()
+	{
+		assert(data != nullptr && *type == typeid(T) && "message data has the wrong type");
+		destroy = nullptr;
+		clone = nullptr;
+		type = nullptr;
+		return std::unique_ptr<T>(static_cast<T*>(std::exchange(data, nullptr)));
+	}
+
+	template<typename T>
+	const T& get() const
+	{
+		assert(data != nullptr && *type == typeid(T) && "message data has the wrong type");
+		return *static_cast<const T*>(data);
+	}
+
+	bool has_data() const
+	{
+		return data != nullptr;
+	}
+
+	// can this message's data go to more than one receiver?
+	bool copyable() const
+	{
+		return data == nullptr || clone != nullptr;
+	}
+
+	// copy of this message (assumes copyable())
+	Message copy() const
+	{
+		assert(copyable());
+		Message result(topic);
+		if (data != nullptr)
+		{
+			result.data = clone(data);
+			result.destroy = destroy;
+			result.clone = clone;
+			result.type = type;
+		}
+		result.sent = sent;
+		return result;
+	}
+
+	msg::Topic topic = msg::NONE;
+
+	// when it was sent (set by the bus)
+	msg::clock::time_point sent;
+
+private:
+	template<typename T>
+	static void destroy_data(void* data)
+	{
+		delete static_cast<T*>(data);
+	}
+
+	template<typename T>
+	static void* clone_data(const void* data)
+	{
+		return new T(*static_cast<const T*>(data));
+	}
+
+	void reset()
+	{
+		if (data != nullptr)
+		{
+			destroy(data);
+			data = nullptr;
+		}
+	}
+
+	void* data = nullptr;
+	void (*destroy)(void*) = nullptr;
+	void* (*clone)(const void*) = nullptr;
+	const std::type_info* type = nullptr;
+};
+
+// where a bus node's messages wait until it reads them
+struct BusInbox
+{
+	explicit BusInbox(const size_t capacity) : messages(capacity)
+	{
+	}
+
+	MpscRing<Message> messages;
+
+	// bumped after every push, so that the owner can sleep until something arrives
+	std::atomic<uint32_t> signal = 0;
+};
+
+struct ThreadStats;
+
+// a thread's connection to the message bus
+// every node has its own inbox, and sending a message pushes it straight into the inboxes of everyone subscribed to its topic
 class BusNode
 {
 public:
-	BusNode(std::shared_ptr<zmq::context_t> ctx_);
+	// capacity must be a power of 2
+	explicit BusNode(const size_t capacity = msg::BUS_NODE_CAPACITY);
+	~BusNode();
+
+	BusNode(const BusNode&) = delete;
+	BusNode& operator=(const BusNode&) = delete;
+
+	// start receiving messages with these topics
+	void subscribe(std::span<const msg::Topic> topics);
+	void subscribe(std::initializer_list<msg::Topic> topics);
+
+	// count time spent waiting in recv() as this thread being idle (see bus_stats.h)
+	void track_thread(const std::string& name);
+
+	// send to everyone subscribed to this message's topic
+	// returns false if someone's inbox was full (they don't get it)
+	// (if there's only one subscriber and their inbox is full, *message* is left as-is, so it can be sent again later)
+	bool send(Message&& message);
+
+	// read the next message, optionally waiting for one
+	// returns false if there wasn't one
+	bool recv(Message& message, const bool wait = false);
 
-	zmq::socket_t in;
-	zmq::socket_t out;
+	// how many messages are waiting for us
+	size_t queued() const;
 
 private:
-	std::shared_ptr<zmq::context_t> ctx;
+	std::shared_ptr<BusInbox> inbox;
+	ThreadStats* thread_stats = nullptr;
 };
@@ -83,9 +83,10 @@ std::vector<vmath::ivec3> MiniCoords::all_neighbors() {
 
 MiniRender::MiniRender()
 	: MiniCoords(),
-	mesh(nullptr), water_mesh(nullptr), meshes_updated(false),
+	mesh(nullptr), water_mesh(nullptr), meshes_updated(false), lod(0), water_sort_index(-1),
 	quad_data_buf(0), base_coords_buf(0),
 	num_nonwater_quads(0), num_water_quads(0),
+	nonwater_direction_sizes{}, water_direction_sizes{},
 	vao(0), invisible(false)
 {
 }
@@ -93,13 +94,17 @@ MiniRender::MiniRender()
 // Hack for now, will prob remove
 MiniRender::MiniRender(const MiniRender& other)
 	: MiniCoords(other),
-	mesh(other.mesh != nullptr ? std::make_unique<MiniChunkMesh>(*other.mesh) : nullptr),
-	water_mesh(other.water_mesh != nullptr ? std::make_unique<MiniChunkMesh>(*other.water_mesh) : nullptr),
+	mesh(other.mesh),
+	water_mesh(other.water_mesh),
 	meshes_updated(other.meshes_updated),
+	lod(other.lod),
+	water_sort_index(other.water_sort_index),
 	quad_data_buf(other.quad_data_buf), base_coords_buf(other.base_coords_buf),
 	num_nonwater_quads(other.num_nonwater_quads), num_water_quads(other.num_water_quads),
 	vao(other.vao), invisible(other.invisible)
 {
+	std::copy(std::begin(other.nonwater_direction_sizes), std::end(other.nonwater_direction_sizes), std::begin(nonwater_direction_sizes));
+	std::copy(std::begin(other.water_direction_sizes), std::end(other.water_direction_sizes), std::begin(water_direction_sizes));
 }
 
 void MiniRender::set_coords(const vmath::ivec3& coords_)
@@ -112,16 +117,64 @@ void MiniRender::set_coords(const vmath::ivec3& coords_)
 	glNamedBufferStorage(base_coords_buf, sizeof(get_coords()), get_coords(), NULL);
 }
 
-void MiniRender::set_mesh(std::unique_ptr<MiniChunkMesh> mesh_) {
+void MiniRender::set_mesh(std::shared_ptr<const MiniChunkMesh> mesh_) {
 	std::swap(this->mesh, mesh_);
 	meshes_updated = true;
 }
 
-void MiniRender::set_water_mesh(std::unique_ptr<MiniChunkMesh> water_mesh_) {
+void MiniRender::set_water_mesh(std::shared_ptr<const MiniChunkMesh> water_mesh_) {
 	std::swap(this->water_mesh, water_mesh_);
 	meshes_updated = true;
 }
 
+void MiniRender::set_lod_meshes(const int lod_, const MiniChunkLodMeshes& meshes) {
+	assert(1 <= lod_ && lod_ < MESH_LOD_LEVELS);
+	lods[lod_ - 1] = meshes;
+	if (lod_ == lod) {
+		meshes_updated = true;
+	}
+}
+
+int MiniRender::get_lod() const {
+	return lod;
+}
+
+void MiniRender::set_lod(const int lod_) {
+	assert(0 <= lod_ && lod_ < MESH_LOD_LEVELS);
+	if (lod_ != lod) {
+		lod = lod_;
+		meshes_updated = true;
+	}
+}
+
+int MiniRender::num_quads() const {
+	return invisible ? 0 : num_nonwater_quads + num_water_quads;
+}
+
+bool MiniRender::has_lod_meshes() const {
+	return lods[0].mesh != nullptr;
+}
+
+bool MiniRender::has_water() const {
+	return !invisible && current_water_mesh() && current_water_mesh()->size() > 0;
+}
+
+const std::shared_ptr<const MiniChunkMesh>& MiniRender::current_mesh() const {
+	return lod > 0 && lods[lod - 1].mesh ? lods[lod - 1].mesh : mesh;
+}
+
+const std::shared_ptr<const MiniChunkMesh>& MiniRender::current_water_mesh() const {
+	return lod > 0 && lods[lod - 1].water_mesh ? lods[lod - 1].water_mesh : water_mesh;
+}
+
+int MiniRender::get_water_sort_index() const {
+	return water_sort_index;
+}
+
+void MiniRender::set_water_sort_index(const int index) {
+	water_sort_index = index;
+}
+
 bool MiniRender::get_invisible() const {
 	return invisible;
 }
@@ -132,11 +185,30 @@ void MiniRender::set_invisible(const bool invisible) {
 	// TODO: if set to invisible, also mark buffers/vao for deletion?
 }
 
+uint8_t MiniRender::facing_directions(const vmath::vec3& camera_coords) const {
+	const vmath::ivec3 min_corner = real_coords();
+	const vmath::ivec3 max_corner = min_corner + vmath::ivec3(MINICHUNK_WIDTH, MINICHUNK_HEIGHT, MINICHUNK_DEPTH);
+
+	uint8_t result = 0;
+	for (int axis = 0; axis < 3; axis++) {
+		// faces pointing towards -axis can only be seen from before the last one, and vice versa
+		// (liquid tops sit a bit lower than their block, but never below it, so this still holds for them)
+		if (camera_coords[axis] < max_corner[axis]) {
+			result |= 1 << axis;
+		}
+		if (camera_coords[axis] > min_corner[axis]) {
+			result |= 1 << (axis + 3);
+		}
+	}
+
+	return result;
+}
+
 // render this minichunk's texture meshes
-void MiniRender::render_meshes(const OpenGLInfo* glInfo) {
+GLsizei MiniRender::render_meshes(const OpenGLInfo* glInfo, const uint8_t directions) {
 	// don't draw if covered in all sides
 	if (invisible || mesh == nullptr) {
-		return;
+		return 0;
 	}
 
 	// update quads if needed
@@ -146,21 +218,21 @@ void MiniRender::render_meshes(const OpenGLInfo* glInfo) {
 	}
 
 	if (num_nonwater_quads == 0) {
-		return;
+		return 0;
 	}
 
 	// quad VAO
 	glBindVertexArray(vao);
 
 	// DRAW!
-	glDrawArrays(GL_POINTS, 0, num_nonwater_quads);
+	return draw_directions(0, nonwater_direction_sizes, directions);
 }
 
 // render this minichunk's water meshes
-void MiniRender::render_water_meshes(const OpenGLInfo* glInfo) {
+GLsizei MiniRender::render_water_meshes(const OpenGLInfo* glInfo, const uint8_t directions) {
 	// don't draw if covered in all sides
 	if (invisible || water_mesh == nullptr) {
-		return;
+		return 0;
 	}
 
 	// update quads if needed
@@ -170,28 +242,75 @@ void MiniRender::render_water_meshes(const OpenGLInfo* glInfo) {
 	}
 
 	if (num_water_quads == 0) {
-		return;
+		return 0;
 	}
 
 	// quad VAO
 	glBindVertexArray(vao);
 
 	// DRAW!
-	glDrawArrays(GL_POINTS, num_nonwater_quads, num_water_quads);
+	return draw_directions(num_nonwater_quads, water_direction_sizes, directions);
+}
+
+GLsizei MiniRender::draw_directions(const GLint first, const GLsizei(&direction_sizes)[MESH_DIRECTIONS], const uint8_t directions) {
+	// one range per run of neighboring directions we're drawing
+	GLint firsts[MESH_DIRECTIONS];
+	GLsizei counts[MESH_DIRECTIONS];
+	GLsizei num_ranges = 0;
+	GLsizei drawn = 0;
+
+	GLint offset = first;
+	bool extending = false;
+	for (int direction = 0; direction < MESH_DIRECTIONS; direction++) {
+		const GLsizei size = direction_sizes[direction];
+		if (directions & (1 << direction)) {
+			if (extending) {
+				counts[num_ranges - 1] += size;
+			}
+			else {
+				firsts[num_ranges] = offset;
+				counts[num_ranges] = size;
+				num_ranges++;
+				extending = true;
+			}
+			drawn += size;
+		}
+		else {
+			extending = false;
+		}
+		offset += size;
+	}
+
+	if (drawn == 0) {
+		return 0;
+	}
+
+	if (num_ranges == 1) {
+		glDrawArrays(GL_POINTS, firsts[0], counts[0]);
+	}
+	else {
+		glMultiDrawArrays(GL_POINTS, firsts, counts, num_ranges);
+	}
+
+	return drawn;
 }
 
 // assumes mesh lock
 void MiniRender::update_quads_buf(const OpenGLInfo* glInfo) {
-	if (mesh == nullptr || water_mesh == nullptr) {
+	if (current_mesh() == nullptr || current_water_mesh() == nullptr) {
 		throw "bad";
 	}
 
-	auto& quads = mesh->get_quads();
-	auto& water_quads = water_mesh->get_quads();
+	auto& quads = current_mesh()->get_quads();
+	auto& water_quads = current_water_mesh()->get_quads();
 
 	// if no quads, we done
+	// (not invisible though, another level of detail might have some)
 	if (quads.size() + water_quads.size() == 0) {
-		invisible = true;
+		num_nonwater_quads = 0;
+		num_water_quads = 0;
+		std::fill(std::begin(nonwater_direction_sizes), std::end(nonwater_direction_sizes), 0);
+		std::fill(std::begin(water_direction_sizes), std::end(water_direction_sizes), 0);
 		return;
 	}
 
@@ -199,6 +318,10 @@ void MiniRender::update_quads_buf(const OpenGLInfo* glInfo) {
 
 	num_nonwater_quads = quads.size();
 	num_water_quads = water_quads.size();
+	for (int direction = 0; direction < MESH_DIRECTIONS; direction++) {
+		nonwater_direction_sizes[direction] = current_mesh()->direction_size(direction);
+		water_direction_sizes[direction] = current_water_mesh()->direction_size(direction);
+	}
 
 	// map
 	Quad3D* gpu_quads = (Quad3D*)glMapNamedBufferRange(quad_data_buf, 0, sizeof(Quad3D) * (quads.size() + water_quads.size()), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_FLUSH_EXPLICIT_BIT);
@@ -284,6 +407,7 @@ void MiniRender::recreate_vao(const OpenGLInfo* glInfo, const GLuint size) {
 	glEnableVertexArrayAttrib(vao, glInfo->q_base_coords_attr_idx);
 	glEnableVertexArrayAttrib(vao, glInfo->q_lighting_attr_idx);
 	glEnableVertexArrayAttrib(vao, glInfo->q_metadata_attr_idx);
+	glEnableVertexArrayAttrib(vao, glInfo->q_liquid_drops_attr_idx);
 
 	// vao: set up formats for Quad's attributes, 1 at a time
 	glVertexArrayAttribIFormat(vao, glInfo->q_block_type_attr_idx, 1, GL_UNSIGNED_BYTE, offsetof(Quad3D, block));
@@ -292,6 +416,7 @@ void MiniRender::recreate_vao(const OpenGLInfo* glInfo, const GLuint size) {
 	glVertexArrayAttribIFormat(vao, glInfo->q_face_attr_idx, 3, GL_INT, offsetof(Quad3D, face));
 	glVertexArrayAttribIFormat(vao, glInfo->q_lighting_attr_idx, 1, GL_UNSIGNED_BYTE, offsetof(Quad3D, lighting));
 	glVertexArrayAttribIFormat(vao, glInfo->q_metadata_attr_idx, 1, GL_UNSIGNED_BYTE, offsetof(Quad3D, metadata));
+	glVertexArrayAttribIFormat(vao, glInfo->q_liquid_drops_attr_idx, 1, GL_UNSIGNED_SHORT, offsetof(Quad3D, liquid_drops));
 
 	glVertexArrayAttribIFormat(vao, glInfo->q_base_coords_attr_idx, 3, GL_INT, 0);
 
@@ -302,6 +427,7 @@ void MiniRender::recreate_vao(const OpenGLInfo* glInfo, const GLuint size) {
 	glVertexArrayAttribBinding(vao, glInfo->q_face_attr_idx, glInfo->quad_data_bidx);
 	glVertexArrayAttribBinding(vao, glInfo->q_lighting_attr_idx, glInfo->quad_data_bidx);
 	glVertexArrayAttribBinding(vao, glInfo->q_metadata_attr_idx, glInfo->quad_data_bidx);
+	glVertexArrayAttribBinding(vao, glInfo->q_liquid_drops_attr_idx, glInfo->quad_data_bidx);
 
 	glVertexArrayAttribBinding(vao, glInfo->q_base_coords_attr_idx, glInfo->q_base_coords_bidx);
 
@@ -55,10 +55,17 @@ public:
 class MiniRender : public MiniCoords
 {
 private:
-	std::unique_ptr<MiniChunkMesh> mesh;
-	std::unique_ptr<MiniChunkMesh> water_mesh;
+	std::shared_ptr<const MiniChunkMesh> mesh;
+	std::shared_ptr<const MiniChunkMesh> water_mesh;
+	MiniChunkLodMeshes lods[MESH_LOD_LEVELS - 1];
 	bool meshes_updated;
 
+	// which level of detail is in the buffer
+	int lod;
+
+	// where we are in the last back-to-front water sort the renderer got (-1 = not in it)
+	int water_sort_index;
+
 	// TODO: When someone else sets invisibility, we want to delete bufs as well.
 	GLuint quad_data_buf;
 	GLuint base_coords_buf;
@@ -67,6 +74,10 @@ private:
 	GLuint num_nonwater_quads;
 	GLuint num_water_quads;
 
+	// number of quads facing each direction inside the buffer (each direction's quads are contiguous)
+	GLsizei nonwater_direction_sizes[MESH_DIRECTIONS];
+	GLsizei water_direction_sizes[MESH_DIRECTIONS];
+
 	// vao
 	GLuint vao;
 
@@ -80,25 +91,57 @@ public:
 
 	virtual  void set_coords(const vmath::ivec3& coords_);
 
-	void set_mesh(std::unique_ptr<MiniChunkMesh> mesh_);
+	void set_mesh(std::shared_ptr<const MiniChunkMesh> mesh_);
+
+	void set_water_mesh(std::shared_ptr<const MiniChunkMesh> water_mesh_);
+
+	// set meshes for a coarser level of detail (1 to MESH_LOD_LEVELS - 1)
+	void set_lod_meshes(const int lod_, const MiniChunkLodMeshes& meshes);
+
+	int get_lod() const;
+
+	// switch which level of detail we draw
+	void set_lod(const int lod_);
+
+	// whether we got coarser meshes with our last mesh (minis close to the player are only meshed at full resolution)
+	bool has_lod_meshes() const;
 
-	void set_water_mesh(std::unique_ptr<MiniChunkMesh> water_mesh_);
+	// how many quads we're drawing
+	int num_quads() const;
+
+	// check if we have any water to draw (at our current level of detail)
+	bool has_water() const;
+
+	int get_water_sort_index() const;
+	void set_water_sort_index(const int index);
 
 	bool get_invisible() const;
 
 	void set_invisible(const bool invisible);
 
-	// render this minichunk's texture meshes
-	void render_meshes(const OpenGLInfo* glInfo);
+	// which face directions could be facing a camera here, as a bitmask
+	// (if the camera's fully on one side of our bounding box, faces pointing the other way can't be seen)
+	uint8_t facing_directions(const vmath::vec3& camera_coords) const;
 
-	// render this minichunk's water meshes
-	void render_water_meshes(const OpenGLInfo* glInfo);
+	// render this minichunk's texture meshes (only the faces pointing in these directions), and return how many quads were drawn
+	GLsizei render_meshes(const OpenGLInfo* glInfo, const uint8_t directions = ALL_FACE_DIRECTIONS);
+
+	// render this minichunk's water meshes (only the faces pointing in these directions), and return how many quads were drawn
+	GLsizei render_water_meshes(const OpenGLInfo* glInfo, const uint8_t directions = ALL_FACE_DIRECTIONS);
 
 	// assumes mesh lock
 	void update_quads_buf(const OpenGLInfo* glInfo);
 
+	// meshes at our current level of detail (falls back to full resolution if we don't have that level)
+	const std::shared_ptr<const MiniChunkMesh>& current_mesh() const;
+	const std::shared_ptr<const MiniChunkMesh>& current_water_mesh() const;
+
 	// TODO: remove this from render.cpp?
 	void recreate_vao(const OpenGLInfo* glInfo, const GLuint size);
+
+private:
+	// draw the ranges of these directions' quads, starting from the quad at *first*
+	GLsizei draw_directions(const GLint first, const GLsizei(&direction_sizes)[MESH_DIRECTIONS], const uint8_t directions);
 };
 
 class MiniChunk : public MiniCoords, public ChunkData
@@ -112,4 +155,8 @@ public:
 	MiniChunk(MiniChunk&& other) = delete;
 
 	char* print_layer(int face, int layer);
+
+	// the last epoch a mesh request pinned this version in (0 = never), so the world knows whether it has to copy it before writing (see Chunk::writable_mini)
+	// (a copy starts out unpinned)
+	uint64_t pinned_epoch = 0;
 };
@@ -1,5 +1,19 @@
 #include "minichunkmesh.h"
 
+#include <cassert>
+
+int face_direction(const vmath::ivec3& face)
+{
+	for (int axis = 0; axis < 3; axis++) {
+		if (face[axis] != 0) {
+			return face[axis] < 0 ? axis : axis + 3;
+		}
+	}
+
+	assert(false && "quad doesn't face anywhere");
+	return 0;
+}
+
 // A mesh of a minichunk, consisting of a bunch of quads & minichunk coordinates
 int MiniChunkMesh::size() const
 {
@@ -13,5 +27,31 @@ const std::vector<Quad3D>& MiniChunkMesh::get_quads() const
 
 void MiniChunkMesh::add_quad(const Quad3D& quad)
 {
-	quads3d.push_back(quad);
+	// put it at the end of its direction's range
+	// (the mesher adds quads one direction at a time, so this is almost always the end of the mesh)
+	const int direction = face_direction(quad.face);
+	const int end = direction_offset(direction) + direction_sizes[direction];
+	if (end == quads3d.size()) {
+		quads3d.push_back(quad);
+	}
+	else {
+		quads3d.insert(quads3d.begin() + end, quad);
+	}
+	direction_sizes[direction]++;
+}
+
+int MiniChunkMesh::direction_offset(const int direction) const
+{
+	assert(0 <= direction && direction < MESH_DIRECTIONS);
+	int offset = 0;
+	for (int i = 0; i < direction; i++) {
+		offset += direction_sizes[i];
+	}
+	return offset;
+}
+
+int MiniChunkMesh::direction_size(const int direction) const
+{
+	assert(0 <= direction && direction < MESH_DIRECTIONS);
+	return direction_sizes[direction];
 }
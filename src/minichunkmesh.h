@@ -4,15 +4,48 @@
 
 #include "vmath.h"
 
+#include <cstdint>
+#include <memory>
 #include <vector>
 
+// levels of detail a mini gets meshed at: 0 = full resolution, and each level after that halves the resolution
+constexpr int MESH_LOD_LEVELS = 3;
+
+// past this many chunks away, minis are drawn at the next coarser level of detail
+// (minis closer than the first one are only meshed at full resolution, see Mesher::needs_lods)
+constexpr float LOD_DISTANCES[MESH_LOD_LEVELS - 1] = { 8.0f, 16.0f };
+
+// how many chunks past a LOD distance you have to go to switch levels, so that minis on the boundary don't keep switching back and forth
+constexpr float LOD_HYSTERESIS = 1.0f;
+
+// number of directions a quad can face
+constexpr int MESH_DIRECTIONS = 6;
+
+// index of the direction a quad faces, in the order meshes keep their quads in: -x, -y, -z, +x, +y, +z
+int face_direction(const vmath::ivec3& face);
+
+// bitmask with every direction set (bit i = direction i)
+constexpr uint8_t ALL_FACE_DIRECTIONS = (1 << MESH_DIRECTIONS) - 1;
+
 // A mesh of a minichunk, consisting of a bunch of quads & minichunk coordinates
+// (quads are kept grouped by face direction, so that each direction can be drawn or skipped as one range)
 class MiniChunkMesh {
 public:
 	int size() const;
 	const std::vector<Quad3D>& get_quads() const;
 	void add_quad(const Quad3D& quad);
 
+	// where a direction's quads start, and how many there are
+	int direction_offset(const int direction) const;
+	int direction_size(const int direction) const;
+
 private:
 	std::vector<Quad3D> quads3d;
+	int direction_sizes[MESH_DIRECTIONS] = {};
+};
+
+// a mini's meshes at one (coarser) level of detail
+struct MiniChunkLodMeshes {
+	std::shared_ptr<const MiniChunkMesh> mesh;
+	std::shared_ptr<const MiniChunkMesh> water_mesh;
 };
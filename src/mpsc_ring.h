@@ -0,0 +1,107 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+// bounded lock-free queue: any number of threads can push, one thread pops
+// (each slot has a sequence number saying whose turn it is, so producers only contend on the tail counter)
+template<typename T>
+class MpscRing
+{
+public:
+	// capacity must be a power of 2
+	explicit MpscRing(const size_t capacity) : mask(capacity - 1), slots(std::make_unique<Slot[]>(capacity))
+	{
+		assert(capacity >= 2 && (capacity & (capacity - 1)) == 0 && "capacity must be a power of 2");
+		for (size_t i = 0; i < capacity; i++)
+		{
+			slots[i].sequence.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	MpscRing(const MpscRing&) = delete;
+	MpscRing& operator=(const MpscRing&) = delete;
+
+	// push unless full (value is only moved from if this returns true)
+	bool try_push(T& value)
+	{
+		size_t pos = tail.load(std::memory_order_relaxed);
+		while (true)
+		{
+			Slot& slot = slots[pos & mask];
+			const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+			const ptrdiff_t diff = static_cast<ptrdiff_t>(sequence) - static_cast<ptrdiff_t>(pos);
+
+			// slot's free => try to claim it
+			if (diff == 0)
+			{
+				if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				{
+					slot.value = std::move(value);
+					slot.sequence.store(pos + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			// consumer hasn't gotten to it yet => full
+			else if (diff < 0)
+			{
+				return false;
+			}
+			// someone else claimed it => try the next one
+			else
+			{
+				pos = tail.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	// pop unless empty (only call from the consumer thread)
+	bool try_pop(T& value)
+	{
+		const size_t pos = head.load(std::memory_order_relaxed);
+		Slot& slot = slots[pos & mask];
+		const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+		if (sequence != pos + 1)
+		{
+			return false;
+		}
+
+		value = std::move(slot.value);
+		slot.value = T();
+		slot.sequence.store(pos + mask + 1, std::memory_order_release);
+		head.store(pos + 1, std::memory_order_relaxed);
+		return true;
+	}
+
+	size_t capacity() const
+	{
+		return mask + 1;
+	}
+
+	// roughly how many values are waiting (exact if nobody's pushing or popping)
+	size_t size_approx() const
+	{
+		const size_t h = head.load(std::memory_order_relaxed);
+		const size_t t = tail.load(std::memory_order_relaxed);
+		return t > h ? t - h : 0;
+	}
+
+private:
+	// keep producers' and consumer's counters on separate cache lines
+	static constexpr size_t CACHE_LINE = 64;
+
+	struct Slot
+	{
+		std::atomic<size_t> sequence;
+		T value;
+	};
+
+	const size_t mask;
+	std::unique_ptr<Slot[]> slots;
+
+	alignas(CACHE_LINE) std::atomic<size_t> tail = 0;
+	alignas(CACHE_LINE) std::atomic<size_t> head = 0; // only the consumer writes this
+};
@@ -14,6 +14,22 @@ struct Actions
 	bool jumping = false;
 	bool shifting = false;
 	bool mining = false;
+
+	bool operator==(const Actions&) const = default;
+};
+
+// what the player's asking for, as of the last frame
+// the render thread owns it (keys and mouse change it right away, so the camera never waits on the world), and sends it to the world whenever it changes
+struct PlayerInput
+{
+	Actions actions;
+	float pitch = 0;
+	float yaw = 0;
+	BlockType held_block = BlockType::StillWater;
+	int render_distance = 1;
+	bool noclip = false;
+
+	bool operator==(const PlayerInput&) const = default;
 };
 
 class Player
@@ -45,7 +61,7 @@ public:
 	bool in_water = false;
 	bool noclip = false;
 
-	// Both. Update in renderer then reflect in world
+	// Both. Update in renderer (PlayerInput) then reflect in world
 	float pitch = 0;
 	float yaw = 0;
 	BlockType held_block = BlockType::StillWater; // TODO: Instead, remembering which inventory slot
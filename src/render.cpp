@@ -137,6 +137,7 @@ namespace {
 		glEnableVertexArrayAttrib(glInfo->vao_quad, glInfo->q_base_coords_attr_idx);
 		glEnableVertexArrayAttrib(glInfo->vao_quad, glInfo->q_lighting_attr_idx);
 		glEnableVertexArrayAttrib(glInfo->vao_quad, glInfo->q_metadata_attr_idx);
+		glEnableVertexArrayAttrib(glInfo->vao_quad, glInfo->q_liquid_drops_attr_idx);
 
 		// vao: set up formats for Quad's attributes, 1 at a time
 		glVertexArrayAttribIFormat(glInfo->vao_quad, glInfo->q_block_type_attr_idx, 1, GL_UNSIGNED_BYTE, offsetof(Quad3D, block));
@@ -145,6 +146,7 @@ namespace {
 		glVertexArrayAttribIFormat(glInfo->vao_quad, glInfo->q_face_attr_idx, 3, GL_INT, offsetof(Quad3D, face));
 		glVertexArrayAttribIFormat(glInfo->vao_quad, glInfo->q_lighting_attr_idx, 1, GL_UNSIGNED_BYTE, offsetof(Quad3D, lighting));
 		glVertexArrayAttribIFormat(glInfo->vao_quad, glInfo->q_metadata_attr_idx, 1, GL_UNSIGNED_BYTE, offsetof(Quad3D, metadata));
+		glVertexArrayAttribIFormat(glInfo->vao_quad, glInfo->q_liquid_drops_attr_idx, 1, GL_UNSIGNED_SHORT, offsetof(Quad3D, liquid_drops));
 
 		glVertexArrayAttribIFormat(glInfo->vao_quad, glInfo->q_base_coords_attr_idx, 3, GL_INT, 0);
 
@@ -155,6 +157,7 @@ namespace {
 		glVertexArrayAttribBinding(glInfo->vao_quad, glInfo->q_face_attr_idx, glInfo->quad_data_bidx);
 		glVertexArrayAttribBinding(glInfo->vao_quad, glInfo->q_lighting_attr_idx, glInfo->quad_data_bidx);
 		glVertexArrayAttribBinding(glInfo->vao_quad, glInfo->q_metadata_attr_idx, glInfo->quad_data_bidx);
+		glVertexArrayAttribBinding(glInfo->vao_quad, glInfo->q_liquid_drops_attr_idx, glInfo->quad_data_bidx);
 
 		glVertexArrayAttribBinding(glInfo->vao_quad, glInfo->q_base_coords_attr_idx, glInfo->q_base_coords_bidx);
 
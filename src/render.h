@@ -106,6 +106,7 @@ struct OpenGLInfo {
 	const GLuint q_base_coords_attr_idx = 6;
 	const GLuint q_lighting_attr_idx = 7;
 	const GLuint q_metadata_attr_idx = 8;
+	const GLuint q_liquid_drops_attr_idx = 9;
 };
 
 // packed so that quads match quads on GPU
@@ -115,8 +116,9 @@ struct Quad3D {
 	vmath::ivec3 corner1;
 	vmath::ivec3 corner2;
 	vmath::ivec3 face;
-	uint8_t lighting; // left 4 bits: sunlight. right 4 bits: torchlight.
+	uint8_t lighting; // ambient occlusion, 2 bits per vertex (0 = open, 3 = fully occluded), in the order the geometry shader emits them
 	uint8_t metadata; // other metadata that a block can have. Should never use more than 4 bits.
+	uint16_t liquid_drops; // how far each vertex of a liquid sits below the block's top, in eighths, 4 bits per vertex (same order as lighting)
 };
 #pragma pack(pop)
 
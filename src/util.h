@@ -5,6 +5,7 @@
 #include "imgui.h"
 #include "vmath.h"
 
+#include <algorithm>
 #include <atomic>
 #include <chrono>
 #include <cmath>
@@ -14,7 +15,6 @@
 #include <map>
 #include <memory>
 #include <numeric>
-#include <queue>
 #include <random>
 #include <string>
 #include <tuple>
@@ -359,18 +359,30 @@ public:
 		return my_map.begin();
 	}
 
+	inline auto begin() const {
+		return my_map.begin();
+	}
+
 	// end of elements
 	// O(1)
 	inline auto end() {
 		return my_map.end();
 	}
 
+	inline auto end() const {
+		return my_map.end();
+	}
+
 	// get iterator containing key `k`
 	// O(log N)
 	inline auto get_interval(K const& k) {
 		return --my_map.upper_bound(k);
 	}
 
+	inline auto get_interval(K const& k) const {
+		return --my_map.upper_bound(k);
+	}
+
 	// get value at key `k`
 	// O(log N)
 	const inline V& operator[](K const& k) const {
@@ -385,7 +397,7 @@ public:
 
 	// get num intervals overall
 	// always at least 1
-	inline auto num_intervals() {
+	inline auto num_intervals() const {
 		return my_map.size();
 	}
 
@@ -396,46 +408,6 @@ public:
 	}
 };
 
-template<
-	class T,
-	class Container = std::vector<T>,
-	class Compare = std::less<typename Container::value_type>
->
-class priority_queue_hacker : public std::priority_queue<T, Container, Compare>
-{
-public:
-	Container& get_c()
-	{
-		return this->c;
-	}
-
-	Compare& get_comp()
-	{
-		return this->comp;
-	}
-};
-
-template<class T, class Container, class Compare>
-void update_pq_priorities(std::priority_queue<T, Container, Compare>& pq, std::function<void(T&)>& update)
-{
-	// Get container
-	priority_queue_hacker<T, Container, Compare> hacker;
-	hacker.swap(pq);
-	Container& c = hacker.get_c();
-
-	// Update priorities
-	for (auto& entry : c)
-	{
-		update(entry);
-	}
-
-	// Fix heap
-	std::make_heap(c.begin(), c.end(), hacker.get_comp());
-
-	// Stick it back in
-	pq.swap(hacker);
-}
-
 // Destructor for GLFWwindow, allows you to use GLFWwindow* with a smart pointer.
 // TODO: Just write an object-oriented wrapper class for GLFWwindow that handles this.
 struct DestroyGlfwWin
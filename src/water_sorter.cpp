@@ -0,0 +1,109 @@
+#include "water_sorter.h"
+
+#include "bus_stats.h"
+#include "minichunk.h"
+
+#include <algorithm>
+#include <cassert>
+
+
+using namespace vmath;
+using namespace std;
+
+
+void WaterSortThread(msg::on_ready_fn on_ready)
+{
+	WaterSorter s;
+	s.run(on_ready);
+}
+
+WaterSorter::WaterSorter()
+{
+	bus.subscribe(msg::water_sort_thread_incoming);
+	bus.track_thread("water sorter");
+}
+
+// thread for sorting water minis
+void WaterSorter::run(msg::on_ready_fn on_ready) {
+	// Prove you're connected
+	on_ready();
+
+	// Run thread until stopped
+	bool stop = false;
+	while (!stop)
+	{
+		// Wait for requests, keeping only the latest
+		handle_all_messages(stop);
+		if (stop) break;
+
+		handle_request();
+	}
+}
+
+void WaterSorter::handle_all_messages(bool& stop)
+{
+	Message msg;
+	bool wait = true;
+	while (read_msg(wait, msg))
+	{
+		on_msg(msg, stop);
+		wait = false;
+		if (stop) break;
+	}
+}
+
+void WaterSorter::on_msg(Message& msg, bool& stop)
+{
+	switch (msg.topic)
+	{
+	case msg::EXIT:
+		stop = true;
+		break;
+	case msg::WATER_SORT_REQUEST:
+		req = msg.take<WaterSortRequest>();
+		req_sent = msg.sent;
+		assert(req);
+		break;
+	default:
+#ifndef _DEBUG
+		WindowsException("unknown message");
+#endif // _DEBUG
+		break;
+	}
+}
+
+bool WaterSorter::read_msg(bool wait, Message& msg)
+{
+	return bus.recv(msg, wait);
+}
+
+void WaterSorter::handle_request()
+{
+	if (!req)
+	{
+		return;
+	}
+
+	// sort by distance to mini centers, furthest first
+	std::vector<std::pair<float, uint32_t>> distances;
+	distances.reserve(req->minis.size());
+	for (uint32_t i = 0; i < req->minis.size(); i++)
+	{
+		const vmath::vec3 diff = MiniCoords(req->minis[i]).center_coords_v3() - req->camera_coords;
+		distances.emplace_back(vmath::dot(diff, diff), i);
+	}
+	std::sort(distances.begin(), distances.end(), [](const auto& lhs, const auto& rhs) { return lhs.first > rhs.first; });
+
+	auto response = std::make_unique<WaterSortResponse>();
+	response->frame = req->frame;
+	response->order.reserve(distances.size());
+	for (const auto& [distance, i] : distances)
+	{
+		response->order.push_back(i);
+	}
+	req.reset();
+
+	// send it (if the render thread's inbox is full, it'll ask again next frame)
+	bus.send(Message(msg::WATER_SORT_RESPONSE, std::move(response)));
+	bus_stats().topic(msg::WATER_SORT_REQUEST).request_to_response.record(msg::clock::now() - req_sent);
+}
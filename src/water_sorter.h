@@ -0,0 +1,53 @@
+#pragma once
+
+#include "messaging.h"
+
+#include "vmath.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+void WaterSortThread(msg::on_ready_fn on_ready);
+
+// minis with water that the render thread's drawing, and where it's drawing them from
+struct WaterSortRequest
+{
+	// which frame this is for (so the render thread can tell which request a response answers)
+	uint64_t frame;
+	vmath::vec3 camera_coords;
+	std::vector<vmath::ivec3> minis;
+};
+
+// same minis, sorted back-to-front (furthest from the camera first)
+struct WaterSortResponse
+{
+	uint64_t frame;
+
+	// indices into the request's minis, so the render thread doesn't have to look anything up
+	std::vector<uint32_t> order;
+};
+
+// sort water minis back-to-front off the render thread, so that water can be blended in the right order
+// (the render thread uses whatever order came back last, so it's usually a frame behind)
+class WaterSorter
+{
+public:
+	WaterSorter();
+	~WaterSorter() = default;
+
+	void run(msg::on_ready_fn on_ready);
+
+private:
+	bool read_msg(bool wait, Message& msg);
+	void handle_all_messages(bool& stop);
+	void on_msg(Message& msg, bool& stop);
+	void handle_request();
+
+private:
+	BusNode bus;
+
+	// latest request (older ones are stale, so we drop them)
+	std::unique_ptr<WaterSortRequest> req;
+	msg::clock::time_point req_sent;
+};
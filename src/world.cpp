@@ -10,14 +10,14 @@
 #include "util.h"
 
 #include "vmath.h"
-#include "zmq_addon.hpp"
 
+#include <algorithm>
 #include <cassert>
 #include <chrono>
 #include <condition_variable>
 #include <functional>
-#include <queue>
 #include <string>
+#include <thread>
 #include <tuple>
 #include <unordered_map>
 #include <unordered_set>
@@ -30,17 +30,42 @@
 // radius from center of minichunk that must be included in view frustum
 constexpr float FRUSTUM_MINI_RADIUS_ALLOWANCE = 28.0f;
 
-WorldDataPart::WorldDataPart(std::shared_ptr<zmq::context_t> ctx_) : bus(ctx_)
+// minimum number of ticks a deferred chunk waits before being meshed, so that requests that come in close together get merged
+constexpr int MESH_COALESCE_TICKS = 1;
+
+namespace
 {
-#ifdef _DEBUG
-	bus.out.setsockopt(ZMQ_SUBSCRIBE, "", 0);
-#else
-	for (const auto& m : msg::world_thread_incoming)
-	{
-		// TODO: Upgrade zmq and replace this with .set()
-		bus.out.setsockopt(ZMQ_SUBSCRIBE, m.c_str(), m.size());
+	vmath::ivec2 chunk_coords_of(const vmath::ivec2& chunk_coords) { return chunk_coords; }
+	vmath::ivec2 chunk_coords_of(const vmath::ivec3& mini_coords) { return { mini_coords[0], mini_coords[2] }; }
+
+	// take (up to) *count* coords out of *held_back*, the ones the player will see soonest first
+	template<typename T>
+	std::vector<T> take_first(std::unordered_set<T, vecN_hash>& held_back, const PlayerView& view, const size_t count) {
+		std::vector<T> result(held_back.begin(), held_back.end());
+		if (result.size() > count) {
+			std::vector<std::pair<int, T>> prioritized;
+			prioritized.reserve(result.size());
+			for (const auto& coords : result) {
+				prioritized.emplace_back(view_priority(view, chunk_coords_of(coords)), coords);
+			}
+			std::nth_element(prioritized.begin(), prioritized.begin() + count, prioritized.end(), [](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first; });
+
+			result.resize(count);
+			for (size_t i = 0; i < count; i++) {
+				result[i] = prioritized[i].second;
+			}
+		}
+
+		for (const auto& coords : result) {
+			held_back.erase(coords);
+		}
+		return result;
 	}
-#endif // _DEBUG
+}
+
+WorldDataPart::WorldDataPart() : liquids([this](const vmath::ivec2& coords) { return get_chunk(coords); }, &job_system())
+{
+	bus.subscribe(msg::world_thread_incoming);
 }
 
 // update tick to *new_tick*
@@ -52,55 +77,208 @@ void WorldDataPart::update_tick(const int new_tick) {
 
 	current_tick = new_tick;
 
-	// propagate any water we need to propagate
-	while (!water_propagation_queue.empty()) {
-		// get item from queue
-		const auto& [tick, xyz] = water_propagation_queue.top();
+	// move liquids along (up to the budget, the rest waits for the next tick), and remember what they changed
+	liquids.update(current_tick);
+	for (const auto& xyz : liquids.take_changed_blocks()) {
+		block_changes.record_block(xyz);
+	}
+}
 
-		// if tick is in the future, ignore
-		if (tick > current_tick) {
-			break;
-		}
+// remesh every mini that the changes since the last flush affect, once each
+void WorldDataPart::flush_block_changes() {
+	num_block_changes_last_flush = block_changes.num_changes();
+	num_remeshes_last_flush = 0;
+	if (block_changes.empty()) {
+		return;
+	}
 
-		// do it
-		water_propagation_queue.pop();
-		propagate_water(xyz[0], xyz[1], xyz[2]);
+	for (const auto& coords : block_changes.take_dirty_minis()) {
+		MiniChunk* mini = get_mini(coords);
+		if (mini != nullptr) {
+			enqueue_mesh_gen(mini, true);
+			num_remeshes_last_flush++;
+		}
 	}
 }
 
 // enqueue mesh generation of this mini
 // expects mesh lock
-void WorldDataPart::enqueue_mesh_gen(std::shared_ptr<MiniChunk> mini, const bool front_of_queue) {
+void WorldDataPart::enqueue_mesh_gen(MiniChunk* mini, const bool front_of_queue) {
 	assert(mini != nullptr && "seriously?");
 
+	// player's changes skip the line (there's only ever a handful of those)
+	if (front_of_queue) {
+		held_back_meshes.erase(mini->get_coords());
+		send_mesh_gen(mini);
+		return;
+	}
+
+	// otherwise wait for room at the mesher (this also merges repeated requests)
+	held_back_meshes.insert(mini->get_coords());
+}
+
+// ask the mesher to mesh this mini right away
+void WorldDataPart::send_mesh_gen(MiniChunk* mini) {
+	num_mesh_requests++;
+
 	// check if mini in set
-	MeshGenRequest* req = new MeshGenRequest();
+	auto req = std::make_unique<MeshGenRequest>();
 	req->coords = mini->get_coords();
 	req->data = std::make_shared<MeshGenRequestData>();
 	req->data->self = mini;
 
-#define ADD(ATTR, DIRECTION)\
-		{\
-			std::shared_ptr<MiniChunk> minip_ = get_mini(mini->get_coords() + DIRECTION);\
-			req->data->ATTR = minip_;\
+	// the mesher reads these minis without locking or refcounting, so until it's done with the request, writes to them go to copies (see Chunk::writable_mini)
+	req->data->pin = mini_epochs().pin();
+	const uint64_t epoch = req->data->pin.epoch();
+	mini->pinned_epoch = epoch;
+
+	// grab our 3x3 chunks once, then fill in every mini touching us (faces for culling, edges and corners for ambient occlusion)
+	const vmath::ivec3 coords = mini->get_coords();
+	for (int dx = -1; dx <= 1; dx++) {
+		for (int dz = -1; dz <= 1; dz++) {
+			std::shared_ptr<Chunk> chunk = get_chunk(coords[0] + dx, coords[2] + dz);
+			if (chunk == nullptr) {
+				continue;
+			}
+
+			for (int dy = -1; dy <= 1; dy++) {
+				const vmath::ivec3 offset = { dx, dy, dz };
+				const int num_nonzero = (dx != 0) + (dy != 0) + (dz != 0);
+				MiniChunk* neighbor = chunk->get_mini_with_y_level(coords[1] + dy * MINICHUNK_HEIGHT);
+				if (neighbor != nullptr) {
+					neighbor->pinned_epoch = epoch;
+				}
+
+				if (num_nonzero >= 2) {
+					req->data->edges_and_corners[dx + 1][dy + 1][dz + 1] = neighbor;
+				}
+				else if (offset == IEAST) req->data->east = neighbor;
+				else if (offset == IWEST) req->data->west = neighbor;
+				else if (offset == IUP) req->data->up = neighbor;
+				else if (offset == IDOWN) req->data->down = neighbor;
+				else if (offset == ISOUTH) req->data->south = neighbor;
+				else if (offset == INORTH) req->data->north = neighbor;
+			}
 		}
+	}
 
-	ADD(up, IUP * 16);
-	ADD(down, IDOWN * 16);
-	ADD(east, IEAST);
-	ADD(west, IWEST);
-	ADD(north, INORTH);
-	ADD(south, ISOUTH);
-#undef ADD
-
-	// TODO: Figure out how to do zero-copy messaging since we don't need to copy msg::MESH_GEN_REQ (it's static const)
-	std::vector<zmq::const_buffer> message({
-		zmq::buffer(msg::MESH_GEN_REQUEST),
-		zmq::buffer(&req, sizeof(req))
+	mesh_gen_stats().messages++;
+	mesh_gen_stats().in_flight++;
+	auto ret = bus.send(Message(msg::MESH_GEN_REQUEST, std::move(req)));
+	assert(ret);
+}
+
+// send as many held back requests as the chunker and mesher have room for, closest to the player first
+void WorldDataPart::send_held_back_requests() {
+	send_held_back_chunks();
+	send_held_back_meshes();
+}
+
+void WorldDataPart::send_held_back_chunks() {
+	if (!held_back_chunks.empty() && pending_chunks.size() < CHUNK_GEN_CAPACITY) {
+		gen_chunks(take_first(held_back_chunks, player_view, CHUNK_GEN_CAPACITY - pending_chunks.size()));
+	}
+
+	RequestQueueStats& stats = chunk_gen_stats();
+	stats.in_flight = pending_chunks.size();
+	stats.held_back = held_back_chunks.size();
+}
+
+void WorldDataPart::send_held_back_meshes() {
+	const uint64_t in_flight = mesh_gen_stats().in_flight;
+	if (!held_back_meshes.empty() && in_flight < MESH_GEN_CAPACITY) {
+		for (const auto& coords : take_first(held_back_meshes, player_view, MESH_GEN_CAPACITY - in_flight)) {
+			MiniChunk* mini = get_mini(coords);
+			if (mini) {
+				send_mesh_gen(mini);
+			}
+		}
+	}
+
+	mesh_gen_stats().held_back = held_back_meshes.size();
+}
+
+// forget held back requests that are out of range now
+// (held back chunks get requested again by gen_nearby_chunks if the player comes back, and held back minis are treated like cancelled ones)
+void WorldDataPart::drop_far_held_back_requests() {
+	const float max_distance = static_cast<float>(render_distance + REQUEST_CANCEL_SLACK);
+
+	std::erase_if(held_back_chunks, [&](const vmath::ivec2& coords) {
+		return vmath::distance(coords, player_chunk_coords) > max_distance;
 		});
 
-	auto ret = zmq::send_multipart(bus.in, message, zmq::send_flags::dontwait);
-	assert(ret);
+	for (auto iter = held_back_meshes.begin(); iter != held_back_meshes.end();) {
+		if (vmath::distance(chunk_coords_of(*iter), player_chunk_coords) > max_distance) {
+			cancelled_meshes.insert(*iter);
+			iter = held_back_meshes.erase(iter);
+		}
+		else {
+			++iter;
+		}
+	}
+}
+
+// mesh all of a chunk's minis once its neighbors have settled
+void WorldDataPart::defer_mesh_gen(const vmath::ivec2& chunk_coords) {
+	// if already waiting, keep the original tick
+	deferred_meshes.try_emplace(chunk_coords, current_tick);
+}
+
+// check if all chunks around this one are either loaded or not coming
+bool WorldDataPart::are_neighbors_settled(const vmath::ivec2& chunk_coords) {
+	for (int dx = -1; dx <= 1; dx++) {
+		for (int dz = -1; dz <= 1; dz++) {
+			const vmath::ivec2 coords = chunk_coords + vmath::ivec2(dx, dz);
+			if (pending_chunks.find(coords) != pending_chunks.end() || held_back_chunks.find(coords) != held_back_chunks.end()) {
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+// enqueue meshing of deferred chunks whose neighbors have settled
+void WorldDataPart::flush_deferred_meshes() {
+	for (auto iter = deferred_meshes.begin(); iter != deferred_meshes.end();) {
+		const auto& [coords, tick] = *iter;
+
+		// wait a bit for more requests, and for neighbors to come in
+		if (current_tick - tick < MESH_COALESCE_TICKS || !are_neighbors_settled(coords)) {
+			++iter;
+			continue;
+		}
+
+		std::shared_ptr<Chunk> chunk = get_chunk(coords);
+		if (chunk) {
+			for (int i = 0; i < MINIS_PER_CHUNK; i++) {
+				enqueue_mesh_gen(chunk->minis[i].get());
+			}
+		}
+
+		iter = deferred_meshes.erase(iter);
+	}
+}
+
+// re-enqueue meshing of cancelled minis that are back within range
+void WorldDataPart::retry_cancelled_meshes(const vmath::ivec2& center, const int distance) {
+	for (auto iter = cancelled_meshes.begin(); iter != cancelled_meshes.end();) {
+		const vmath::ivec3& coords = *iter;
+		const vmath::ivec2 chunk_coords = { coords[0], coords[2] };
+
+		if (vmath::distance(chunk_coords, center) > distance) {
+			++iter;
+			continue;
+		}
+
+		// if the chunk's about to be meshed anyway, no need
+		std::shared_ptr<Chunk> chunk = get_chunk(chunk_coords);
+		if (chunk && deferred_meshes.find(chunk_coords) == deferred_meshes.end()) {
+			enqueue_mesh_gen(chunk->get_mini_with_y_level(coords[1]));
+		}
+
+		iter = cancelled_meshes.erase(iter);
+	}
 }
 
 // add chunk to chunk coords (x, z)
@@ -118,45 +296,39 @@ void WorldDataPart::add_chunk(const int x, const int z, std::shared_ptr<Chunk> c
 		throw "Wew";
 	}
 	chunk_map[coords] = chunk;
+	liquids.on_chunk_loaded(coords);
 }
 
 // generate chunks if they don't exist yet
 void WorldDataPart::gen_chunks_if_required(const vector<vmath::ivec2>& chunk_coords) {
-	// don't wanna generate duplicates
-	std::unordered_set<vmath::ivec2, vecN_hash> to_generate;
-
 	for (auto coords : chunk_coords) {
 		const auto search = chunk_map.find(coords);
 
-		// if doesn't exist, need to generate it
-		if (search == chunk_map.end()) {
-			to_generate.insert(coords);
+		// if doesn't exist and we haven't asked for it yet, need to generate it
+		// (held back is a set, so no duplicates)
+		if (search == chunk_map.end() && pending_chunks.find(coords) == pending_chunks.end()) {
+			held_back_chunks.insert(coords);
 		}
 	}
 
-	if (to_generate.size() > 0) {
-		gen_chunks(to_generate);
-	}
+	// ask for as many as the chunker has room for
+	send_held_back_chunks();
 }
 
 // generate multiple chunks
-void WorldDataPart::gen_chunks(const std::unordered_set<vmath::ivec2, vecN_hash>& to_generate) {
+void WorldDataPart::gen_chunks(const std::vector<vmath::ivec2>& to_generate) {
 	// Instead of generating chunks ourselves, we request the ChunkGenThread to do it for us.
-	// TODO: Send one request with a vector of coords?
+	auto req = std::make_unique<ChunkGenRequest>();
+	req->coords.reserve(to_generate.size());
 	for (const vmath::ivec2& coords : to_generate)
 	{
-		ChunkGenRequest* req = new ChunkGenRequest;
-		req->coords = coords;
-		std::vector<zmq::const_buffer> message({
-			zmq::buffer(msg::CHUNK_GEN_REQUEST),
-			zmq::buffer(&req, sizeof(req))
-			});
-
-		auto ret = zmq::send_multipart(bus.in, message, zmq::send_flags::dontwait);
-		assert(ret);
+		pending_chunks.insert(coords);
+		req->coords.push_back(coords);
 	}
 
-	return;
+	chunk_gen_stats().messages++;
+	auto ret = bus.send(Message(msg::CHUNK_GEN_REQUEST, std::move(req)));
+	assert(ret);
 }
 
 // get chunk or nullptr (using cache) (TODO: LRU?)
@@ -174,7 +346,7 @@ std::shared_ptr<Chunk> WorldDataPart::get_chunk(const int x, const int z) {
 std::shared_ptr<Chunk> WorldDataPart::get_chunk(const vmath::ivec2& xz) { return get_chunk(xz[0], xz[1]); }
 
 // get mini or nullptr
-std::shared_ptr<MiniChunk> WorldDataPart::get_mini(const int x, const int y, const int z) {
+MiniChunk* WorldDataPart::get_mini(const int x, const int y, const int z) {
 	const auto search = chunk_map.find({ x, z });
 
 	// if chunk doesn't exist, return null
@@ -186,7 +358,7 @@ std::shared_ptr<MiniChunk> WorldDataPart::get_mini(const int x, const int y, con
 	return chunk->get_mini_with_y_level((y / 16) * 16); // TODO: Just y % 16?
 }
 
-std::shared_ptr<MiniChunk> WorldDataPart::get_mini(const vmath::ivec3& xyz) { return get_mini(xyz[0], xyz[1], xyz[2]); }
+MiniChunk* WorldDataPart::get_mini(const vmath::ivec3& xyz) { return get_mini(xyz[0], xyz[1], xyz[2]); }
 
 // generate chunks near player
 void WorldDataPart::gen_nearby_chunks(const vmath::vec4& position, const int& distance) {
@@ -195,7 +367,12 @@ void WorldDataPart::gen_nearby_chunks(const vmath::vec4& position, const int& di
 	const vmath::ivec2 chunk_coords = get_chunk_coords(position[0], position[2]);
 	const vector<vmath::ivec2> coords = gen_circle(distance, chunk_coords);
 
+	player_chunk_coords = chunk_coords;
+	render_distance = distance;
+	drop_far_held_back_requests();
+
 	gen_chunks_if_required(coords);
+	retry_cancelled_meshes(chunk_coords, distance);
 }
 
 // get chunk that contains block at (x, _, z)
@@ -204,7 +381,7 @@ std::shared_ptr<Chunk> WorldDataPart::get_chunk_containing_block(const int x, co
 }
 
 // get minichunk that contains block at (x, y, z)
-std::shared_ptr<MiniChunk> WorldDataPart::get_mini_containing_block(const int x, const int y, const int z) {
+MiniChunk* WorldDataPart::get_mini_containing_block(const int x, const int y, const int z) {
 	std::shared_ptr<Chunk> chunk = get_chunk_containing_block(x, z);
 	if (chunk == nullptr) {
 		return nullptr;
@@ -213,34 +390,6 @@ std::shared_ptr<MiniChunk> WorldDataPart::get_mini_containing_block(const int x,
 }
 
 
-// get minichunks that touch any face of the block at (x, y, z)
-std::vector<std::shared_ptr<MiniChunk>> WorldDataPart::get_minis_touching_block(const int x, const int y, const int z) {
-	vector<std::shared_ptr<MiniChunk>> result;
-	vector<vmath::ivec3> potential_mini_coords;
-
-	const vmath::ivec3 mini_coords = get_mini_coords(x, y, z);
-	const vmath::ivec3 mini_relative_coords = get_mini_relative_coords(x, y, z);
-
-	potential_mini_coords.push_back(mini_coords);
-
-	if (mini_relative_coords[0] == 0) potential_mini_coords.push_back(mini_coords + IWEST);
-	if (mini_relative_coords[0] == 15) potential_mini_coords.push_back(mini_coords + IEAST);
-
-	if (mini_relative_coords[1] == 0 && y > 0) potential_mini_coords.push_back(mini_coords + IDOWN * MINICHUNK_HEIGHT);
-	if (mini_relative_coords[1] == 15 && y + MINICHUNK_HEIGHT < 256) potential_mini_coords.push_back(mini_coords + IUP * MINICHUNK_HEIGHT);
-	if (mini_relative_coords[2] == 0) potential_mini_coords.push_back(mini_coords + INORTH);
-	if (mini_relative_coords[2] == 15) potential_mini_coords.push_back(mini_coords + ISOUTH);
-
-	for (auto& coords : potential_mini_coords) {
-		const auto mini = get_mini(coords);
-		if (mini != nullptr) {
-			result.push_back(mini);
-		}
-	}
-
-	return result;
-}
-
 // get a block's type
 // inefficient when called repeatedly - if you need multiple blocks from one mini/chunk, use get_mini (or get_chunk) and mini.get_block.
 BlockType WorldDataPart::get_type(const int x, const int y, const int z) {
@@ -269,65 +418,48 @@ void WorldDataPart::set_type(const int x, const int y, const int z, const BlockT
 
 	const vmath::ivec3 chunk_coords = get_chunk_relative_coordinates(x, y, z);
 	chunk->set_block(chunk_coords, val);
+	liquids.on_block_changed({ x, y, z });
 }
 
 void WorldDataPart::set_type(const vmath::ivec3& xyz, const BlockType& val) { return set_type(xyz[0], xyz[1], xyz[2], val); }
 void WorldDataPart::set_type(const vmath::ivec4& xyz_, const BlockType& val) { return set_type(xyz_[0], xyz_[1], xyz_[2], val); }
 
-// when a mini updates, update its and its neighbors' meshes, if required.
+// when a mini updates, update its and its neighbors' meshes, if required (once the update's done, see flush_block_changes).
 // mini: the mini that changed
-// block: the mini-coordinates of the block that was added/deleted
-// TODO: Use block.
-void WorldDataPart::on_mini_update(std::shared_ptr<MiniChunk> mini, const vmath::ivec3& block) {
+// block: the coordinates of the block that was added/deleted
+void WorldDataPart::on_mini_update(MiniChunk* mini, const vmath::ivec3& block) {
 	// for now, don't care if something was done in an unloaded mini
 	if (mini == nullptr) {
 		return;
 	}
 
-	// regenerate neighbors' meshes
-	const auto neighbors = get_minis_touching_block(block[0], block[1], block[2]);
-	for (auto& neighbor : neighbors) {
-		if (neighbor != mini) {
-			enqueue_mesh_gen(neighbor, true);
-		}
-	}
-
-	// regenerate own meshes
-	enqueue_mesh_gen(mini, true);
-
-	// finally, add nearby waters to propagation queue
-	// TODO: do this smarter?
-	schedule_water_propagation(block);
-	schedule_water_propagation_neighbors(block);
+	// regenerate its and its neighbors' meshes, together with everything else that changed
+	block_changes.record_block(block);
 }
 
 // update meshes
 void WorldDataPart::on_block_update(const vmath::ivec3& block) {
-	std::shared_ptr<MiniChunk> mini = get_mini_containing_block(block[0], block[1], block[2]);
+	MiniChunk* mini = get_mini_containing_block(block[0], block[1], block[2]);
 	vmath::ivec3 mini_coords = get_mini_relative_coords(block[0], block[1], block[2]);
 	on_mini_update(mini, block);
 }
 
 void WorldDataPart::destroy_block(const int x, const int y, const int z) {
-	// update data
-	std::shared_ptr<MiniChunk> mini = get_mini_containing_block(x, y, z);
-	const vmath::ivec3 mini_coords = get_mini_relative_coords(x, y, z);
-	mini->set_block(mini_coords, BlockType::Air);
+	// update data (through the chunk, so the mesher never sees a mini change under it)
+	set_type(x, y, z, BlockType::Air);
 
-	// regenerate textures for all neighboring minis (TODO: This should be a maximum of 3 neighbors, since >=3 sides of the destroyed block are facing its own mini.)
-	on_mini_update(mini, { x, y, z });
+	// regenerate textures for all neighboring minis
+	on_mini_update(get_mini_containing_block(x, y, z), { x, y, z });
 }
 
 void WorldDataPart::destroy_block(const vmath::ivec3& xyz) { return destroy_block(xyz[0], xyz[1], xyz[2]); };
 
 void WorldDataPart::add_block(const int x, const int y, const int z, const BlockType& block) {
-	// update data
-	std::shared_ptr<MiniChunk> mini = get_mini_containing_block(x, y, z);
-	const vmath::ivec3& mini_coords = get_mini_relative_coords(x, y, z);
-	mini->set_block(mini_coords, block);
+	// update data (through the chunk, so the mesher never sees a mini change under it)
+	set_type(x, y, z, block);
 
-	// regenerate textures for all neighboring minis (TODO: This should be a maximum of 3 neighbors, since the block always has at least 3 sides inside its mini.)
-	on_mini_update(mini, { x, y, z });
+	// regenerate textures for all neighboring minis
+	on_mini_update(get_mini_containing_block(x, y, z), { x, y, z });
 }
 
 void WorldDataPart::add_block(const vmath::ivec3& xyz, const BlockType& block) { return add_block(xyz[0], xyz[1], xyz[2], block); };
@@ -358,444 +490,192 @@ void WorldDataPart::set_metadata(const int x, const int y, const int z, const Me
 
 	vmath::ivec3 chunk_coords = get_chunk_relative_coordinates(x, y, z);
 	chunk->set_metadata(chunk_coords, val);
+	liquids.on_block_changed({ x, y, z });
 }
 
 void WorldDataPart::set_metadata(const vmath::ivec3& xyz, const Metadata& val) { return set_metadata(xyz[0], xyz[1], xyz[2], val); }
 void WorldDataPart::set_metadata(const vmath::ivec4& xyz_, const Metadata& val) { return set_metadata(xyz_[0], xyz_[1], xyz_[2], val); }
 
-// TODO
-void WorldDataPart::schedule_water_propagation(const vmath::ivec3& xyz) {
-	// push to water propagation priority queue
-	water_propagation_queue.push({ current_tick + 5, xyz });
-}
+// given water at (x, y, z), standing on something, find all directions which lead to A shortest path down
+uint8_t WorldDataPart::find_shortest_water_path(int x, int y, int z) {
+	assert(get_type(x, y - 1, z).is_solid() && "block under starter block is non-solid!");
 
-void WorldDataPart::schedule_water_propagation_neighbors(const vmath::ivec3& xyz) {
-	auto directions = { INORTH, ISOUTH, IEAST, IWEST, IDOWN };
-	for (const auto& ddir : directions) {
-		schedule_water_propagation(xyz + ddir);
-	}
+	const liquid::PathGrid grid = liquid::fetch_path_grid([this](const vmath::ivec2& coords) { return get_chunk(coords); }, { x, y, z });
+	return liquid::shortest_path_dirs(grid);
 }
 
-// get liquid at (x, y, z) and propagate it
-void WorldDataPart::propagate_water(int x, int y, int z) {
-	vmath::ivec3 coords = { x, y, z };
-
-	// get chunk which block is in, and if it's unloaded, don't both propagating
-	auto chunk = get_chunk_containing_block(x, z);
-	if (chunk == nullptr) {
-		return;
-	}
-
-	// get block at propagation location
-	auto block = get_type(x, y, z);
-
-	// if we're air or flowing water, adjust height
-	if (block == BlockType::Air || block == BlockType::FlowingWater) {
-#ifdef _DEBUG
-		char buf[256];
-		sprintf(buf, "Propagating water at (%d, %d, %d)\n", x, y, z);
-		OutputDebugString(buf);
-#endif // _DEBUG
-
-		uint8_t water_level = block == BlockType::FlowingWater ? get_metadata(x, y, z).get_liquid_level() : block == BlockType::StillWater ? 7 : 0;
-		uint8_t new_water_level = water_level;
-
-		// if water on top, max height
-		auto top_block = get_type(coords + IUP);
-		if (top_block == BlockType::StillWater || top_block == BlockType::FlowingWater) {
-			// update water level if needed
-			new_water_level = 7; // max
-			if (new_water_level != water_level) {
-				set_type(x, y, z, BlockType::FlowingWater);
-				set_metadata(x, y, z, new_water_level);
-				schedule_water_propagation_neighbors(coords);
-				on_block_update(coords);
-			}
-			return;
-		}
-
-		/* UPDATE WATER LEVEL FOR CURRENT BLOCK BY CHECKING SIDES */
+void WorldDataPart::handle_messages()
+{
+	// Receive all messages
+	Message message;
+	while (bus.recv(message))
+	{
+		switch (message.topic)
+		{
+		// Get chunk gen response
+		case msg::CHUNK_GEN_RESPONSE:
+		{
+			// Extract result
+			std::unique_ptr<ChunkGenResponse> response = message.take<ChunkGenResponse>();
+			assert(response);
 
-		// record highest water level in side blocks, out of side blocks that are ON a block
-		uint8_t highest_side_water = 0;
-		auto directions = { INORTH, ISOUTH, IEAST, IWEST };
-		for (auto& ddir : directions) {
-			// BEAUTIFUL - don't inherit height from nearby water UNLESS it's ON A SOLID BLOCK!
-			BlockType under_side_block = get_type(coords + ddir + IDOWN);
-			if (under_side_block.is_nonsolid()) {
-				continue;
-			}
+			for (auto& generated : response->chunks)
+			{
+				// Get the chunk
+				std::shared_ptr<Chunk> chunk = std::move(generated);
+				assert(chunk);
 
-			BlockType side_block = get_type(coords + ddir);
+				pending_chunks.erase(chunk->coords);
 
-			// if side block is still, its level is max
-			if (side_block == BlockType::StillWater) {
-				highest_side_water = 7;
-				break;
-			}
+				// make sure it's not a duplicate
+				if (get_chunk(chunk->coords))
+				{
+					OutputDebugStringA("Warn: Duplicate chunk generated.\n");
+					continue;
+				}
 
-			// if side block is flowing, update highest side water
-			else if (side_block == BlockType::FlowingWater) {
-				auto side_water_level = get_metadata(coords + ddir).get_liquid_level();
-				if (side_water_level > highest_side_water) {
-					highest_side_water = side_water_level;
-					if (side_water_level == 7) {
-						break;
+				add_chunk(chunk->coords[0], chunk->coords[1], chunk);
+				num_chunks_loaded++;
+
+				// Now we must mesh it, and re-mesh any neighbors (their borders changed)
+				// (meshing reads the chunks around a mini for faces, ambient occlusion and liquid heights, so include diagonals)
+				for (int dx = -1; dx <= 1; dx++)
+				{
+					for (int dz = -1; dz <= 1; dz++)
+					{
+						const vmath::ivec2 coords = chunk->coords + vmath::ivec2(dx, dz);
+						if (get_chunk(coords))
+						{
+							defer_mesh_gen(coords);
+						}
 					}
 				}
 			}
+			break;
 		}
-
-		/* UPDATE WATER LEVEL FOR CURRENT BLOCK IF IT'S CHANGED */
-
-		// update water level if needed
-		new_water_level = highest_side_water - 1;
-		if (new_water_level != water_level) {
-			// if water level in range, set it
-			if (0 <= new_water_level && new_water_level <= 7) {
-				set_type(x, y, z, BlockType::FlowingWater);
-				set_metadata(x, y, z, new_water_level);
-				schedule_water_propagation_neighbors(coords);
-				on_block_update(coords);
-			}
-			// otherwise destroy water
-			else if (block == BlockType::FlowingWater) {
-				set_type(x, y, z, BlockType::Air);
-				schedule_water_propagation_neighbors(coords);
-				on_block_update(coords);
-			}
-		}
-	}
-}
-
-// given water at (x, y, z), find all directions which lead to A shortest path down
-// radius = 4
-// TODO
-std::unordered_set<vmath::ivec3, vecN_hash> WorldDataPart::find_shortest_water_path(int x, int y, int z) {
-	vmath::ivec3 coords = { x, y, z };
-	assert(get_type(coords + IDOWN).is_solid() && "block under starter block is non-solid!");
-
-	// extract a 9x9 radius of blocks which we can traverse (1) and goals (2)
-
-	constexpr unsigned radius = 4;
-	constexpr unsigned invalid_path = 0;
-	constexpr unsigned valid_path = 1;
-	constexpr unsigned goal = 2;
-
-	static_assert(radius > 0);
-	uint8_t extracted[radius * 2 - 1][radius * 2 - 1];
-	memset(extracted, invalid_path, sizeof(extracted));
-
-	// for every block in radius
-	for (int dx = -radius; dx <= radius; dx++) {
-		for (int dz = -radius; dz <= radius; dz++) {
-			// if the block is empty
-			if (get_type(x + dx, y, z + dz) == BlockType::Air) {
-				// if the block below it is solid, it's a valid path to take
-				if (get_type(x + dx, y - 1, z + dz).is_solid()) {
-					extracted[x + dx][z + dz] = valid_path;
-				}
-				// if the block below it is non-solid, it's a goal
-				else {
-					extracted[x + dx][z + dz] = goal;
-				}
+		case msg::CHUNK_GEN_CANCELLED:
+		{
+			// chunker gave up on these, so they'll be re-requested when the player comes back
+			for (const auto& coords : message.get<std::vector<vmath::ivec2>>())
+			{
+				pending_chunks.erase(coords);
 			}
-		}
-	}
-
-	// find all shortest paths (1) to goal (2) using bfs
-	struct search_item {
-		int distance = -1;
-		bool reachable_from_west = false;
-		bool reachable_from_east = false;
-		bool reachable_from_north = false;
-		bool reachable_from_south = false;
-	};
-
-	search_item search_items[radius * 2 + 1][radius * 2 + 1];
-
-	std::queue<vmath::ivec2> bfs_queue;
-
-	// set very center
-	search_items[radius][radius].distance = 0;
-
-	// set items around center
-	search_items[radius + 1][radius].distance = 1;
-	search_items[radius + 1][radius].reachable_from_west = true;
-
-	search_items[radius - 1][radius].distance = 1;
-	search_items[radius - 1][radius].reachable_from_east = true;
-
-	search_items[radius][radius + 1].distance = 1;
-	search_items[radius][radius + 1].reachable_from_north = true;
-
-	search_items[radius][radius - 1].distance = 1;
-	search_items[radius][radius - 1].reachable_from_south = true;
-
-	// insert items around center into queue
-	// TODO: do clever single for loop instead of creating std::vector?
-	std::vector<std::pair<int, int>> nearby = { {1, 0}, {-1, 0}, {0, 1}, {0, -1} };
-	for (auto& [dx, dy] : nearby) {
-		bfs_queue.push({ dx, dy });
-	}
-
-	// store queue items that have shortest distance
-	int found_distance = -1;
-	std::vector<search_item*> found; // TODO: only store valid directions. Or even better, just have 4 bools, then convert them to coords when returning.
-
-	// perform bfs
-	while (!bfs_queue.empty()) {
-		// get first item in bfs
-		const auto item_coords = bfs_queue.front();
-		bfs_queue.pop();
-		auto& item = search_items[item_coords[0] + radius][item_coords[1] + radius];
-		const auto block_type = extracted[item_coords[0] + radius][item_coords[1] + radius];
-
-		// if invalid location, yeet out
-		if (block_type == invalid_path) {
 			break;
 		}
-
-		// if we've already found, and this is too big, yeet out
-		if (found_distance >= 0 && found_distance < item.distance) {
+		case msg::MESH_GEN_CANCELLED:
+		{
+			for (const auto& coords : message.get<std::vector<vmath::ivec3>>())
+			{
+				cancelled_meshes.insert(coords);
+			}
 			break;
 		}
-
-		// if item is a goal, add it to found
-		if (block_type == goal) {
-			assert(found_distance == -1 || found_distance == item.distance);
-			found_distance = item.distance;
-			found.push_back(&item);
-		}
-		// otherwise, add its neighbors
-		else {
-			for (auto& [dx, dy] : nearby) {
-				// if item_coords + [dx, dy] in range
-				if (abs(item_coords[0] + dx) <= radius && abs(item_coords[1] + dy) <= radius) {
-					// add it
-					bfs_queue.push({ item_coords[0] + dx, item_coords[1] + dy });
+		case msg::MESH_LOD_REQUEST:
+		{
+			// renderer's drawing these far away, but they were meshed when they were close, so without their coarser meshes
+			for (const auto& coords : message.get<std::vector<vmath::ivec3>>())
+			{
+				MiniChunk* mini = get_mini(coords);
+				if (mini != nullptr)
+				{
+					enqueue_mesh_gen(mini);
 				}
 			}
-		}
-	}
-
-	std::unordered_set<vmath::ivec3, vecN_hash> reachable_from_dirs;
-	for (auto& result : found) {
-		if (result->reachable_from_east) {
-			reachable_from_dirs.insert(IEAST);
-		}
-		if (result->reachable_from_west) {
-			reachable_from_dirs.insert(IWEST);
-		}
-		if (result->reachable_from_north) {
-			reachable_from_dirs.insert(INORTH);
-		}
-		if (result->reachable_from_south) {
-			reachable_from_dirs.insert(ISOUTH);
-		}
-	}
-
-	return reachable_from_dirs;
-}
-
-// For a certain corner, get height of flowing water at that corner
-float WorldDataPart::get_water_height(const vmath::ivec3& corner) {
-#ifdef _DEBUG
-	bool any_flowing_water = false;
-#endif
-
-	vector<float> water_height_factors;
-	water_height_factors.reserve(4);
-
-	for (int i = 0; i < 4; i++) {
-		const int dx = (i % 1 == 0) ? 0 : -1; //  0, -1,  0, -1
-		const int dz = (i / 2 == 0) ? 0 : -1; //  0,  0, -1, -1
-
-		const vmath::ivec3 block_coords = corner + vmath::ivec3(dx, 0, dz);
-		const BlockType block = get_type(block_coords);
-		const Metadata metadata = get_metadata(block_coords);
-
-		switch ((BlockType::Value)block) {
-		case BlockType::Air:
-			water_height_factors.push_back(0);
-			break;
-		case BlockType::FlowingWater:
-#ifdef _DEBUG
-			any_flowing_water = true;
-#endif
-			water_height_factors.push_back(metadata.get_liquid_level());
-			break;
-		case BlockType::StillWater:
-			water_height_factors.push_back(8);
 			break;
+		}
 		default:
-			water_height_factors.push_back(7);
+#ifndef _DEBUG
+			WindowsException("unknown message");
+#endif // _DEBUG
 			break;
 		}
 	}
 
-#ifdef _DEBUG
-	assert(any_flowing_water && "called get_water_height for a corner without any nearby flowing water!");
-#endif
+	// mesh any chunks that are done waiting
+	flush_deferred_meshes();
 
-	assert(!water_height_factors.empty());
+	// workers might have room again
+	send_held_back_requests();
 
-	return std::accumulate(water_height_factors.begin(), water_height_factors.end(), 0) / water_height_factors.size();
+	// free old minis the mesher's done with
+	mini_epochs().advance();
 }
 
-void WorldDataPart::handle_messages()
+World::World() : timestep(TICK_DURATION, MAX_CATCH_UP_TICKS, FixedTimestep::clock::now())
 {
-	// Receive all messages
-	std::vector<zmq::message_t> message;
-	auto ret = zmq::recv_multipart(bus.out, std::back_inserter(message), zmq::recv_flags::dontwait);
-	while (ret)
-	{
-		// Get chunk gen response
-		if (message[0].to_string_view() == msg::CHUNK_GEN_RESPONSE)
-		{
-			// Extract result
-			ChunkGenResponse* response_ = *message[1].data<ChunkGenResponse*>();
-			std::unique_ptr<ChunkGenResponse> response(response_);
-
-			// Get the chunk
-			std::shared_ptr<Chunk> chunk = std::move(response->chunk);
-			assert(chunk);
-
-			// make sure it's not a duplicate
-			if (get_chunk(chunk->coords))
-			{
-				OutputDebugStringA("Warn: Duplicate chunk generated.\n");
-			}
-			else
-			{
-				add_chunk(response->coords[0], response->coords[1], chunk);
-			}
-
-			// Now we must enqueue all minis and neighboring minis for meshing
-			for (int i = 0; i < MINIS_PER_CHUNK; i++)
-			{
-				enqueue_mesh_gen(chunk->minis[i]);
-			}
-
-			std::shared_ptr<Chunk> c;
-#define ENQUEUE(chunk_ivec2)\
-			c = get_chunk(chunk_ivec2);\
-			if (c)\
-			{\
-				for (int i = 0; i < MINIS_PER_CHUNK; i++)\
-				{\
-					enqueue_mesh_gen(c->minis[i]);\
-				}\
-			}
+	// TODO: Move bus out of WorldDataPart
+	// (WorldDataPart receives everything from the workers, we only receive from the render thread)
+	bus.subscribe(msg::world_player_incoming);
+}
 
-			ENQUEUE(chunk->coords + vmath::ivec2(1, 0));
-			ENQUEUE(chunk->coords + vmath::ivec2(-1, 0));
-			ENQUEUE(chunk->coords + vmath::ivec2(0, 1));
-			ENQUEUE(chunk->coords + vmath::ivec2(0, -1));
-#undef ENQUEUE
-		}
-		else
-		{
-#ifndef _DEBUG
-			WindowsException("unknown message");
-#endif // _DEBUG
-		}
+World::~World() {
+	stop();
+}
 
-		message.clear();
-		ret = zmq::recv_multipart(bus.out, std::back_inserter(message), zmq::recv_flags::dontwait);
-	}
+void World::start() {
+	assert(!thread.joinable());
+	stopping = false;
+	thread = std::thread(&World::run, this);
 }
 
-/**
- * ? Get NEGATIVE? height liquid should be draw at, given negative water level.
- * (I.e. fullness level goes from 0 (full) to 7 (almost empty), and we return a similar ratio.)
- * /
-constexpr  float liquid_level_to_height(int liquid_level) {
-	// if empty (8 (or more)), height is 0 -- WHY? Shouldn't it be 1?
-	if (liquid_level >= 8) {
-		liquid_level = 0;
+void World::stop() {
+	stopping = true;
+	if (thread.joinable()) {
+		thread.join();
 	}
+}
 
-	// liquidLevel is in [0,   7  ]
-	// result      is in [1/9, 8/9]
-	return (liquid_level + 1) / 9.0f;
+void World::set_paused(const bool paused_) {
+	paused = paused_;
 }
 
- float get_liquid_height(int x, int y, int z, BlockType block) {
-	int sumDivisor = 0;
-	float heightSum = 0.0F;
+WorldSnapshot World::get_snapshot() const {
+	return snapshots.read();
+}
 
-	// for all blocks around the corner
-	for (int i = 0; i < 4; ++i) {
+vmath::vec4 WorldSnapshot::interpolated_coords(const FixedTimestep::clock::time_point now) const {
+	const float alpha = std::clamp(std::chrono::duration<float>(now - time) / TICK_DURATION, 0.0f, 1.0f);
+	return last_coords + (player.coords - last_coords) * alpha;
+}
 
-		// (newX, y, newZ) is one block surrounding the corner (x, y, z)
-		int newX = x - (i & 1); // goes x, x-1, x, x-1
-		int newZ = z - (i >> 1 & 1); // goes z, z, z-1, z-1
+// the world thread
+void World::run() {
+	timestep.reset(FixedTimestep::clock::now());
 
-		// if same liquid on top, set to max height
-		if (get_type(newX, y + 1, newZ) == block) {
-			return 1.0f;
+	while (!stopping) {
+		if (paused) {
+			std::this_thread::sleep_for(WORLD_MESSAGE_INTERVAL);
+			timestep.reset(FixedTimestep::clock::now());
+			continue;
 		}
 
-		// get material at (newX, y, newZ)
-		BlockType newBlock = get_type(newX, y, newZ);
-
-		// if same material as the liquid we're deciding height for,
-		if (newBlock == block)
-		{
-			// get liquid level at (newX, y, newZ)
-			// NOTE: liquid level 0 = max, 7 = min.
-			int liquidLevel = get_metadata(newX, y, newZ).get_liquid_level();
-
-			// ? sanity check + if minimum level
-			if (liquidLevel >= 8 || liquidLevel == 0)
-			{
-				heightSum += liquid_level_to_height(liquidLevel) * 10.0F;
-				sumDivisor += 10;
-			}
-
-			heightSum += liquid_level_to_height(liquidLevel);
-			++sumDivisor;
-		}
-		// if newMaterial is different than given material and non-solid (e.g. air or a different liquid)
-		else if (!newBlock.isSolid())
-		{
-			// increase sum/divisor, but have a much smaller effect than when same liquid
-			++heightSum;
-			++sumDivisor;
+		// run every tick that's due (catching up if the last one was slow, but only so far)
+		const int ticks = timestep.due(FixedTimestep::clock::now());
+		for (int i = 0; i < ticks && !stopping; i++) {
+			tick();
 		}
-	}
 
-	return 1.0F - heightSum / static_cast<float>(sumDivisor);
-}
-*/
-
-World::World(std::shared_ptr<zmq::context_t> ctx_) : data(ctx_), last_update_time(0), bus(ctx_)
-{
-	// TODO: Move bus out of WorldDataPart
-#ifdef _DEBUG
-	bus.out.setsockopt(ZMQ_SUBSCRIBE, "", 0);
-#else
-	for (const auto& m : msg::world_thread_incoming)
-	{
-		// TODO: Upgrade zmq and replace this with .set()
-		bus.out.setsockopt(ZMQ_SUBSCRIBE, m.c_str(), m.size());
+		// then keep up with the workers until the next one
+		for (auto now = FixedTimestep::clock::now(); !stopping && now < timestep.next_step_time(); now = FixedTimestep::clock::now()) {
+			data.handle_messages();
+			std::this_thread::sleep_for(std::min<FixedTimestep::clock::duration>(timestep.next_step_time() - now, WORLD_MESSAGE_INTERVAL));
+		}
 	}
-#endif // _DEBUG
 }
 
-void World::update_world(float time) {
+void World::tick() {
 	const auto start_of_fn = std::chrono::high_resolution_clock::now();
 
-	// change in time
-	const float dt = time - last_update_time;
-	last_update_time = time;
-	data.update_tick((int)floorf(time * 20));
+	// one tick's worth of time, however long it's really been (see FixedTimestep)
+	const float dt = std::chrono::duration<float>(TICK_DURATION).count();
+	data.update_tick(data.current_tick + 1);
 
 	/* CHANGES IN WORLD */
 	data.handle_messages();
+	handle_player_messages();
 
 	// update player movement
+	const vmath::vec4 last_coords = player.coords;
 	update_player_movement(dt);
 
 	// keep track of if it's in water or not
@@ -807,18 +687,24 @@ void World::update_world(float time) {
 	if (chunk_coords != player.chunk_coords) {
 		player.chunk_coords = chunk_coords;
 
-		// Notify listeners that last chunk coords have changed
-		std::vector<zmq::const_buffer> result({
-			zmq::buffer(msg::EVENT_PLAYER_MOVED_CHUNKS),
-			zmq::buffer(&player.chunk_coords, sizeof(player.chunk_coords))
-			});
-		auto ret = zmq::send_multipart(bus.in, result, zmq::send_flags::dontwait);
-		assert(ret);
-
 		// Remember to generate nearby chunks
 		player.should_check_for_nearby_chunks = true;
 	}
 
+	// let workers know where the player's looking and headed, whenever that changes what they should build first
+	// (if their inboxes are full, we'll try again next tick)
+	const PlayerView view = get_player_view();
+	if (view_changed(data.player_view, view) && bus.send(Message(msg::EVENT_PLAYER_VIEW_CHANGED, view))) {
+		data.player_view = view;
+	}
+
+	// let workers know how far away is too far
+	// (if their inboxes are full, we'll try again next tick)
+	if (player.render_distance != last_sent_render_distance && bus.send(Message(msg::EVENT_RENDER_DISTANCE_CHANGED, player.render_distance))) {
+		last_sent_render_distance = player.render_distance;
+		player.should_check_for_nearby_chunks = true;
+	}
+
 	// generate nearby chunks if required
 	if (player.should_check_for_nearby_chunks) {
 		data.gen_nearby_chunks(player.coords, player.render_distance);
@@ -826,22 +712,135 @@ void World::update_world(float time) {
 	}
 
 	// update block that player is staring at
-	const auto direction = player.staring_direction();
-	raycast(player.coords + vmath::vec4(0, CAMERA_HEIGHT, 0, 0), direction, 40, &player.staring_at, &player.staring_at_face, [this](const vmath::ivec3& coords, const vmath::ivec3& face) {
-		const auto block = this->data.get_type(coords);
-		return block.is_solid();
-		});
+	update_staring_at();
+
+	// remesh whatever changed this tick, once per mini
+	data.flush_block_changes();
 
-	// make sure rendering didn't take too long
+	// make sure the tick didn't take too long
 	const auto end_of_fn = std::chrono::high_resolution_clock::now();
 	const long result_total = std::chrono::duration_cast<std::chrono::microseconds>(end_of_fn - start_of_fn).count();
+
+	// remember the slowest tick in the last second (for debug info)
+	update_ms = result_total / 1000.0f;
+	if (data.current_tick - slowest_update_tick >= TICKS_PER_SECOND || update_ms >= slowest_update_ms) {
+		slowest_update_ms = update_ms;
+		slowest_update_tick = data.current_tick;
+	}
 #ifdef _DEBUG
 	if (result_total / 1000.0f > 50) {
 		std::stringstream buf;
-		buf << "TOTAL GAME::update_world TIME: " << result_total / 1000.0f << "ms\n";
+		buf << "TOTAL World::tick TIME: " << result_total / 1000.0f << "ms\n";
 		OutputDebugString(buf.str().c_str());
 	}
 #endif // _DEBUG
+
+	publish_snapshot(last_coords);
+}
+
+// apply whatever the player did since the last tick
+void World::handle_player_messages() {
+	Message message;
+	while (bus.recv(message)) {
+		switch (message.topic) {
+		case msg::PLAYER_INPUT:
+		{
+			const PlayerInput& input = message.get<PlayerInput>();
+			player.actions = input.actions;
+			player.pitch = input.pitch;
+			player.yaw = input.yaw;
+			player.held_block = input.held_block;
+			player.render_distance = input.render_distance;
+			player.noclip = input.noclip;
+			break;
+		}
+		// (clicks go by what the player's staring at as of the input before them, not as of the last tick)
+		case msg::PLAYER_BREAK_BLOCK:
+			update_staring_at();
+			if (player.staring_at[1] >= 0) {
+				data.destroy_block(player.staring_at);
+			}
+			break;
+		case msg::PLAYER_PLACE_BLOCK:
+			update_staring_at();
+			place_block();
+			break;
+		default:
+#ifndef _DEBUG
+			WindowsException("unknown message");
+#endif // _DEBUG
+			break;
+		}
+	}
+}
+
+void World::update_staring_at() {
+	const auto direction = player.staring_direction();
+	raycast(player.coords + vmath::vec4(0, CAMERA_HEIGHT, 0, 0), direction, 40, &player.staring_at, &player.staring_at_face, [this](const vmath::ivec3& coords, const vmath::ivec3& face) {
+		const auto block = this->data.get_type(coords);
+		return block.is_solid();
+		});
+}
+
+// place the held block against the face the player's staring at
+void World::place_block() {
+	// if staring at valid block
+	if (player.staring_at[1] < 0) {
+		return;
+	}
+
+	// position we wanna place block at
+	const vmath::ivec3 desired_position = player.staring_at + player.staring_at_face;
+
+	// check if we're in the way
+	const std::vector<vmath::ivec4> intersecting_blocks = get_player_intersecting_blocks(player.coords);
+	const auto result = std::find_if(std::begin(intersecting_blocks), std::end(intersecting_blocks), [desired_position](const auto& ipos) {
+		return desired_position == vmath::ivec3(ipos[0], ipos[1], ipos[2]);
+		});
+
+	// if we're not in the way, place it
+	if (result == std::end(intersecting_blocks)) {
+		data.add_block(desired_position, player.held_block);
+	}
+}
+
+void World::publish_snapshot(const vmath::vec4& last_coords) {
+	WorldSnapshot& snapshot = snapshots.back();
+	snapshot.tick = data.current_tick;
+	snapshot.time = FixedTimestep::clock::now();
+	snapshot.player = player;
+	snapshot.last_coords = last_coords;
+
+	snapshot.update_ms = update_ms;
+	snapshot.slowest_update_ms = slowest_update_ms;
+	snapshot.num_skipped_ticks = timestep.num_skipped;
+	snapshot.num_chunks_loaded = data.num_chunks_loaded;
+	snapshot.num_mesh_requests = data.num_mesh_requests;
+	snapshot.num_deferred_meshes = data.deferred_meshes.size();
+	snapshot.liquid_stats = data.liquids.stats;
+	snapshot.num_active_liquid = data.liquids.num_active();
+	snapshot.num_liquid_chunks = data.liquids.num_chunks();
+	snapshot.liquid_budget = data.liquids.budget();
+	snapshot.num_block_changes = data.num_block_changes_last_flush;
+	snapshot.num_remeshes = data.num_remeshes_last_flush;
+
+	snapshots.publish();
+}
+
+// player's position, look direction and velocity, in chunks
+PlayerView World::get_player_view() {
+	PlayerView view;
+	view.chunk_coords = player.chunk_coords;
+	view.position = vmath::vec2(player.coords[0], player.coords[2]) * (1.0f / CHUNK_WIDTH);
+	view.velocity = vmath::vec2(player.velocity[0], player.velocity[2]) * (1.0f / CHUNK_WIDTH);
+
+	// (no horizontal direction when looking straight up or down)
+	const vmath::vec4 direction = player.staring_direction();
+	const vmath::vec2 look = { direction[0], direction[2] };
+	const float look_length = vmath::length(look);
+	view.look = look_length > 0.01f ? look * (1.0f / look_length) : vmath::vec2(0.0f, 0.0f);
+
+	return view;
 }
 
 // update player's movement based on how much time has passed since we last did it
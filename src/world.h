@@ -1,15 +1,20 @@
 #pragma once
 
+#include "change_journal.h"
 #include "chunk.h"
+#include "fixed_timestep.h"
+#include "liquids.h"
 #include "player.h"
 #include "world_utils.h"
 
 #include "messaging.h"
 #include "vmath.h"
-#include "zmq.hpp"
 
+#include <atomic>
+#include <chrono>
 #include <memory>
 #include <queue>
+#include <thread>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -23,7 +28,7 @@ using namespace std;
 class WorldDataPart
 {
 public:
-	WorldDataPart(std::shared_ptr<zmq::context_t> ctx_);
+	WorldDataPart();
 
 	// map of (chunk coordinate) -> chunk
 	std::unordered_map<vmath::ivec2, std::shared_ptr<Chunk>, vecN_hash> chunk_map;
@@ -32,18 +37,70 @@ public:
 	// TODO: private
 	int current_tick = 0;
 
-	// water propagation min-priority queue
-	// maps <tick to propagate water at> to <coordinate of water>
-	// TODO: uniqueness (have hashtable which maps coords -> tick, and always keep earliest tick when adding)
-	// TODO: If I never add anything else to this queue (like fire/lava/etc), change it to a normal queue.
-	std::priority_queue<std::pair<int, vmath::ivec3>, std::vector<std::pair<int, vmath::ivec3>>, std::greater<std::pair<int, vmath::ivec3>>> water_propagation_queue;
+	// chunks we've asked the chunker for, but haven't gotten back yet
+	std::unordered_set<vmath::ivec2, vecN_hash> pending_chunks;
+
+	// chunks and minis we want, but haven't asked for yet because the chunker/mesher is at capacity
+	std::unordered_set<vmath::ivec2, vecN_hash> held_back_chunks;
+	std::unordered_set<vmath::ivec3, vecN_hash> held_back_meshes;
+
+	// player's chunk and render distance as of the last gen_nearby_chunks
+	vmath::ivec2 player_chunk_coords = { 0, 0 };
+	int render_distance = 0;
+
+	// player's view as of the last time the workers were told about it (held back requests go in the same order the workers would build them)
+	PlayerView player_view;
+
+	// chunks whose minis are waiting to be meshed, mapped to the tick they started waiting at
+	// a chunk waits until all 8 chunks around it are loaded or aren't coming (i.e. not pending), so that it's meshed once instead of once per neighbor
+	std::unordered_map<vmath::ivec2, int, vecN_hash> deferred_meshes;
+
+	// minis the mesher dropped because the player moved away from them, re-requested when the player comes back
+	std::unordered_set<vmath::ivec3, vecN_hash> cancelled_meshes;
+
+	// for debug info
+	uint64_t num_chunks_loaded = 0;
+	uint64_t num_mesh_requests = 0;
+
+	// water (and whatever other liquids get added)
+	LiquidSim liquids;
+
+	// blocks changed since the last update, whose minis get remeshed together at the end of it (see flush_block_changes)
+	ChangeJournal block_changes;
+
+	// what the last flush did (for debug info)
+	size_t num_block_changes_last_flush = 0;
+	size_t num_remeshes_last_flush = 0;
 
 	// update tick to *new_tick*
 	void update_tick(const int new_tick);
 
 	// enqueue mesh generation of this mini
 	// expects mesh lock
-	void enqueue_mesh_gen(std::shared_ptr<MiniChunk> mini, const bool front_of_queue = false);
+	void enqueue_mesh_gen(MiniChunk* mini, const bool front_of_queue = false);
+
+	// ask the mesher to mesh this mini right away
+	void send_mesh_gen(MiniChunk* mini);
+
+	// send as many held back requests as the chunker and mesher have room for, closest to the player first
+	void send_held_back_requests();
+	void send_held_back_chunks();
+	void send_held_back_meshes();
+
+	// forget held back requests that are out of range now
+	void drop_far_held_back_requests();
+
+	// mesh all of a chunk's minis once its neighbors have settled
+	void defer_mesh_gen(const vmath::ivec2& chunk_coords);
+
+	// check if all chunks around this one are either loaded or not coming
+	bool are_neighbors_settled(const vmath::ivec2& chunk_coords);
+
+	// enqueue meshing of deferred chunks whose neighbors have settled
+	void flush_deferred_meshes();
+
+	// re-enqueue meshing of cancelled minis that are back within range
+	void retry_cancelled_meshes(const vmath::ivec2& center, const int distance);
 
 	// add chunk to chunk coords (x, z)
 	void add_chunk(const int x, const int z, std::shared_ptr<Chunk> chunk);
@@ -52,15 +109,15 @@ public:
 	void gen_chunks_if_required(const vector<vmath::ivec2>& chunk_coords);
 
 	// generate multiple chunks
-	void gen_chunks(const std::unordered_set<vmath::ivec2, vecN_hash>& to_generate);
+	void gen_chunks(const std::vector<vmath::ivec2>& to_generate);
 
 	// get chunk or nullptr (using cache) (TODO: LRU?)
 	std::shared_ptr<Chunk> get_chunk(const int x, const int z);
 	std::shared_ptr<Chunk> get_chunk(const vmath::ivec2& xz);
 
 	// get mini or nullptr
-	std::shared_ptr<MiniChunk> get_mini(const int x, const int y, const int z);
-	std::shared_ptr<MiniChunk> get_mini(const vmath::ivec3& xyz);
+	MiniChunk* get_mini(const int x, const int y, const int z);
+	MiniChunk* get_mini(const vmath::ivec3& xyz);
 
 	// generate chunks near player
 	void gen_nearby_chunks(const vmath::vec4& position, const int& distance);
@@ -69,10 +126,7 @@ public:
 	std::shared_ptr<Chunk> get_chunk_containing_block(const int x, const int z);
 
 	// get minichunk that contains block at (x, y, z)
-	std::shared_ptr<MiniChunk> get_mini_containing_block(const int x, const int y, const int z);
-
-	// get minichunks that touch any face of the block at (x, y, z)
-	vector<std::shared_ptr<MiniChunk>> get_minis_touching_block(const int x, const int y, const int z);
+	MiniChunk* get_mini_containing_block(const int x, const int y, const int z);
 
 	// get a block's type
 	// inefficient when called repeatedly - if you need multiple blocks from one mini/chunk, use get_mini (or get_chunk) and mini.get_block.
@@ -86,11 +140,13 @@ public:
 	void set_type(const vmath::ivec3& xyz, const BlockType& val);
 	void set_type(const vmath::ivec4& xyz_, const BlockType& val);
 
-	// when a mini updates, update its and its neighbors' meshes, if required.
+	// when a mini updates, update its and its neighbors' meshes, if required (once the update's done, see flush_block_changes).
 	// mini: the mini that changed
-	// block: the mini-coordinates of the block that was added/deleted
-	// TODO: Use block.
-	void on_mini_update(std::shared_ptr<MiniChunk> mini, const vmath::ivec3& block);
+	// block: the coordinates of the block that was added/deleted
+	void on_mini_update(MiniChunk* mini, const vmath::ivec3& block);
+
+	// remesh every mini that the changes since the last flush affect, once each
+	void flush_block_changes();
 
 	// update meshes
 	void on_block_update(const vmath::ivec3& block);
@@ -114,20 +170,8 @@ public:
 	void set_metadata(const vmath::ivec3& xyz, const Metadata& val);
 	void set_metadata(const vmath::ivec4& xyz_, const Metadata& val);
 
-	// TODO
-	void schedule_water_propagation(const vmath::ivec3& xyz);
-	void schedule_water_propagation_neighbors(const vmath::ivec3& xyz);
-
-	// get liquid at (x, y, z) and propagate it
-	void propagate_water(int x, int y, int z);
-
-	// given water at (x, y, z), find all directions which lead to A shortest path down
-	// radius = 4
-	// TODO
-	std::unordered_set<vmath::ivec3, vecN_hash> find_shortest_water_path(int x, int y, int z);
-
-	// For a certain corner, get height of flowing water at that corner
-	float get_water_height(const vmath::ivec3& corner);
+	// given water at (x, y, z), standing on something, find all directions which lead to A shortest path down (as liquid::PATH_* bits, 0 if there's none within liquid::PATH_RADIUS)
+	uint8_t find_shortest_water_path(int x, int y, int z);
 
 	// Handle any messages on the message bus
 	void handle_messages();
@@ -136,13 +180,70 @@ private:
 	BusNode bus;
 };
 
+// world ticks per second
+constexpr int TICKS_PER_SECOND = 20;
+constexpr std::chrono::nanoseconds TICK_DURATION = std::chrono::nanoseconds(std::chrono::seconds(1)) / TICKS_PER_SECOND;
+
+// after a slow tick, the world thread runs at most this many ticks back to back to catch up, and skips any more than that
+constexpr int MAX_CATCH_UP_TICKS = 5;
+
+// how often the world thread handles messages while it's waiting for the next tick (so chunks and meshes don't wait for ticks)
+constexpr std::chrono::milliseconds WORLD_MESSAGE_INTERVAL = std::chrono::milliseconds(5);
+
+// what the render thread sees of the world, as of the end of a tick
+struct WorldSnapshot
+{
+	int tick = 0;
+
+	// when it was published (ticks are published about TICK_DURATION apart, so this is what the renderer interpolates by)
+	FixedTimestep::clock::time_point time;
+
+	Player player;
+
+	// the player's coords as of the tick before
+	vmath::vec4 last_coords = { 0.0f };
+
+	// for debug info
+	float update_ms = 0;
+	float slowest_update_ms = 0;
+	uint64_t num_skipped_ticks = 0;
+	uint64_t num_chunks_loaded = 0;
+	uint64_t num_mesh_requests = 0;
+	size_t num_deferred_meshes = 0;
+	LiquidStats liquid_stats;
+	size_t num_active_liquid = 0;
+	size_t num_liquid_chunks = 0;
+	size_t liquid_budget = 0;
+	size_t num_block_changes = 0;
+	size_t num_remeshes = 0;
+
+	// the player's coords at *now*, between the tick before and this one (so the camera moves smoothly, a tick behind the world)
+	vmath::vec4 interpolated_coords(const FixedTimestep::clock::time_point now) const;
+};
+
+// the world, ticking TICKS_PER_SECOND times a second on its own thread (so a slow tick can't hold up a frame)
+// the render thread doesn't touch it: it sends the player's input over the bus, and reads back a snapshot published after every tick
 class World
 {
 public:
-	World(std::shared_ptr<zmq::context_t> ctx_);
+	World();
+	~World();
 
-	void update_world(float time);
+	// start ticking on a new thread / stop and wait for it
+	void start();
+	void stop();
+
+	// while paused, the world doesn't tick (and doesn't try to catch up on the ticks it missed once it's resumed)
+	void set_paused(const bool paused_);
+
+	// the world as of the last tick (any thread)
+	WorldSnapshot get_snapshot() const;
+
+	// everything else is world thread only
+
+	void tick();
 	void update_player_movement(const float dt);
+	PlayerView get_player_view();
 	vmath::vec4 prevent_collisions(const vmath::vec4& position_change);
 
 public:
@@ -150,6 +251,29 @@ public:
 	Player player;
 
 private:
-	float last_update_time;
+	void run();
+
+	// input from the render thread
+	void handle_player_messages();
+	void update_staring_at();
+	void place_block();
+
+	void publish_snapshot(const vmath::vec4& last_coords);
+
+	std::thread thread;
+	std::atomic_bool stopping = false;
+	std::atomic_bool paused = false;
+	FixedTimestep timestep;
+
+	SnapshotBuffer<WorldSnapshot> snapshots;
+
+	// how long the last tick took, and the slowest in the last second (for debug info)
+	float update_ms = 0;
+	float slowest_update_ms = 0;
+	int slowest_update_tick = 0;
+
 	BusNode bus;
+
+	// last render distance we told the workers about
+	int last_sent_render_distance = -1;
 };
@@ -3,19 +3,130 @@
 #include "render.h"
 
 #include "vmath.h"
-#include "zmq.hpp"
 
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <chrono>
+#include <cstdlib>
 #include <vector>
 
+// a mini's blocks plus a 1-block border borrowed from its 26 neighbors, so meshing never has to look anything up
+// coordinates go from -1 to 16 on each axis, missing neighbors are air
+constexpr int PADDED_WIDTH = MINICHUNK_WIDTH + 2;
+constexpr int PADDED_HEIGHT = MINICHUNK_HEIGHT + 2;
+constexpr int PADDED_DEPTH = MINICHUNK_DEPTH + 2;
+constexpr int PADDED_SIZE = PADDED_WIDTH * PADDED_DEPTH * PADDED_HEIGHT;
+
+// how many blocks along each axis go into one downsampled cell at the coarsest level of detail
+constexpr int MAX_LOD_FACTOR = 1 << (MESH_LOD_LEVELS - 1);
+
+// downsampled cells along each axis at the first coarser level of detail (the most of any level)
+constexpr int MAX_LOD_CELLS = MINICHUNK_WIDTH / 2;
+static_assert(MINICHUNK_WIDTH == MINICHUNK_HEIGHT && MINICHUNK_WIDTH == MINICHUNK_DEPTH, "downsampling expects minis to be cubes");
+
+struct PaddedMini {
+	BlockType blocks[PADDED_SIZE];
+	Metadata metadatas[PADDED_SIZE];
+
+	// our 6 face neighbors' blocks along our border, downsampled the way they downsample themselves, at each coarser level of detail
+	// indexed by [lod - 1][face_direction][u][v], where u and v are cells along the other two axes (in xyz order), missing neighbors are air
+	BlockType lod_borders[MESH_LOD_LEVELS - 1][MESH_DIRECTIONS][MAX_LOD_CELLS][MAX_LOD_CELLS];
+
+	static constexpr inline int idx(const int x, const int y, const int z) {
+		return (x + 1) + (z + 1) * PADDED_WIDTH + (y + 1) * PADDED_WIDTH * PADDED_DEPTH;
+	}
+
+	inline BlockType get(const vmath::ivec3& xyz) const {
+		return blocks[idx(xyz[0], xyz[1], xyz[2])];
+	}
+
+	inline Metadata get_metadata(const vmath::ivec3& xyz) const {
+		return metadatas[idx(xyz[0], xyz[1], xyz[2])];
+	}
+};
+
+// votes for one downsampled cell: it becomes its most common non-air block if at least half of it isn't air, otherwise it becomes air
+// (ties go to whichever we saw first)
+struct CellVotes {
+	// (there's only ever a few different blocks in one)
+	std::pair<BlockType, int> votes[MAX_LOD_FACTOR * MAX_LOD_FACTOR * MAX_LOD_FACTOR];
+	int num_votes = 0;
+	int num_blocks = 0;
+	int num_non_air = 0;
+
+	// (so one can be reused across cells)
+	inline void reset() {
+		num_votes = 0;
+		num_blocks = 0;
+		num_non_air = 0;
+	}
+
+	inline void add(const BlockType block) {
+		num_blocks++;
+		if (block == BlockType::Air) {
+			return;
+		}
+		num_non_air++;
+
+		int i = 0;
+		while (i < num_votes && votes[i].first != block) i++;
+		if (i == num_votes) {
+			votes[num_votes++] = { block, 0 };
+		}
+		votes[i].second++;
+	}
+
+	inline BlockType winner() const {
+		BlockType result = BlockType::Air;
+		if (num_non_air * 2 >= num_blocks) {
+			int best = 0;
+			for (int i = 0; i < num_votes; i++) {
+				if (votes[i].second > best) {
+					best = votes[i].second;
+					result = votes[i].first;
+				}
+			}
+		}
+		return result;
+	}
+};
+
+// one cell of a layer: which block's face is showing there, how occluded its corners are, and how low its liquid corners are
+struct LayerFace {
+	BlockType block = BlockType::Air;
+	uint8_t ao = 0; // packed like Quad2D::lighting
+	uint16_t liquid_drops = 0; // packed like Quad2D::liquid_drops
+
+	inline bool operator==(const LayerFace& other) const { return block == other.block && ao == other.ao && liquid_drops == other.liquid_drops; }
+	inline bool operator!=(const LayerFace& other) const { return !(*this == other); }
+};
+
 // Private functions
+template<typename T> static void expand_intervals(const IntervalMap<short, T>& intervals, T(&result)[MINICHUNK_SIZE]);
+template<typename T> static void pad_intervals(const IntervalMap<short, T>& intervals, const vmath::ivec3& offset, T(&expanded)[MINICHUNK_SIZE], T(&result)[PADDED_SIZE]);
+static void downsample_neighbor_border(const IntervalMap<short, BlockType>& intervals, const vmath::ivec3& offset, const BlockType(&expanded)[MINICHUNK_SIZE], PaddedMini& padded);
+void fill_padded_mini(const std::shared_ptr<MeshGenRequest> req, PaddedMini& padded);
+void downsample_padded_mini(const PaddedMini& padded, const int lod, PaddedMini& result);
 std::vector<Quad3D> quads_2d_3d(const std::vector<Quad2D>& quads2d, const int layers_idx, const int layer_no, const vmath::ivec3& face);
-void gen_layer_generalized(const std::shared_ptr<MiniChunk> mini, const std::shared_ptr<MiniChunk> face_mini, const int layers_idx, const int layer_no, const vmath::ivec3 face, BlockType(&result)[16][16]);
 bool is_face_visible(const BlockType& block, const BlockType& face_block);
-void gen_layer(const std::shared_ptr<MeshGenRequest> req, const int layers_idx, const int layer_no, const vmath::ivec3& face, BlockType(&result)[16][16]);
-std::vector<Quad2D> gen_quads(const BlockType(&layer)[16][16], /* const Metadata(&metadata_layer)[16][16], */ bool(&merged)[16][16]);
+static const std::array<std::bitset<MAX_BLOCK_TYPES>, MAX_BLOCK_TYPES>& face_visibility_table();
+static inline bool is_face_visible_fast(const BlockType& block, const BlockType& face_block);
+uint8_t gen_face_ao(const PaddedMini& padded, const vmath::ivec3& face_coords, const int working_idx_1, const int working_idx_2);
+static inline bool is_liquid(const BlockType& block);
+int liquid_corner_drop(const PaddedMini& padded, const vmath::ivec3& coords, const int corner_x, const int corner_z);
+uint16_t gen_face_liquid_drops(const PaddedMini& padded, const vmath::ivec3& coords, const int layers_idx, const vmath::ivec3& face, const int working_idx_1, const int working_idx_2);
+uint16_t corners_to_vertex_order(const Quad3D& quad, const int layers_idx, const uint16_t corners, const int bits_per_corner);
+void gen_layer(const PaddedMini& padded, const int layers_idx, const int layer_no, const vmath::ivec3& face, const MeshingOptions& options, LayerFace(&result)[16][16]);
+std::vector<Quad2D> gen_quads(const LayerFace(&layer)[16][16], bool(&merged)[16][16]);
 void mark_as_merged(bool(&merged)[16][16], const vmath::ivec2& start, const vmath::ivec2& max_size);
-vmath::ivec2 get_max_size(const BlockType(&layer)[16][16], const bool(&merged)[16][16], const vmath::ivec2& start_point, const BlockType& block_type);
-bool check_if_covered(std::shared_ptr<MeshGenRequest> req);
+vmath::ivec2 get_max_size(const LayerFace(&layer)[16][16], const bool(&merged)[16][16], const vmath::ivec2& start_point, const LayerFace& layer_face);
+bool check_if_covered(const std::shared_ptr<MeshGenRequest> req, const PaddedMini& padded);
+bool check_if_lod_border_covers(const std::shared_ptr<MeshGenRequest> req, const PaddedMini& padded, const int lod);
+uint64_t hash_padded_mini(const std::shared_ptr<MeshGenRequest> req, const PaddedMini& padded, const MeshingOptions& options);
+MeshGenResult* gen_minichunk_mesh_uncached(std::shared_ptr<MeshGenRequest> req, const PaddedMini& padded, const MeshingOptions& options, MeshCacheEntry& entry);
+std::unique_ptr<MiniChunkMesh> gen_minichunk_mesh(const PaddedMini& padded, const MeshingOptions& options);
+void split_water_mesh(const MiniChunkMesh& mesh, std::shared_ptr<MiniChunkMesh>& non_water, std::shared_ptr<MiniChunkMesh>& water);
 
 constexpr void gen_working_indices(const int& layers_idx, int& working_idx_1, int& working_idx_2) {
 	switch (layers_idx) {
@@ -35,45 +146,80 @@ constexpr void gen_working_indices(const int& layers_idx, int& working_idx_1, in
 	return;
 }
 
-bool check_if_covered(std::shared_ptr<MeshGenRequest> req) {
-	// if contains any translucent blocks, don't know how to handle that yet
-	// TODO?
-	if (req->data->self->any_translucent()) {
-		return false;
+// check if none of a mini's faces can be seen, i.e. meshing it would give us nothing
+// missing neighbors count as covering us, so that we don't mesh the edge of the world until the world around it loads
+bool check_if_covered(const std::shared_ptr<MeshGenRequest> req, const PaddedMini& padded) {
+	const auto& data = req->data;
+	const auto& visible = face_visibility_table();
+
+	// no translucent blocks => our blocks all hide each other, so only our border can show
+	const bool check_interior = data->self->any_translucent();
+
+	// which of our sides have a neighbor to look at
+	const MiniChunk* const face_neighbors[6] = { data->east, data->west, data->up, data->down, data->south, data->north };
+	const vmath::ivec3 faces[6] = { IEAST, IWEST, IUP, IDOWN, ISOUTH, INORTH };
+
+	for (int y = 0; y < MINICHUNK_HEIGHT; y++) {
+		for (int z = 0; z < MINICHUNK_DEPTH; z++) {
+			const bool border_row = y == 0 || y == MINICHUNK_HEIGHT - 1 || z == 0 || z == MINICHUNK_DEPTH - 1;
+
+			// (if we're only checking the border, skip straight from one side of the row to the other)
+			for (int x = 0; x < MINICHUNK_WIDTH; x += check_interior || border_row || x == MINICHUNK_WIDTH - 1 ? 1 : MINICHUNK_WIDTH - 1) {
+				const vmath::ivec3 coords = { x, y, z };
+				const BlockType block = padded.get(coords);
+				if (block == BlockType::Air) {
+					continue;
+				}
+
+				for (int i = 0; i < 6; i++) {
+					const vmath::ivec3 face_coords = coords + faces[i];
+
+					// looking into a missing neighbor
+					const bool outside = face_coords[0] < 0 || face_coords[0] >= MINICHUNK_WIDTH || face_coords[1] < 0 || face_coords[1] >= MINICHUNK_HEIGHT || face_coords[2] < 0 || face_coords[2] >= MINICHUNK_DEPTH;
+					if (outside && !face_neighbors[i]) {
+						continue;
+					}
+
+					const BlockType face_block = padded.get(face_coords);
+					if (visible[static_cast<uint8_t>(block)][static_cast<uint8_t>(face_block)]) {
+						return false;
+					}
+
+					// a liquid's top is visible if it's been lowered, even if there's a block on top (same as gen_layer)
+					if (faces[i] == IUP && is_liquid(block) && !is_liquid(face_block)) {
+						for (int corner = 0; corner < 4; corner++) {
+							if (liquid_corner_drop(padded, coords, corner & 1, corner >> 1) != 0) {
+								return false;
+							}
+						}
+					}
+				}
+			}
+		}
 	}
 
-	// none are air, so only check outside blocks
-	for (int miniY = 0; miniY < MINICHUNK_HEIGHT; miniY++) {
-		for (int miniZ = 0; miniZ < MINICHUNK_DEPTH; miniZ++) {
-			for (int miniX = 0; miniX < MINICHUNK_WIDTH; miniX++) {
-				const auto& mini_coords = req->data->self->get_coords();
-				const vmath::ivec3 coords = { mini_coords[0] * MINICHUNK_WIDTH + miniX, mini_coords[1] + miniY,  mini_coords[2] * MINICHUNK_DEPTH + miniZ };
+	return true;
+}
 
-				// if along east wall, check east
-				if (miniX == MINICHUNK_WIDTH - 1) {
-					if (req->data->east && req->data->east->get_block(get_mini_relative_coords(coords)).is_translucent()) return false;
-				}
-				// if along west wall, check west
-				if (miniX == 0) {
-					if (req->data->west && req->data->west->get_block(get_mini_relative_coords(coords)).is_translucent()) return false;
-				}
+// check if our neighbors' downsampled borders hide every one of our faces at a coarser level of detail
+// (if so, nothing inside us can be seen at that level, no matter what we downsample into)
+bool check_if_lod_border_covers(const std::shared_ptr<MeshGenRequest> req, const PaddedMini& padded, const int lod) {
+	const auto& data = req->data;
+	const MiniChunk* const face_neighbors[6] = { data->east, data->west, data->up, data->down, data->south, data->north };
+	const vmath::ivec3 faces[6] = { IEAST, IWEST, IUP, IDOWN, ISOUTH, INORTH };
+	const int num_cells = MINICHUNK_WIDTH >> lod;
 
-				// if along north wall, check north
-				if (miniZ == 0) {
-					if (req->data->north && req->data->north->get_block(get_mini_relative_coords(coords)).is_translucent()) return false;
-				}
-				// if along south wall, check south
-				if (miniZ == MINICHUNK_DEPTH - 1) {
-					if (req->data->south && req->data->south->get_block(get_mini_relative_coords(coords)).is_translucent()) return false;
-				}
+	for (int i = 0; i < 6; i++) {
+		// (missing neighbors cover us, same as check_if_covered)
+		if (!face_neighbors[i]) {
+			continue;
+		}
 
-				// if along bottom wall, check bottom
-				if (miniY == 0) {
-					if (req->data->down && req->data->down->get_block(get_mini_relative_coords(coords)).is_translucent()) return false;
-				}
-				// if along top wall, check top
-				if (miniY == MINICHUNK_HEIGHT - 1) {
-					if (req->data->up && req->data->up->get_block(get_mini_relative_coords(coords)).is_translucent()) return false;
+		const auto& cells = padded.lod_borders[lod - 1][face_direction(faces[i])];
+		for (int u = 0; u < num_cells; u++) {
+			for (int v = 0; v < num_cells; v++) {
+				if (cells[u][v].is_transparent() || cells[u][v].is_translucent()) {
+					return false;
 				}
 			}
 		}
@@ -113,6 +259,10 @@ std::vector<Quad3D> quads_2d_3d(const std::vector<Quad2D>& quads2d, const int la
 		// set face
 		quad3d.face = face;
 
+		// set lighting and liquid drops (still in layer order, see corners_to_vertex_order)
+		quad3d.lighting = quad2d.lighting;
+		quad3d.liquid_drops = quad2d.liquid_drops;
+
 		// set metadata
 		quad3d.metadata = quad2d.metadata;
 	}
@@ -120,53 +270,192 @@ std::vector<Quad3D> quads_2d_3d(const std::vector<Quad2D>& quads2d, const int la
 	return result;
 }
 
-// generate layer by grabbing face blocks directly from the minichunk
-void gen_layer_generalized(const std::shared_ptr<MiniChunk> mini, const std::shared_ptr<MiniChunk> face_mini, const int layers_idx, const int layer_no, const vmath::ivec3 face, BlockType(&result)[16][16]) {
-	// most efficient to traverse working_idx_1 then working_idx_2;
-	int working_idx_1, working_idx_2;
-	gen_working_indices(layers_idx, working_idx_1, working_idx_2);
+// copy the part of a neighbor's intervals that touches us into a padded array
+// expanded: scratch space
+template<typename T>
+static void pad_intervals(const IntervalMap<short, T>& intervals, const vmath::ivec3& offset, T(&expanded)[MINICHUNK_SIZE], T(&result)[PADDED_SIZE]) {
+	// the part of the neighbor that touches us, in its own coordinates
+	vmath::ivec3 start, end;
+	for (int axis = 0; axis < 3; axis++) {
+		start[axis] = offset[axis] < 0 ? 15 : 0;
+		end[axis] = offset[axis] > 0 ? 0 : 15;
+	}
+	const int volume = (end[0] - start[0] + 1) * (end[1] - start[1] + 1) * (end[2] - start[2] + 1);
+
+	// one value => no need to look anything up
+	// a few values => look them up
+	// a whole face or more => expand it first so that we don't do a map lookup per block
+	const bool homogeneous = intervals.get_interval(0) == intervals.get_interval(MINICHUNK_SIZE - 1);
+	const bool expand = !homogeneous && volume > 16;
+	if (expand) {
+		expand_intervals(intervals, expanded);
+	}
 
-	// coordinates of current block
-	vmath::ivec3 coords = { 0, 0, 0 };
-	coords[layers_idx] = layer_no;
+	for (int y = start[1]; y <= end[1]; y++) {
+		for (int z = start[2]; z <= end[2]; z++) {
+			for (int x = start[0]; x <= end[0]; x++) {
+				const int idx = x + z * MINICHUNK_WIDTH + y * MINICHUNK_WIDTH * MINICHUNK_DEPTH;
+				const T value = homogeneous ? intervals[0] : expand ? expanded[idx] : intervals[idx];
+				result[PaddedMini::idx(x + offset[0] * 16, y + offset[1] * 16, z + offset[2] * 16)] = value;
+			}
+		}
+	}
+}
+
+// downsample the part of a face neighbor that touches us the same way it downsamples itself, into our lod borders
+// expanded: the neighbor's blocks, unless they're all the same (pad_intervals always expands a whole face)
+static void downsample_neighbor_border(const IntervalMap<short, BlockType>& intervals, const vmath::ivec3& offset, const BlockType(&expanded)[MINICHUNK_SIZE], PaddedMini& padded) {
+	const bool homogeneous = intervals.get_interval(0) == intervals.get_interval(MINICHUNK_SIZE - 1);
+	const int direction = face_direction(offset);
+
+	// the axis pointing at the neighbor, and the two along our border
+	const int axis = offset[0] != 0 ? 0 : offset[1] != 0 ? 1 : 2;
+	const int u_axis = axis == 0 ? 1 : 0;
+	const int v_axis = axis == 2 ? 1 : 2;
+
+	CellVotes votes;
+	for (int lod = 1; lod < MESH_LOD_LEVELS; lod++) {
+		const int factor = 1 << lod;
+		const int num_cells = MINICHUNK_WIDTH / factor;
+
+		for (int u = 0; u < num_cells; u++) {
+			for (int v = 0; v < num_cells; v++) {
+				BlockType& cell = padded.lod_borders[lod - 1][direction][u][v];
+				if (homogeneous) {
+					cell = intervals[0];
+					continue;
+				}
 
-	// reset all to air
-	memset(result, (uint8_t)BlockType::Air, sizeof(result));
-	if (!mini)
-	{
-		OutputDebugString("Uh oh 3501\n");
-		return;
+				// the neighbor's cell touching us (the first ones along the axis if it's after us, the last ones if it's before us)
+				vmath::ivec3 start;
+				start[axis] = offset[axis] > 0 ? 0 : MINICHUNK_WIDTH - factor;
+				start[u_axis] = u * factor;
+				start[v_axis] = v * factor;
+
+				// (same order as downsample_padded_mini, so ties go the same way)
+				votes.reset();
+				for (int y = start[1]; y < start[1] + factor; y++) {
+					for (int z = start[2]; z < start[2] + factor; z++) {
+						for (int x = start[0]; x < start[0] + factor; x++) {
+							votes.add(expanded[x + z * MINICHUNK_WIDTH + y * MINICHUNK_WIDTH * MINICHUNK_DEPTH]);
+						}
+					}
+				}
+				cell = votes.winner();
+			}
+		}
 	}
+}
 
-	// for each coordinate
-	for (int v = 0; v < 16; v++) {
-		for (int u = 0; u < 16; u++) {
-			coords[working_idx_1] = u;
-			coords[working_idx_2] = v;
+// copy our blocks and the neighbor blocks touching us into a padded mini
+void fill_padded_mini(const std::shared_ptr<MeshGenRequest> req, PaddedMini& padded) {
+	BlockType expanded_blocks[MINICHUNK_SIZE];
+	Metadata expanded_metadatas[MINICHUNK_SIZE];
 
-			// get block at these coordinates
-			const BlockType block = mini->get_block(coords);
+	for (int dy = -1; dy <= 1; dy++) {
+		for (int dz = -1; dz <= 1; dz++) {
+			for (int dx = -1; dx <= 1; dx++) {
+				const vmath::ivec3 offset = { dx, dy, dz };
+				const MiniChunk* mini = req->data->get_neighbor(offset);
 
-			// skip air blocks
-			if (block == BlockType::Air) {
-				continue;
-			}
+				// no neighbor => leave it as air
+				if (!mini) {
+					continue;
+				}
+
+				pad_intervals(mini->blocks, offset, expanded_blocks, padded.blocks);
+				pad_intervals(mini->metadatas, offset, expanded_metadatas, padded.metadatas);
 
-			// no face mini => face is air
-			else if (face_mini == nullptr) {
-				result[u][v] = block;
+				// (face neighbors only)
+				if (std::abs(dx) + std::abs(dy) + std::abs(dz) == 1) {
+					downsample_neighbor_border(mini->blocks, offset, expanded_blocks, padded);
+				}
 			}
+		}
+	}
+}
+
+// downsample a padded mini to a coarser level of detail, i.e. by 2^lod along each axis, by majority vote (see CellVotes)
+// the result's still at full resolution (all blocks in a cell are the same), so it can be meshed like any other mini
+// (our border is only 1 block thick, so our face neighbors' cells come from our lod borders instead, so that we see them just like they'll be drawn,
+//  and edge and corner cells only vote with the border blocks they cover)
+void downsample_padded_mini(const PaddedMini& padded, const int lod, PaddedMini& result) {
+	assert(lod > 0 && lod < MESH_LOD_LEVELS);
+	const int factor = 1 << lod;
+
+	// cells along an axis: the border block before us, our blocks in groups of *factor*, then the border block after us
+	const int num_cells = MINICHUNK_WIDTH / factor + 2;
+	auto cell_range = [&](const int cell, int& start, int& end) {
+		if (cell == 0) {
+			start = end = -1;
+		}
+		else if (cell == num_cells - 1) {
+			start = end = MINICHUNK_WIDTH;
+		}
+		else {
+			start = (cell - 1) * factor;
+			end = start + factor - 1;
+		}
+	};
+
+	CellVotes votes;
+	for (int cy = 0; cy < num_cells; cy++) {
+		for (int cz = 0; cz < num_cells; cz++) {
+			for (int cx = 0; cx < num_cells; cx++) {
+				vmath::ivec3 start, end;
+				cell_range(cx, start[0], end[0]);
+				cell_range(cy, start[1], end[1]);
+				cell_range(cz, start[2], end[2]);
+
+				// which side of us the cell's on, if any
+				const vmath::ivec3 cell = { cx, cy, cz };
+				vmath::ivec3 side = { 0, 0, 0 };
+				for (int axis = 0; axis < 3; axis++) {
+					side[axis] = cell[axis] == 0 ? -1 : cell[axis] == num_cells - 1 ? 1 : 0;
+				}
 
-			// face mini exists
-			else {
-				// get face block
-				vmath::ivec3 face_coords = coords + face;
-				face_coords[layers_idx] = (face_coords[layers_idx] + 16) % 16;
-				const BlockType face_block = face_mini->get_block(face_coords);
+				BlockType winner;
+				if (std::abs(side[0]) + std::abs(side[1]) + std::abs(side[2]) == 1) {
+					// face neighbor's cell => take theirs
+					const int axis = side[0] != 0 ? 0 : side[1] != 0 ? 1 : 2;
+					const int u = (axis == 0 ? cy : cx) - 1;
+					const int v = (axis == 2 ? cy : cz) - 1;
+					winner = padded.lod_borders[lod - 1][face_direction(side)][u][v];
+				}
+				else {
+					votes.reset();
+					for (int y = start[1]; y <= end[1]; y++) {
+						for (int z = start[2]; z <= end[2]; z++) {
+							for (int x = start[0]; x <= end[0]; x++) {
+								votes.add(padded.blocks[PaddedMini::idx(x, y, z)]);
+							}
+						}
+					}
+					winner = votes.winner();
+				}
 
-				// if block's face is visible, set it
-				if (is_face_visible(block, face_block)) {
-					result[u][v] = block;
+				// fill the cell, taking metadata from the first block that won
+				bool found_metadata = false;
+				Metadata metadata;
+				for (int y = start[1]; y <= end[1]; y++) {
+					for (int z = start[2]; z <= end[2]; z++) {
+						for (int x = start[0]; x <= end[0]; x++) {
+							const int idx = PaddedMini::idx(x, y, z);
+							if (!found_metadata && padded.blocks[idx] == winner) {
+								metadata = padded.metadatas[idx];
+								found_metadata = true;
+							}
+						}
+					}
+				}
+				for (int y = start[1]; y <= end[1]; y++) {
+					for (int z = start[2]; z <= end[2]; z++) {
+						for (int x = start[0]; x <= end[0]; x++) {
+							const int idx = PaddedMini::idx(x, y, z);
+							result.blocks[idx] = winner;
+							result.metadatas[idx] = metadata;
+						}
+					}
 				}
 			}
 		}
@@ -177,42 +466,212 @@ bool is_face_visible(const BlockType& block, const BlockType& face_block) {
 	return face_block.is_transparent() || (block != BlockType::StillWater && block != BlockType::FlowingWater && face_block.is_translucent()) || (face_block.is_translucent() && !block.is_translucent());
 }
 
-void gen_layer(const std::shared_ptr<MeshGenRequest> req, const int layers_idx, const int layer_no, const vmath::ivec3& face, BlockType(&result)[16][16]) {
-	// get coordinates of a random block
-	vmath::ivec3 coords = { 0, 0, 0 };
-	coords[layers_idx] = layer_no;
-	const vmath::ivec3 face_coords = coords + face;
+// is_face_visible for every pair of block types, indexed by [block][face_block]
+static const std::array<std::bitset<MAX_BLOCK_TYPES>, MAX_BLOCK_TYPES>& face_visibility_table() {
+	static const auto table = [] {
+		std::array<std::bitset<MAX_BLOCK_TYPES>, MAX_BLOCK_TYPES> result;
+		for (int block = 0; block < MAX_BLOCK_TYPES; block++) {
+			for (int face_block = 0; face_block < MAX_BLOCK_TYPES; face_block++) {
+				result[block][face_block] = is_face_visible(BlockType(static_cast<uint8_t>(block)), BlockType(static_cast<uint8_t>(face_block)));
+			}
+		}
+		return result;
+	}();
+	return table;
+}
+
+static inline bool is_face_visible_fast(const BlockType& block, const BlockType& face_block) {
+	return face_visibility_table()[static_cast<uint8_t>(block)][static_cast<uint8_t>(face_block)];
+}
+
+// how occluded each corner of a face is, from 0 (open) to 3 (tucked into a corner), packed like Quad2D::lighting
+// face_coords: the block the face is looking into
+uint8_t gen_face_ao(const PaddedMini& padded, const vmath::ivec3& face_coords, const int working_idx_1, const int working_idx_2) {
+	uint8_t result = 0;
+
+	for (int cv = 0; cv < 2; cv++) {
+		for (int cu = 0; cu < 2; cu++) {
+			// the 3 blocks touching this corner in front of the face
+			vmath::ivec3 side_1 = face_coords;
+			side_1[working_idx_1] += cu ? 1 : -1;
 
-	// figure out which mini has our face layer (usually ours)
-	std::shared_ptr<MiniChunk> mini = req->data->self;
-	std::shared_ptr<MiniChunk> face_mini = nullptr;
-	if (in_range(face_coords, vmath::ivec3(0, 0, 0), vmath::ivec3(15, 15, 15))) {
-		face_mini = mini;
+			vmath::ivec3 side_2 = face_coords;
+			side_2[working_idx_2] += cv ? 1 : -1;
+
+			vmath::ivec3 corner = side_1;
+			corner[working_idx_2] += cv ? 1 : -1;
+
+			const int occluded_1 = !padded.get(side_1).is_translucent();
+			const int occluded_2 = !padded.get(side_2).is_translucent();
+			const int occluded_corner = !padded.get(corner).is_translucent();
+
+			// both sides => fully occluded, even if the corner's open
+			const int occlusion = occluded_1 && occluded_2 ? 3 : occluded_1 + occluded_2 + occluded_corner;
+			result |= occlusion << (2 * (cu + 2 * cv));
+		}
 	}
-	else {
-		const auto face_mini_coords = mini->get_coords() + (layers_idx == 1 ? vmath::ivec3(face * 16) : face);
 
-#define SET_COORDS(ATTR)\
-			if (face_mini == nullptr && req->data->ATTR && req->data->ATTR->get_coords() == face_mini_coords)\
-			{\
-				face_mini = req->data->ATTR;\
+	return result;
+}
+
+static inline bool is_liquid(const BlockType& block) {
+	return block == BlockType::StillWater || block == BlockType::FlowingWater;
+}
+
+// how far one of a liquid's top corners sits below the top of its block, in eighths (0 = full, 7 = almost empty)
+// averages the heights of the 4 blocks around the corner, like Minecraft does:
+//   liquid on top of any of them => full
+//   liquid => its height (still = 8, flowing = level + 1)
+//   other non-solid (air) => 0, so edges slope down towards it
+//   solid => ignored
+// corner_x, corner_z: which corner of the block at coords, 0 or 1 along each axis
+int liquid_corner_drop(const PaddedMini& padded, const vmath::ivec3& coords, const int corner_x, const int corner_z) {
+	int height_sum = 0;
+	int num_heights = 0;
+
+	for (int dz = corner_z - 1; dz <= corner_z; dz++) {
+		for (int dx = corner_x - 1; dx <= corner_x; dx++) {
+			const vmath::ivec3 side_coords = coords + vmath::ivec3(dx, 0, dz);
+
+			if (is_liquid(padded.get(side_coords + IUP))) {
+				return 0;
+			}
+
+			const BlockType side_block = padded.get(side_coords);
+			if (side_block == BlockType::StillWater) {
+				height_sum += 8;
+				num_heights++;
 			}
+			else if (side_block == BlockType::FlowingWater) {
+				height_sum += padded.get_metadata(side_coords).get_liquid_level() + 1;
+				num_heights++;
+			}
+			else if (side_block.is_nonsolid()) {
+				num_heights++;
+			}
+		}
+	}
+
+	// (coords is a liquid, so there's always at least 1 height)
+	assert(num_heights > 0);
+	const int height = (height_sum + num_heights / 2) / num_heights;
+	return std::clamp(8 - height, 0, 7);
+}
 
-		SET_COORDS(up);
-		SET_COORDS(down);
-		SET_COORDS(north);
-		SET_COORDS(south);
-		SET_COORDS(east);
-		SET_COORDS(west);
-#undef SET_COORDS
+// how far each corner of a liquid's face sits below the top of the block, 4 bits each, packed like Quad2D::liquid_drops
+// only corners along the top of the block ever drop
+uint16_t gen_face_liquid_drops(const PaddedMini& padded, const vmath::ivec3& coords, const int layers_idx, const vmath::ivec3& face, const int working_idx_1, const int working_idx_2) {
+	uint16_t result = 0;
+
+	for (int cv = 0; cv < 2; cv++) {
+		for (int cu = 0; cu < 2; cu++) {
+			// corner's position within the block
+			vmath::ivec3 corner = { 0, 0, 0 };
+			corner[layers_idx] = face[layers_idx] > 0 ? 1 : 0;
+			corner[working_idx_1] = cu;
+			corner[working_idx_2] = cv;
+
+			if (corner[1] == 1) {
+				result |= liquid_corner_drop(padded, coords, corner[0], corner[2]) << (4 * (cu + 2 * cv));
+			}
+		}
 	}
 
-	// generate layer
-	gen_layer_generalized(mini, face_mini, layers_idx, layer_no, face, result);
+	return result;
 }
 
-// given 2D array of block numbers, generate optimal quads
-std::vector<Quad2D> gen_quads(const BlockType(&layer)[16][16], /* const Metadata(&metadata_layer)[16][16], */ bool(&merged)[16][16]) {
+// convert per-corner values (e.g. ambient occlusion) from layer corner order to the order the geometry shader emits the quad's vertices in
+uint16_t corners_to_vertex_order(const Quad3D& quad, const int layers_idx, const uint16_t corners, const int bits_per_corner) {
+	// all zero looks the same in any order
+	if (corners == 0) {
+		return 0;
+	}
+
+	int working_idx_1, working_idx_2;
+	gen_working_indices(layers_idx, working_idx_1, working_idx_2);
+
+	// same as render_quads.gs.glsl
+	const vmath::ivec3 diffs = quad.corner2 - quad.corner1;
+	int gs_idx_1 = layers_idx == 0 ? 1 : 0;
+	int gs_idx_2 = layers_idx == 2 ? 1 : 2;
+	if (diffs[0] == 0) {
+		std::swap(gs_idx_1, gs_idx_2);
+	}
+
+	vmath::ivec3 vertices[4] = { quad.corner1, quad.corner1, quad.corner1, quad.corner2 };
+	vertices[1][gs_idx_1] += diffs[gs_idx_1];
+	vertices[2][gs_idx_2] += diffs[gs_idx_2];
+
+	// figure out which layer corner each vertex is at
+	const int max_u = std::max(quad.corner1[working_idx_1], quad.corner2[working_idx_1]);
+	const int max_v = std::max(quad.corner1[working_idx_2], quad.corner2[working_idx_2]);
+	const int mask = (1 << bits_per_corner) - 1;
+
+	uint16_t result = 0;
+	for (int k = 0; k < 4; k++) {
+		const int cu = vertices[k][working_idx_1] == max_u;
+		const int cv = vertices[k][working_idx_2] == max_v;
+		const int value = (corners >> (bits_per_corner * (cu + 2 * cv))) & mask;
+		result |= value << (bits_per_corner * k);
+	}
+
+	return result;
+}
+
+// generate layer by grabbing blocks and their face blocks from the padded mini
+void gen_layer(const PaddedMini& padded, const int layers_idx, const int layer_no, const vmath::ivec3& face, const MeshingOptions& options, LayerFace(&result)[16][16]) {
+	// most efficient to traverse working_idx_1 then working_idx_2;
+	int working_idx_1, working_idx_2;
+	gen_working_indices(layers_idx, working_idx_1, working_idx_2);
+
+	// coordinates of current block
+	vmath::ivec3 coords = { 0, 0, 0 };
+	coords[layers_idx] = layer_no;
+
+	// for each coordinate
+	for (int v = 0; v < 16; v++) {
+		for (int u = 0; u < 16; u++) {
+			coords[working_idx_1] = u;
+			coords[working_idx_2] = v;
+
+			// reset to air
+			LayerFace& layer_face = result[u][v];
+			layer_face = LayerFace();
+
+			// get block at these coordinates
+			const BlockType block = padded.get(coords);
+
+			// skip air blocks
+			if (block == BlockType::Air) {
+				continue;
+			}
+
+			// skip hidden faces
+			const vmath::ivec3 face_coords = coords + face;
+			const BlockType face_block = padded.get(face_coords);
+			const bool liquid = is_liquid(block);
+			const uint16_t liquid_drops = liquid && !is_liquid(face_block) ? gen_face_liquid_drops(padded, coords, layers_idx, face, working_idx_1, working_idx_2) : 0;
+
+			// (a liquid's top is visible if it's been lowered, even if there's a block on top)
+			// (skirts are always visible)
+			const bool skirt = options.skirts && !liquid && face[1] == 0 && (face_coords[0] < 0 || face_coords[0] >= MINICHUNK_WIDTH || face_coords[2] < 0 || face_coords[2] >= MINICHUNK_DEPTH);
+			if (!is_face_visible_fast(block, face_block) && !(face[1] > 0 && liquid_drops != 0) && !skirt) {
+				continue;
+			}
+
+			layer_face.block = block;
+			layer_face.liquid_drops = liquid_drops;
+
+			// liquids are see-through, so don't darken them
+			if (options.ambient_occlusion && !liquid) {
+				layer_face.ao = gen_face_ao(padded, face_coords, working_idx_1, working_idx_2);
+			}
+		}
+	}
+}
+
+// given 2D array of block faces, generate optimal quads
+std::vector<Quad2D> gen_quads(const LayerFace(&layer)[16][16], bool(&merged)[16][16]) {
 	memset(merged, false, sizeof(merged));
 
 	std::vector<Quad2D> result;
@@ -222,23 +681,22 @@ std::vector<Quad2D> gen_quads(const BlockType(&layer)[16][16], /* const Metadata
 			// skip merged blocks
 			if (merged[i][j]) continue;
 
-			const BlockType block = layer[i][j];
+			const LayerFace& layer_face = layer[i][j];
 
 			// skip air
-			if (block == BlockType::Air) continue;
+			if (layer_face.block == BlockType::Air) continue;
 
 			// get max size of this quad
-			const vmath::ivec2 max_size = get_max_size(layer, merged, { i, j }, block);
+			const vmath::ivec2 max_size = get_max_size(layer, merged, { i, j }, layer_face);
 
 			// add it to results
 			const vmath::ivec2 start = { i, j };
 			Quad2D q;
-			q.block = block;
+			q.block = layer_face.block;
 			q.corners[0] = start;
 			q.corners[1] = start + max_size;
-			//if (block == BlockType::FlowingWater) {
-			//	q.metadata = metadata_layer[i][j];
-			//}
+			q.lighting = layer_face.ao;
+			q.liquid_drops = layer_face.liquid_drops;
 
 			// mark all as merged
 			mark_as_merged(merged, start, max_size);
@@ -260,8 +718,9 @@ void mark_as_merged(bool(&merged)[16][16], const vmath::ivec2& start, const vmat
 }
 
 // given a layer and start point, find its best dimensions
-vmath::ivec2 get_max_size(const BlockType(&layer)[16][16], const bool(&merged)[16][16], const vmath::ivec2& start_point, const BlockType& block_type) {
-	assert(block_type != BlockType::Air);
+// faces only merge if their corners are equally occluded, otherwise the shading would stretch across the whole quad
+vmath::ivec2 get_max_size(const LayerFace(&layer)[16][16], const bool(&merged)[16][16], const vmath::ivec2& start_point, const LayerFace& layer_face) {
+	assert(layer_face.block != BlockType::Air);
 	assert(!merged[start_point[0]][start_point[1]] && "bruh");
 
 	// TODO: Search width with find() instead of a for loop?
@@ -270,14 +729,14 @@ vmath::ivec2 get_max_size(const BlockType(&layer)[16][16], const bool(&merged)[1
 	vmath::ivec2 max_size = { 1, 1 };
 
 	// no meshing of flowing water -- TODO: allow meshing if max height? (I.e. if it's flowing straight down.)
-	if (block_type == BlockType::FlowingWater) {
+	if (layer_face.block == BlockType::FlowingWater) {
 		return max_size;
 	}
 
 	// maximize height first, because it's better memory-wise
 	for (int j = start_point[1] + 1, i = start_point[0]; j < 16; j++) {
 		// if extended by 1, add 1 to max height
-		if (layer[i][j] == block_type && !merged[i][j]) {
+		if (layer[i][j] == layer_face && !merged[i][j]) {
 			max_size[1]++;
 		}
 		// else give up
@@ -294,7 +753,7 @@ vmath::ivec2 get_max_size(const BlockType(&layer)[16][16], const bool(&merged)[1
 		// check if entire height is correct
 		for (int j = start_point[1]; j < start_point[1] + max_size[1]; j++) {
 			// if wrong block type, give up on extending width
-			if (layer[i][j] != block_type || merged[i][j]) {
+			if (layer[i][j] != layer_face || merged[i][j]) {
 				stop = true;
 				break;
 			}
@@ -311,47 +770,268 @@ vmath::ivec2 get_max_size(const BlockType(&layer)[16][16], const bool(&merged)[1
 	return max_size;
 }
 
-MeshGenResult* gen_minichunk_mesh_from_req(std::shared_ptr<MeshGenRequest> req) {
-	// update invisibility
-	bool invisible = req->data->self->all_air() || check_if_covered(req);
+static inline uint64_t mix64(uint64_t x) {
+	x ^= x >> 33;
+	x *= 0xff51afd7ed558ccdULL;
+	x ^= x >> 33;
+	x *= 0xc4ceb9fe1a85ec53ULL;
+	x ^= x >> 33;
+	return x;
+}
 
-	// if visible, update mesh
-	std::unique_ptr<MiniChunkMesh> non_water;
-	std::unique_ptr<MiniChunkMesh> water;
-	if (!invisible) {
-		const std::unique_ptr<MiniChunkMesh> mesh = gen_minichunk_mesh(req);
+static inline void hash_combine(uint64_t& h, const uint64_t v) {
+	h = mix64(h ^ v) + 0x9e3779b97f4a7c15ULL;
+}
+
+// what a neighbor's block looks like to the blocks around it, as far as meshing's concerned
+// 0 = air, 1 = translucent, 2 = opaque, +3 if non-solid, or 8 + height - 1 if liquid
+static inline uint64_t border_key(const BlockType& block, const Metadata& metadata) {
+	if (block == BlockType::StillWater) {
+		return 15;
+	}
+	if (block == BlockType::FlowingWater) {
+		return 8 + metadata.get_liquid_level();
+	}
+	const uint64_t visibility = block.is_transparent() ? 0 : block.is_translucent() ? 1 : 2;
+	return block.is_nonsolid() && !block.is_transparent() ? visibility + 3 : visibility;
+}
 
-		non_water = std::make_unique<MiniChunkMesh>();
-		water = std::make_unique<MiniChunkMesh>();
+// expand a mini's intervals into an array, so that we don't do a map lookup per block
+template<typename T>
+static void expand_intervals(const IntervalMap<short, T>& intervals, T(&result)[MINICHUNK_SIZE]) {
+	auto iter = intervals.get_interval(0);
+	while (iter != intervals.end() && iter->first < MINICHUNK_SIZE) {
+		const auto next = std::next(iter);
+		const int start = std::max<int>(iter->first, 0);
+		const int end = next == intervals.end() ? MINICHUNK_SIZE : std::min<int>(next->first, MINICHUNK_SIZE);
+		std::fill(result + start, result + end, iter->second);
+		iter = next;
+	}
+}
+
+uint64_t hash_padded_mini(const std::shared_ptr<MeshGenRequest> req, const PaddedMini& padded, const MeshingOptions& options) {
+	const auto& data = req->data;
+	uint64_t h = 0;
 
-		for (auto& quad : mesh->get_quads()) {
-			if ((BlockType)quad.block == BlockType::StillWater || (BlockType)quad.block == BlockType::FlowingWater) {
-				water->add_quad(quad);
+	// our intervals
+	for (auto iter = data->self->blocks.get_interval(0); iter != data->self->blocks.end() && iter->first < MINICHUNK_SIZE; ++iter) {
+		hash_combine(h, (static_cast<uint64_t>(std::max<short>(iter->first, 0)) << 8) | static_cast<uint8_t>(iter->second));
+	}
+	hash_combine(h, 0xFFFFFFFF);
+	for (auto iter = data->self->metadatas.get_interval(0); iter != data->self->metadatas.end() && iter->first < MINICHUNK_SIZE; ++iter) {
+		hash_combine(h, (static_cast<uint64_t>(std::max<short>(iter->first, 0)) << 8) | static_cast<uint8_t>(iter->second));
+	}
+
+	// our border, 4 bits per block
+	// (edges and corners too: ambient occlusion and liquid surface heights both look at diagonal neighbors)
+	uint64_t word = 0;
+	int bits = 0;
+	for (int y = -1; y <= 16; y++) {
+		for (int z = -1; z <= 16; z++) {
+			for (int x = -1; x <= 16; x++) {
+				const int num_outside = (x < 0 || x > 15) + (y < 0 || y > 15) + (z < 0 || z > 15);
+				if (num_outside == 0) {
+					continue;
+				}
+
+				const int idx = PaddedMini::idx(x, y, z);
+				word |= border_key(padded.blocks[idx], padded.metadatas[idx]) << bits;
+				bits += 4;
+				if (bits == 64) {
+					hash_combine(h, word);
+					word = 0;
+					bits = 0;
+				}
 			}
-			else {
-				non_water->add_quad(quad);
+		}
+	}
+
+	// our lod borders, same way (whether we're covered at a coarser level depends on them, even if we don't mesh it)
+	for (int lod = 1; lod < MESH_LOD_LEVELS; lod++) {
+		const int num_cells = MINICHUNK_WIDTH >> lod;
+		for (int direction = 0; direction < MESH_DIRECTIONS; direction++) {
+			for (int u = 0; u < num_cells; u++) {
+				for (int v = 0; v < num_cells; v++) {
+					word |= border_key(padded.lod_borders[lod - 1][direction][u][v], Metadata()) << bits;
+					bits += 4;
+					if (bits == 64) {
+						hash_combine(h, word);
+						word = 0;
+						bits = 0;
+					}
+				}
 			}
 		}
+	}
+	hash_combine(h, word);
+
+	// missing neighbors (padded as air, but check_if_covered treats them differently)
+	const uint64_t missing =
+		(data->north == nullptr) << 0 |
+		(data->south == nullptr) << 1 |
+		(data->east == nullptr) << 2 |
+		(data->west == nullptr) << 3 |
+		(data->up == nullptr) << 4 |
+		(data->down == nullptr) << 5;
+	hash_combine(h, missing);
+
+	// options
+	hash_combine(h, options.ambient_occlusion);
+	hash_combine(h, options.lods);
+	hash_combine(h, options.skirts);
+
+	return h;
+}
+
+uint64_t hash_mesh_gen_request(const std::shared_ptr<MeshGenRequest> req, const MeshingOptions& options) {
+	PaddedMini padded;
+	fill_padded_mini(req, padded);
+	return hash_padded_mini(req, padded, options);
+}
+
+MeshGenResult* gen_minichunk_mesh_from_req(std::shared_ptr<MeshGenRequest> req, MeshCache* cache, const MeshingOptions& options) {
+	// all air => invisible, nothing to mesh (but still post it, so that whoever's rendering the old mesh knows to stop)
+	if (req->data->self->all_air()) {
+		return new MeshGenResult(req->data->self->get_coords(), true, nullptr, nullptr);
+	}
+
+	// we need this with or without a cache
+	PaddedMini padded;
+	fill_padded_mini(req, padded);
 
-		assert(mesh->size() == non_water->size() + water->size());
+	if (cache == nullptr) {
+		MeshCacheEntry entry;
+		return gen_minichunk_mesh_uncached(req, padded, options, entry);
 	}
 
-	// post result
-	MeshGenResult* result = nullptr;
-	if (non_water || water)
-	{
-		result = new MeshGenResult(req->data->self->get_coords(), invisible, std::move(non_water), std::move(water));
+	MeshCacheStats& stats = mesh_cache_stats();
+
+	const auto hash_start = std::chrono::high_resolution_clock::now();
+	const uint64_t key = hash_padded_mini(req, padded, options);
+	const auto hash_end = std::chrono::high_resolution_clock::now();
+	stats.hash_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(hash_end - hash_start).count();
+
+	// hit => share the mesh
+	MeshCacheEntry entry;
+	if (cache->find(key, entry)) {
+		stats.hits++;
+		stats.saved_ns += entry.mesh_ns;
+		MeshGenResult* result = new MeshGenResult(req->data->self->get_coords(), entry.invisible, entry.mesh, entry.water_mesh);
+		std::copy(std::begin(entry.lods), std::end(entry.lods), std::begin(result->lods));
+		return result;
 	}
 
-	// generated result
+	// miss => mesh it and remember it
+	MeshGenResult* result = gen_minichunk_mesh_uncached(req, padded, options, entry);
+	const auto mesh_end = std::chrono::high_resolution_clock::now();
+
+	entry.mesh_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(mesh_end - hash_end).count();
+	stats.misses++;
+	stats.miss_ns += entry.mesh_ns;
+	cache->insert(key, entry);
+
 	return result;
 }
 
-std::unique_ptr<MiniChunkMesh> gen_minichunk_mesh(std::shared_ptr<MeshGenRequest> req) {
+MeshGenResult* gen_minichunk_mesh_uncached(std::shared_ptr<MeshGenRequest> req, const PaddedMini& padded, const MeshingOptions& options, MeshCacheEntry& entry) {
+	// update invisibility
+	const bool all_air = req->data->self->all_air();
+	const bool covered = all_air || check_if_covered(req, padded);
+	bool invisible = covered;
+
+	// coarser meshes: no ambient occlusion (too small to see), and skirts to cover up cracks
+	MeshingOptions lod_options = options;
+	lod_options.ambient_occlusion = false;
+	lod_options.lods = false;
+	lod_options.skirts = true;
+
+	// (even if we're covered at full resolution, what covers us might get downsampled away, e.g. a 1-block layer of stone above us,
+	//  so we're only invisible if we're covered at every level)
+	MiniChunkLodMeshes lods[MESH_LOD_LEVELS - 1];
+	if (!all_air && (options.lods || covered)) {
+		PaddedMini downsampled;
+		for (int lod = 1; lod < MESH_LOD_LEVELS; lod++) {
+			if (covered && check_if_lod_border_covers(req, padded, lod)) {
+				continue;
+			}
+
+			downsample_padded_mini(padded, lod, downsampled);
+			if (covered && check_if_covered(req, downsampled)) {
+				continue;
+			}
+			invisible = false;
+
+			// (only needed to know whether we show)
+			if (!options.lods) {
+				break;
+			}
+
+			const std::unique_ptr<MiniChunkMesh> lod_mesh = gen_minichunk_mesh(downsampled, lod_options);
+
+			std::shared_ptr<MiniChunkMesh> lod_non_water, lod_water;
+			split_water_mesh(*lod_mesh, lod_non_water, lod_water);
+			lods[lod - 1] = { lod_non_water, lod_water };
+		}
+	}
+
+	// if visible, update mesh
+	// (covered at full resolution => nothing to mesh, we're only showing at a coarser level)
+	std::shared_ptr<MiniChunkMesh> non_water;
+	std::shared_ptr<MiniChunkMesh> water;
+	if (!invisible) {
+		const std::unique_ptr<MiniChunkMesh> mesh = covered ? std::make_unique<MiniChunkMesh>() : gen_minichunk_mesh(padded, options);
+		split_water_mesh(*mesh, non_water, water);
+
+		// (levels we're covered at get empty meshes, so that it's clear we have them)
+		if (options.lods) {
+			for (auto& lod_meshes : lods) {
+				if (lod_meshes.mesh == nullptr) {
+					lod_meshes = { std::make_shared<MiniChunkMesh>(), std::make_shared<MiniChunkMesh>() };
+				}
+			}
+		}
+	}
+
+	entry.invisible = invisible;
+	entry.mesh = non_water;
+	entry.water_mesh = water;
+	std::copy(std::begin(lods), std::end(lods), std::begin(entry.lods));
+
+	// post result (even if invisible, so that whoever's rendering the old mesh knows to stop)
+	MeshGenResult* result = new MeshGenResult(req->data->self->get_coords(), invisible, non_water, water);
+	std::copy(std::begin(lods), std::end(lods), std::begin(result->lods));
+	return result;
+}
+
+// split a mesh into its water and non-water quads
+// (keeps them in order, so they stay grouped by face direction like gen_minichunk_mesh made them)
+void split_water_mesh(const MiniChunkMesh& mesh, std::shared_ptr<MiniChunkMesh>& non_water, std::shared_ptr<MiniChunkMesh>& water) {
+	non_water = std::make_shared<MiniChunkMesh>();
+	water = std::make_shared<MiniChunkMesh>();
+
+	for (auto& quad : mesh.get_quads()) {
+		if ((BlockType)quad.block == BlockType::StillWater || (BlockType)quad.block == BlockType::FlowingWater) {
+			water->add_quad(quad);
+		}
+		else {
+			non_water->add_quad(quad);
+		}
+	}
+
+	assert(mesh.size() == non_water->size() + water->size());
+}
+
+std::unique_ptr<MiniChunkMesh> gen_minichunk_mesh(std::shared_ptr<MeshGenRequest> req, const MeshingOptions& options) {
+	PaddedMini padded;
+	fill_padded_mini(req, padded);
+	return gen_minichunk_mesh(padded, options);
+}
+
+std::unique_ptr<MiniChunkMesh> gen_minichunk_mesh(const PaddedMini& padded, const MeshingOptions& options) {
 	// got our mesh
 	std::unique_ptr<MiniChunkMesh> mesh = std::make_unique<MiniChunkMesh>();
 
-	// for all 6 sides
+	// for all 6 sides (so quads come out grouped by face direction: -x, -y, -z, +x, +y, +z)
 	for (int i = 0; i < 6; i++) {
 		bool backface = i < 3;
 		int layers_idx = i % 3;
@@ -368,11 +1048,11 @@ std::unique_ptr<MiniChunkMesh> gen_minichunk_mesh(std::shared_ptr<MeshGenRequest
 
 		// for each layer
 		for (int i = 0; i < 16; i++) {
-			BlockType layer[16][16];
+			LayerFace layer[16][16];
 			bool merged[16][16];
 
 			// extract it from the data
-			gen_layer(req, layers_idx, i, face, layer);
+			gen_layer(padded, layers_idx, i, face, options, layer);
 
 			// get quads from layer
 			std::vector<Quad2D> quads2d = gen_quads(layer, merged);
@@ -400,6 +1080,12 @@ std::unique_ptr<MiniChunkMesh> gen_minichunk_mesh(std::shared_ptr<MeshGenRequest
 				}
 			}
 
+			// put ambient occlusion and liquid drops in the order the vertices get drawn
+			for (auto& quad : quads) {
+				quad.lighting = static_cast<uint8_t>(corners_to_vertex_order(quad, layers_idx, quad.lighting, 2));
+				quad.liquid_drops = corners_to_vertex_order(quad, layers_idx, quad.liquid_drops, 4);
+			}
+
 			// append quads
 			for (auto quad : quads) {
 				mesh->add_quad(quad);
@@ -1,9 +1,30 @@
 #pragma once
 
+#include "mesh_cache.h"
 #include "minichunkmesh.h"
 #include "world_utils.h"
 
+#include <cstdint>
 #include <memory>
 
-MeshGenResult* gen_minichunk_mesh_from_req(std::shared_ptr<MeshGenRequest> req);
-std::unique_ptr<MiniChunkMesh> gen_minichunk_mesh(std::shared_ptr<MeshGenRequest> req);
+// knobs for meshing (mostly so they can be compared)
+struct MeshingOptions
+{
+	// darken vertices that are tucked into corners
+	bool ambient_occlusion = true;
+
+	// also generate coarser meshes for drawing far away (see MESH_LOD_LEVELS)
+	// (whether we're invisible doesn't depend on it, so a mini meshed without them can be re-meshed with them later)
+	bool lods = true;
+
+	// show the sides of blocks along our north/south/east/west edges even if they're covered,
+	// so that there's no cracks between us and a neighbor that's at a different level of detail
+	bool skirts = false;
+};
+
+// if a cache is given, identical minis share the same mesh instead of re-meshing
+MeshGenResult* gen_minichunk_mesh_from_req(std::shared_ptr<MeshGenRequest> req, MeshCache* cache = nullptr, const MeshingOptions& options = {});
+
+// hash everything that affects a mini's mesh: its own intervals, and what the blocks around it look like
+uint64_t hash_mesh_gen_request(const std::shared_ptr<MeshGenRequest> req, const MeshingOptions& options = {});
+std::unique_ptr<MiniChunkMesh> gen_minichunk_mesh(std::shared_ptr<MeshGenRequest> req, const MeshingOptions& options = {});
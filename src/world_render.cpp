@@ -3,13 +3,17 @@
 #include "messaging.h"
 #include "minichunkmesh.h"
 #include "shapes.h"
+#include "water_sorter.h"
 #include "world_utils.h"
 
 #include "vmath.h"
-#include "zmq_addon.hpp"
 
+#include <algorithm>
 #include <vector>
 
+// most water sorts to wait on at once (if the sorter falls further behind than this, we forget the oldest)
+constexpr size_t MAX_PENDING_WATER_SORTS = 8;
+
 // radius from center of minichunk that must be included in view frustum
 constexpr float FRUSTUM_MINI_RADIUS_ALLOWANCE = 28.0f;
 
@@ -18,17 +22,24 @@ bool mini_in_frustum(const MiniRender* mini, const vmath::vec4(&planes)[6]) {
 	return sphere_in_frustum(mini->center_coords_v3(), FRUSTUM_MINI_RADIUS_ALLOWANCE, planes);
 }
 
-WorldRenderPart::WorldRenderPart(std::shared_ptr<zmq::context_t> ctx_) : bus(ctx_)
-{
-#ifdef _DEBUG
-	bus.out.setsockopt(ZMQ_SUBSCRIBE, "", 0);
-#else
-	for (const auto& m : msg::render_thread_incoming)
-	{
-		// TODO: Upgrade zmq and replace this with .set()
-		bus.out.setsockopt(ZMQ_SUBSCRIBE, m.c_str(), m.size());
+// pick a mini's level of detail given its distance (in chunks) and its current level
+int choose_lod(const float distance, const int current_lod) {
+	int lod = current_lod;
+
+	// only switch once we're clearly past the boundary
+	while (lod < MESH_LOD_LEVELS - 1 && distance > LOD_DISTANCES[lod] + LOD_HYSTERESIS) {
+		lod++;
 	}
-#endif // _DEBUG
+	while (lod > 0 && distance < LOD_DISTANCES[lod - 1] - LOD_HYSTERESIS) {
+		lod--;
+	}
+
+	return lod;
+}
+
+WorldRenderPart::WorldRenderPart() : bus(MESH_RESPONSE_CAPACITY)
+{
+	bus.subscribe(msg::render_thread_incoming);
 }
 
 // get mini render component or nullptr
@@ -62,33 +73,54 @@ std::shared_ptr<MiniRender> WorldRenderPart::get_mini_render_component_or_genera
 
 void WorldRenderPart::handle_messages()
 {
-	std::vector<zmq::message_t> message;
-	auto ret = zmq::recv_multipart(bus.out, std::back_inserter(message), zmq::recv_flags::dontwait);
-	while (ret)
+	Message message;
+	while (bus.recv(message))
 	{
+		switch (message.topic)
+		{
 		// Handle generated meshes
-		if (message[0].to_string_view() == msg::MESH_GEN_RESPONSE)
+		case msg::MESH_GEN_RESPONSE:
 		{
 			// Extract result
-			MeshGenResult* mesh_ = *message[1].data<MeshGenResult*>();
-			std::unique_ptr<MeshGenResult> mesh(mesh_);
+			std::unique_ptr<MeshGenResult> mesh = message.take<MeshGenResult>();
+			lod_requests.erase(mesh->coords);
 
+			// Covered => stop drawing it (if we ever were)
+			if (mesh->invisible)
+			{
+				std::shared_ptr<MiniRender> mini = get_mini_render_component(mesh->coords);
+				if (mini)
+				{
+					mini->set_invisible(true);
+				}
+			}
 			// Update mesh!
-			std::shared_ptr<MiniRender> mini = get_mini_render_component_or_generate(mesh->coords);
-			mini->set_mesh(std::move(mesh->mesh));
-			mini->set_water_mesh(std::move(mesh->water_mesh));
+			else
+			{
+				std::shared_ptr<MiniRender> mini = get_mini_render_component_or_generate(mesh->coords);
+				mini->set_mesh(std::move(mesh->mesh));
+				mini->set_water_mesh(std::move(mesh->water_mesh));
+				for (int lod = 1; lod < MESH_LOD_LEVELS; lod++)
+				{
+					mini->set_lod_meshes(lod, mesh->lods[lod - 1]);
+				}
+				mini->set_invisible(false);
+			}
+			break;
 		}
-		else if (message[0].to_string_view() == msg::EVENT_PLAYER_MOVED_CHUNKS)
+		case msg::WATER_SORT_RESPONSE:
 		{
-			// TODO: Pop meshes that are too far away, request meshes for chunks that are nearby
+			std::unique_ptr<WaterSortResponse> response = message.take<WaterSortResponse>();
+			on_water_sort_response(*response);
+			break;
+		}
+		default:
+			break;
 		}
-
-		message.clear();
-		ret = zmq::recv_multipart(bus.out, std::back_inserter(message), zmq::recv_flags::dontwait);
 	}
 }
 
-void WorldRenderPart::render(OpenGLInfo* glInfo, GlfwInfo* windowInfo, const vmath::vec4(&planes)[6], const vmath::ivec3& staring_at) {
+void WorldRenderPart::render(OpenGLInfo* glInfo, GlfwInfo* windowInfo, const vmath::vec4(&planes)[6], const vmath::ivec3& staring_at, const vmath::vec4& player_coords) {
 	// collect all the minis we're gonna draw
 	std::vector<MiniRender*> minis_to_draw;
 
@@ -103,6 +135,20 @@ void WorldRenderPart::render(OpenGLInfo* glInfo, GlfwInfo* windowInfo, const vma
 		}
 	}
 
+	// pick levels of detail based on (horizontal) distance to player
+	const vmath::vec2 player_chunk_coords = { player_coords[0] / CHUNK_WIDTH, player_coords[2] / CHUNK_DEPTH };
+	for (auto& mini : minis_to_draw) {
+		const vmath::vec3 center = mini->center_coords_v3();
+		const float distance = vmath::length(vmath::vec2(center[0] / CHUNK_WIDTH, center[2] / CHUNK_DEPTH) - player_chunk_coords);
+		mini->set_lod(lod_enabled ? choose_lod(distance, mini->get_lod()) : 0);
+	}
+	request_lod_meshes(minis_to_draw);
+
+	stats = {};
+
+	// sort water for next frame
+	request_water_sort(minis_to_draw, player_coords);
+
 	if (minis_to_draw.size() == 0) return;
 
 	// draw them
@@ -118,8 +164,15 @@ void WorldRenderPart::render(OpenGLInfo* glInfo, GlfwInfo* windowInfo, const vma
 	glEnable(GL_BLEND);
 
 	// draw terrain
+	const vmath::vec3 camera_coords = { player_coords[0], player_coords[1] + CAMERA_HEIGHT, player_coords[2] };
+	for (auto& mini : minis_to_draw) {
+		stats.drawn_quads += mini->render_meshes(glInfo, face_culling_enabled ? mini->facing_directions(camera_coords) : ALL_FACE_DIRECTIONS);
+	}
+
+	// (meshes are uploaded by now)
 	for (auto& mini : minis_to_draw) {
-		mini->render_meshes(glInfo);
+		stats.minis[mini->get_lod()]++;
+		stats.quads[mini->get_lod()] += mini->num_quads();
 	}
 
 	// highlight block
@@ -133,9 +186,9 @@ void WorldRenderPart::render(OpenGLInfo* glInfo, GlfwInfo* windowInfo, const vma
 	glClearBufferfv(GL_DEPTH, 0, &one);
 	glDisable(GL_BLEND); // DEBUG
 
-	// draw water onto water fbo
-	for (auto& mini : minis_to_draw) {
-		mini->render_water_meshes(glInfo);
+	// draw water onto water fbo (back-to-front)
+	for (auto& mini : order_water_minis(minis_to_draw)) {
+		stats.drawn_quads += mini->render_water_meshes(glInfo, face_culling_enabled ? mini->facing_directions(camera_coords) : ALL_FACE_DIRECTIONS);
 	}
 
 	// merge water fbo onto terrain fbo
@@ -150,6 +203,94 @@ void WorldRenderPart::render(OpenGLInfo* glInfo, GlfwInfo* windowInfo, const vma
 	rendered++;
 }
 
+void WorldRenderPart::request_water_sort(const std::vector<MiniRender*>& minis, const vmath::vec4& player_coords) {
+	if (std::none_of(minis.begin(), minis.end(), [](const MiniRender* mini) { return mini->has_water(); })) {
+		return;
+	}
+
+	auto req = std::make_unique<WaterSortRequest>();
+	req->frame = rendered;
+	req->camera_coords = { player_coords[0], player_coords[1] + CAMERA_HEIGHT, player_coords[2] };
+
+	PendingWaterSort pending;
+	pending.frame = rendered;
+	for (auto& mini : minis) {
+		if (mini->has_water()) {
+			req->minis.push_back(mini->get_coords());
+			pending.minis.push_back(mini);
+		}
+	}
+
+	// (if the sorter's inbox is full, we'll ask again next frame)
+	if (bus.send(Message(msg::WATER_SORT_REQUEST, std::move(req)))) {
+		pending_water_sorts.push_back(std::move(pending));
+		if (pending_water_sorts.size() > MAX_PENDING_WATER_SORTS) {
+			pending_water_sorts.pop_front();
+		}
+	}
+}
+
+void WorldRenderPart::on_water_sort_response(const WaterSortResponse& response) {
+	// forget requests that won't be answered now
+	while (!pending_water_sorts.empty() && pending_water_sorts.front().frame < response.frame) {
+		pending_water_sorts.pop_front();
+	}
+
+	// (we already gave up on it)
+	if (pending_water_sorts.empty() || pending_water_sorts.front().frame != response.frame) {
+		return;
+	}
+
+	for (auto& mini : water_order) {
+		mini->set_water_sort_index(-1);
+	}
+
+	const PendingWaterSort& pending = pending_water_sorts.front();
+	water_order.clear();
+	water_order.reserve(response.order.size());
+	for (const uint32_t i : response.order) {
+		MiniRender* mini = pending.minis[i];
+		mini->set_water_sort_index(static_cast<int>(water_order.size()));
+		water_order.push_back(mini);
+	}
+
+	pending_water_sorts.pop_front();
+}
+
+std::vector<MiniRender*> WorldRenderPart::order_water_minis(const std::vector<MiniRender*>& minis) {
+	std::vector<MiniRender*> result;
+	for (auto& mini : minis) {
+		if (mini->has_water()) {
+			result.push_back(mini);
+		}
+	}
+
+	// haven't been sorted yet (index -1) => don't know where they go, so draw them first
+	std::sort(result.begin(), result.end(), [](const MiniRender* lhs, const MiniRender* rhs) { return lhs->get_water_sort_index() < rhs->get_water_sort_index(); });
+
+	return result;
+}
+
+void WorldRenderPart::request_lod_meshes(const std::vector<MiniRender*>& minis) {
+	std::vector<vmath::ivec3> requested;
+	for (auto& mini : minis) {
+		if (mini->get_lod() > 0 && !mini->has_lod_meshes() && lod_requests.insert(mini->get_coords()).second) {
+			requested.push_back(mini->get_coords());
+		}
+	}
+
+	if (requested.empty()) {
+		return;
+	}
+
+	// world's inbox is full => forget we asked, so that we ask again next frame
+	if (!bus.send(Message(msg::MESH_LOD_REQUEST, std::make_unique<std::vector<vmath::ivec3>>(requested)))) {
+		for (const auto& coords : requested) {
+			lod_requests.erase(coords);
+		}
+	}
+}
+
 void WorldRenderPart::highlight_block(const OpenGLInfo* glInfo, const GlfwInfo* windowInfo, const int x, const int y, const int z) {
 	// Figure out mini-relative quads
 	Quad3D quads[6];
@@ -163,6 +304,7 @@ void WorldRenderPart::highlight_block(const OpenGLInfo* glInfo, const GlfwInfo*
 		quads[i].block = BlockType::Outline; // outline
 		quads[i].lighting = 0; // TODO: set to max instead?
 		quads[i].metadata = 0;
+		quads[i].liquid_drops = 0;
 	}
 
 	// SOUTH
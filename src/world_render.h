@@ -3,15 +3,39 @@
 #include "messaging.h"
 #include "minichunk.h" // renderer part
 
-#include "zmq.hpp"
-
+#include <cstdint>
+#include <deque>
 #include <memory>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// pick a mini's level of detail given its distance (in chunks) and its current level
+int choose_lod(const float distance, const int current_lod);
+
+// what the last frame drew (for debug info)
+struct WorldRenderStats
+{
+	int minis[MESH_LOD_LEVELS] = {};
+	int quads[MESH_LOD_LEVELS] = {};
+
+	// quads actually drawn, after skipping faces that point away from the camera
+	int drawn_quads = 0;
+};
+
+struct WaterSortResponse;
+
+// a water sort we've asked for, and the minis its response's indices refer to
+struct PendingWaterSort
+{
+	uint64_t frame;
+	std::vector<MiniRender*> minis;
+};
 
 class WorldRenderPart
 {
 public:
-	WorldRenderPart(std::shared_ptr<zmq::context_t> ctx_);
+	WorldRenderPart();
 
 	// get mini render component or nullptr
 	std::shared_ptr<MiniRender> get_mini_render_component(const int x, const int y, const int z);
@@ -22,13 +46,43 @@ public:
 	std::shared_ptr<MiniRender> get_mini_render_component_or_generate(const vmath::ivec3& xyz);
 
 	void handle_messages();
-	void render(OpenGLInfo* glInfo, GlfwInfo* windowInfo, const vmath::vec4(&planes)[6], const vmath::ivec3& staring_at);
+	void render(OpenGLInfo* glInfo, GlfwInfo* windowInfo, const vmath::vec4(&planes)[6], const vmath::ivec3& staring_at, const vmath::vec4& player_coords);
 
 	void highlight_block(const OpenGLInfo* glInfo, const GlfwInfo* windowInfo, const int x, const int y, const int z);
 	void highlight_block(const OpenGLInfo* glInfo, const GlfwInfo* windowInfo, const vmath::ivec3& xyz);
 
+	// draw far away minis at a lower level of detail
+	bool lod_enabled = true;
+
+	// skip minis' faces that point away from the camera
+	bool face_culling_enabled = true;
+
+	WorldRenderStats stats;
+
+private:
+	// ask the water sorter to sort these minis' water back-to-front
+	void request_water_sort(const std::vector<MiniRender*>& minis, const vmath::vec4& player_coords);
+
+	void on_water_sort_response(const WaterSortResponse& response);
+
+	// order to draw these minis' water in: back-to-front as of the last sort, after any minis the sort doesn't know about yet
+	std::vector<MiniRender*> order_water_minis(const std::vector<MiniRender*>& minis);
+
+	// ask for these minis to be re-meshed with coarser levels of detail (drawing them at full resolution until then)
+	void request_lod_meshes(const std::vector<MiniRender*>& minis);
+
 private:
 	BusNode bus;
 	std::unordered_map<vmath::ivec3, std::shared_ptr<MiniRender>, vecN_hash> mesh_map;
 	int rendered = 0; // how many times render() was called
+
+	// water sorts we haven't heard back about, oldest first
+	// (the sorter only answers the latest one it's got, so once one's answered, the ones before it never will be)
+	std::deque<PendingWaterSort> pending_water_sorts;
+
+	// water minis back-to-front, as of the last sort we got back (each one knows its index, see MiniRender::get_water_sort_index)
+	std::vector<MiniRender*> water_order;
+
+	// minis we've asked to be re-meshed with coarser levels of detail, until their new mesh comes in
+	std::unordered_set<vmath::ivec3, vecN_hash> lod_requests;
 };
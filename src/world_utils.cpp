@@ -2,6 +2,10 @@
 
 #include "messaging.h"
 
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
 float intbound(const float s, const float ds)
 {
 	// Some kind of edge case, see:
@@ -158,7 +162,100 @@ bool operator==(const Quad2D& lhs, const Quad2D& rhs) {
 
 ///////////////////////////////
 
-MeshGenResult::MeshGenResult(const vmath::ivec3& coords_, bool invisible_, std::unique_ptr<MiniChunkMesh>&& mesh_, std::unique_ptr<MiniChunkMesh>&& water_mesh_)
+namespace
+{
+	// turning further than this, or the predicted position moving more than this many chunks, changes priorities enough to recompute them
+	constexpr float VIEW_RESEND_ANGLE = 15.0f;
+	constexpr float VIEW_RESEND_LEAD = 0.5f;
+
+	const float VIEW_CONE_COS = cosf(vmath::radians(VIEW_CONE_HALF_ANGLE));
+	const float VIEW_RESEND_COS = cosf(vmath::radians(VIEW_RESEND_ANGLE));
+
+	// how far ahead we think the player will be
+	vmath::vec2 predicted_lead(const PlayerView& view)
+	{
+		vmath::vec2 lead = view.velocity * VIEW_PREDICTION_SECONDS;
+		const float lead_length = vmath::length(lead);
+		if (lead_length > VIEW_MAX_LEAD)
+		{
+			lead *= VIEW_MAX_LEAD / lead_length;
+		}
+		return lead;
+	}
+}
+
+int view_priority(const PlayerView& view, const vmath::ivec2& chunk_coords)
+{
+	const vmath::vec2 center = vmath::vec2(static_cast<float>(chunk_coords[0]), static_cast<float>(chunk_coords[1])) + vmath::vec2(0.5f, 0.5f);
+	const float distance = vmath::length(center - (view.position + predicted_lead(view)));
+
+	// how far outside the view cone it is, from 0 (inside) to 1 (straight behind)
+	const vmath::vec2 offset = center - view.position;
+	const float offset_length = vmath::length(offset);
+	float outside = 0.0f;
+	if (offset_length > VIEW_NEAR_RADIUS && vmath::dot(view.look, view.look) > 0.0f)
+	{
+		const float cos_angle = vmath::dot(offset, view.look) / offset_length;
+		outside = std::clamp((VIEW_CONE_COS - cos_angle) / (VIEW_CONE_COS + 1.0f), 0.0f, 1.0f);
+	}
+
+	return static_cast<int>(distance * (1.0f + (VIEW_BEHIND_FACTOR - 1.0f) * outside));
+}
+
+bool view_changed(const PlayerView& old_view, const PlayerView& new_view)
+{
+	if (old_view.chunk_coords != new_view.chunk_coords)
+	{
+		return true;
+	}
+
+	// started or stopped looking straight up/down, or turned far enough
+	const bool old_has_look = vmath::dot(old_view.look, old_view.look) > 0.0f;
+	const bool new_has_look = vmath::dot(new_view.look, new_view.look) > 0.0f;
+	if (old_has_look != new_has_look || (new_has_look && vmath::dot(old_view.look, new_view.look) < VIEW_RESEND_COS))
+	{
+		return true;
+	}
+
+	const vmath::vec2 old_predicted = old_view.position + predicted_lead(old_view);
+	const vmath::vec2 new_predicted = new_view.position + predicted_lead(new_view);
+	return vmath::length(new_predicted - old_predicted) > VIEW_RESEND_LEAD;
+}
+
+RequestQueueStats& chunk_gen_stats()
+{
+	static RequestQueueStats stats;
+	return stats;
+}
+
+RequestQueueStats& mesh_gen_stats()
+{
+	static RequestQueueStats stats;
+	return stats;
+}
+
+///////////////////////////////
+
+const MiniChunk* MeshGenRequestData::get_neighbor(const vmath::ivec3& offset) const {
+	assert(-1 <= offset[0] && offset[0] <= 1 && -1 <= offset[1] && offset[1] <= 1 && -1 <= offset[2] && offset[2] <= 1);
+
+	const int num_nonzero = (offset[0] != 0) + (offset[1] != 0) + (offset[2] != 0);
+	if (num_nonzero >= 2) {
+		return edges_and_corners[offset[0] + 1][offset[1] + 1][offset[2] + 1];
+	}
+
+	if (offset[0] > 0) return east;
+	if (offset[0] < 0) return west;
+	if (offset[1] > 0) return up;
+	if (offset[1] < 0) return down;
+	if (offset[2] > 0) return south;
+	if (offset[2] < 0) return north;
+	return self;
+}
+
+///////////////////////////////
+
+MeshGenResult::MeshGenResult(const vmath::ivec3& coords_, bool invisible_, std::shared_ptr<const MiniChunkMesh> mesh_, std::shared_ptr<const MiniChunkMesh> water_mesh_)
 	: coords(coords_), invisible(invisible_), mesh(std::move(mesh_)), water_mesh(std::move(water_mesh_))
 {
 }
@@ -171,6 +268,7 @@ MeshGenResult::MeshGenResult(MeshGenResult&& other) noexcept
 		invisible = other.invisible;
 		mesh = std::move(other.mesh);
 		water_mesh = std::move(other.water_mesh);
+		std::move(std::begin(other.lods), std::end(other.lods), std::begin(lods));
 	}
 }
 
@@ -182,6 +280,7 @@ MeshGenResult& MeshGenResult::operator=(MeshGenResult&& other)
 		invisible = other.invisible;
 		mesh = std::move(other.mesh);
 		water_mesh = std::move(other.water_mesh);
+		std::move(std::begin(other.lods), std::end(other.lods), std::begin(lods));
 	}
 	return *this;
 }
@@ -4,7 +4,10 @@
 
 #include "vmath.h"
 
+#include <atomic>
+#include <cstdint>
 #include <functional>
+#include <vector>
 
 // Rendering part
 #include "minichunkmesh.h"
@@ -13,16 +16,16 @@
 struct Quad2D {
 	BlockType block;
 	vmath::ivec2 corners[2];
-	uint8_t lighting = 0;
+	uint8_t lighting = 0; // ambient occlusion at each corner, 2 bits each, in order (u0,v0), (u1,v0), (u0,v1), (u1,v1)
 	Metadata metadata = 0;
+	uint16_t liquid_drops = 0; // liquid corner drops, 4 bits each, same order as lighting
 };
 
 bool operator==(const Quad2D& lhs, const Quad2D& rhs);
 
 struct MeshGenResult
 {
-	MeshGenResult(const vmath::ivec3& coords_, bool invisible_, const std::unique_ptr<MiniChunkMesh>& mesh_, const std::unique_ptr<MiniChunkMesh>& water_mesh_) = delete;
-	MeshGenResult(const vmath::ivec3& coords_, bool invisible_, std::unique_ptr<MiniChunkMesh>&& mesh_, std::unique_ptr<MiniChunkMesh>&& water_mesh_);
+	MeshGenResult(const vmath::ivec3& coords_, bool invisible_, std::shared_ptr<const MiniChunkMesh> mesh_, std::shared_ptr<const MiniChunkMesh> water_mesh_);
 	MeshGenResult(const MeshGenResult& other) = delete;
 	MeshGenResult(MeshGenResult&& other) noexcept;
 
@@ -31,19 +34,34 @@ struct MeshGenResult
 
 	vmath::ivec3 coords;
 	bool invisible;
-	std::unique_ptr<MiniChunkMesh> mesh;
-	std::unique_ptr<MiniChunkMesh> water_mesh;
+	// meshes are immutable so that identical minis can share them
+	std::shared_ptr<const MiniChunkMesh> mesh;
+	std::shared_ptr<const MiniChunkMesh> water_mesh;
+
+	// coarser meshes for drawing far away, lods[i] is level i + 1
+	MiniChunkLodMeshes lods[MESH_LOD_LEVELS - 1];
 };
 
+// the minis are the world's, and stay alive (and unchanged) for as long as *pin* is held (see Chunk::minis)
 struct MeshGenRequestData
 {
-	std::shared_ptr<MiniChunk> self;
-	std::shared_ptr<MiniChunk> north;
-	std::shared_ptr<MiniChunk> south;
-	std::shared_ptr<MiniChunk> east;
-	std::shared_ptr<MiniChunk> west;
-	std::shared_ptr<MiniChunk> up;
-	std::shared_ptr<MiniChunk> down;
+	const MiniChunk* self = nullptr;
+	const MiniChunk* north = nullptr;
+	const MiniChunk* south = nullptr;
+	const MiniChunk* east = nullptr;
+	const MiniChunk* west = nullptr;
+	const MiniChunk* up = nullptr;
+	const MiniChunk* down = nullptr;
+
+	// minis touching us along an edge or corner (for ambient occlusion), indexed by [dx + 1][dy + 1][dz + 1]
+	// faces and self are left null, they're above
+	const MiniChunk* edges_and_corners[3][3][3] = {};
+
+	// the world's epoch when it filled these in (empty if the minis can't change, e.g. in benchmarks)
+	EpochDomain::Pin pin;
+
+	// get any mini in our 3x3x3 neighborhood, where offset is in {-1, 0, 1}^3
+	const MiniChunk* get_neighbor(const vmath::ivec3& offset) const;
 };
 
 struct MeshGenRequest
@@ -52,15 +70,86 @@ struct MeshGenRequest
 	std::shared_ptr<MeshGenRequestData> data;
 };
 
+// workers drop queued requests this many chunks beyond the render distance
+constexpr int REQUEST_CANCEL_SLACK = 2;
+
+// how much work can be waiting at each stage of the world -> chunker/mesher -> renderer pipeline
+// past these, the world holds requests back and sends the closest ones first once there's room (so memory stays bounded however fast the player flies)
+constexpr size_t CHUNK_GEN_CAPACITY = 256; // chunks requested but not generated yet
+constexpr size_t MESH_GEN_CAPACITY = 1024; // minis requested but not meshed yet
+constexpr size_t MESH_RESPONSE_CAPACITY = 1024; // meshes waiting for the render thread (it's the size of its inbox, so a power of 2)
+
+// where the player is, where they're looking, and where they're headed (in chunks)
+// the chunker and mesher use it to decide what to build first
+struct PlayerView
+{
+	vmath::ivec2 chunk_coords = { 0, 0 };
+
+	// exact position (block coords / CHUNK_WIDTH)
+	vmath::vec2 position = { 0.0f, 0.0f };
+
+	// horizontal look direction (unit length, or zero if looking straight up or down)
+	vmath::vec2 look = { 0.0f, 0.0f };
+
+	// horizontal velocity, in chunks per second
+	vmath::vec2 velocity = { 0.0f, 0.0f };
+};
+
+// build what's ahead of the player first: chunks are prioritized by their distance from where the player will be this many seconds from now ...
+constexpr float VIEW_PREDICTION_SECONDS = 2.0f;
+constexpr float VIEW_MAX_LEAD = 4.0f; // (but never more than this many chunks ahead)
+
+// ... and chunks outside the view cone count as further away, up to this many times as far for chunks straight behind the player
+// (the cone's wider than the camera's 90 degrees, so turning a little doesn't show anything unbuilt)
+constexpr float VIEW_CONE_HALF_ANGLE = 60.0f;
+constexpr float VIEW_BEHIND_FACTOR = 2.0f;
+
+// chunks this close go by distance alone (they're visible whichever way the player looks)
+constexpr float VIEW_NEAR_RADIUS = 2.0f;
+
+// build order of a chunk (lower goes first)
+int view_priority(const PlayerView& view, const vmath::ivec2& chunk_coords);
+
+// true if priorities based on *old_view* are far enough off that they should be recomputed
+bool view_changed(const PlayerView& old_view, const PlayerView& new_view);
+
+// counters for a worker's request queue, shared by all threads (for debug info)
+struct RequestQueueStats
+{
+	// requests waiting in the queue right now
+	std::atomic_uint64_t queued = 0;
+
+	std::atomic_uint64_t completed = 0;
+
+	// dropped before being handled, because the player moved away
+	std::atomic_uint64_t cancelled = 0;
+
+	// handled, but outside render distance by the time we got to them
+	std::atomic_uint64_t wasted = 0;
+
+	// bus messages to and from the worker (requests, responses and cancellations)
+	std::atomic_uint64_t messages = 0;
+
+	// requests the world sent that the worker hasn't handled, cancelled or replaced with a newer one yet
+	std::atomic_uint64_t in_flight = 0;
+
+	// requests the world's holding back because the worker's at capacity
+	std::atomic_uint64_t held_back = 0;
+};
+
+RequestQueueStats& chunk_gen_stats();
+RequestQueueStats& mesh_gen_stats();
+
+// chunks to generate (the world sends all the chunks it needs at once)
 struct ChunkGenRequest
 {
-	vmath::ivec2 coords;
+	std::vector<vmath::ivec2> coords;
 };
 
+// generated chunks (the chunker sends them back in small batches)
 struct ChunkGenResponse
 {
-	vmath::ivec2 coords;
-	std::unique_ptr<Chunk> chunk;
+	std::vector<std::unique_ptr<Chunk>> chunks;
 };
 
 // get chunk-coordinates of chunk containing the block at (x, _, z)